@@ -0,0 +1,17 @@
+TARGET := bench-group-commit
+SOURCES := bench/bench-group-commit.cpp
+
+TGT_DEFS :=
+
+CPPFLAGS := -g -O2 -Wall -Wextra
+TGT_CFLAGS := $(CPPFLAGS) -std=c11
+TGT_CXXFLAGS := $(CPPFLAGS) -std=c++17 -pthread
+
+TGT_LDLIBS := -lpthread
+
+.PHONY: bench-group-commit
+bench-group-commit: $(TARGET_DIR)/$(TARGET)
+
+.PHONY: run-bench-group-commit
+run-bench-group-commit: $(TARGET_DIR)/$(TARGET)
+	$< $(TARGET_DIR)
@@ -0,0 +1,17 @@
+TARGET := bench-persist-threads
+SOURCES := bench/bench-persist-threads.cpp
+
+TGT_DEFS :=
+
+CPPFLAGS := -g -O2 -Wall -Wextra
+TGT_CFLAGS := $(CPPFLAGS) -std=c11
+TGT_CXXFLAGS := $(CPPFLAGS) -std=c++17 -pthread
+
+TGT_LDLIBS := -lpthread
+
+.PHONY: bench-persist-threads
+bench-persist-threads: $(TARGET_DIR)/$(TARGET)
+
+.PHONY: run-bench-persist-threads
+run-bench-persist-threads: $(TARGET_DIR)/$(TARGET)
+	$< $(TARGET_DIR)
@@ -0,0 +1,17 @@
+TARGET := bench-sharded-store
+SOURCES := bench/bench-sharded-store.cpp
+
+TGT_DEFS :=
+
+CPPFLAGS := -g -O2 -Wall -Wextra
+TGT_CFLAGS := $(CPPFLAGS) -std=c11
+TGT_CXXFLAGS := $(CPPFLAGS) -std=c++17 -pthread
+
+TGT_LDLIBS := -lpthread
+
+.PHONY: bench-sharded-store
+bench-sharded-store: $(TARGET_DIR)/$(TARGET)
+
+.PHONY: run-bench-sharded-store
+run-bench-sharded-store: $(TARGET_DIR)/$(TARGET)
+	$< $(TARGET_DIR)
@@ -0,0 +1,166 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Measures durable save throughput of Persist instances sharing one image
+// file, from 1 to 32 concurrent writers. Each writer owns one partition of
+// the file and saves in a loop; every Save returns only once it is durable.
+// The baseline syncs after each Save, while group commit batches the syncs
+// of concurrent saves. The image is written to bench_group_commit.bin,
+// either in the current directory or in the directory specified by the
+// optional first argument passed to the program.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "persist/persist.h"
+#include "util/file_memory.h"
+#include "util/group_commit.h"
+#include "util/partition_memory.h"
+
+namespace demo
+{
+
+static constexpr uint32_t kMaxWriters = 32;
+static constexpr uint32_t kSlotSize = 4096;
+static constexpr uint32_t kSavesPerWriter = 200;
+
+using ImageMemory = BasicFileMemory<kMaxWriters * kSlotSize, 1024, 16>;
+using SlotMemory = PartitionMemory<ImageMemory, kSlotSize>;
+using SlotPersist = persist::Persist<SlotMemory, uint32_t, 0>;
+
+template <typename Save>
+double Run(uint32_t num_writers, Save save)
+{
+    std::vector<std::thread> writers;
+    auto start = std::chrono::steady_clock::now();
+
+    for (uint32_t w = 0; w < num_writers; w++)
+    {
+        writers.emplace_back([&save, w]()
+        {
+            for (uint32_t i = 0; i < kSavesPerWriter; i++)
+            {
+                save(w, i);
+            }
+        });
+    }
+
+    for (auto& writer : writers)
+    {
+        writer.join();
+    }
+
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return num_writers * kSavesPerWriter / elapsed.count();
+}
+
+double BenchSyncEach(ImageMemory& memory, uint32_t num_writers)
+{
+    std::vector<std::unique_ptr<SlotMemory>> slot_memories;
+    std::vector<std::unique_ptr<SlotPersist>> slots;
+
+    for (uint32_t w = 0; w < num_writers; w++)
+    {
+        slot_memories.push_back(
+            std::make_unique<SlotMemory>(memory, w * kSlotSize));
+        slots.push_back(std::make_unique<SlotPersist>(*slot_memories.back()));
+        slots.back()->Init();
+    }
+
+    return Run(num_writers, [&](uint32_t w, uint32_t i)
+    {
+        slots[w]->Save(i);
+        memory.Sync();
+    });
+}
+
+double BenchGroupCommit(ImageMemory& memory, uint32_t num_writers)
+{
+    using GroupPersist = GroupCommitPersist<SlotPersist, uint32_t>;
+
+    GroupCommit group{[&memory]() { return memory.Sync(); }};
+    std::vector<std::unique_ptr<SlotMemory>> slot_memories;
+    std::vector<std::unique_ptr<GroupPersist>> slots;
+
+    for (uint32_t w = 0; w < num_writers; w++)
+    {
+        slot_memories.push_back(
+            std::make_unique<SlotMemory>(memory, w * kSlotSize));
+        slots.push_back(
+            std::make_unique<GroupPersist>(group, *slot_memories.back()));
+        slots.back()->Init();
+    }
+
+    return Run(num_writers, [&](uint32_t w, uint32_t i)
+    {
+        slots[w]->Save(i);
+    });
+}
+
+extern "C"
+int main(int argc, const char* argv[])
+{
+    std::filesystem::path file_dir = ".";
+
+    if (argc >= 2)
+    {
+        file_dir = argv[1];
+    }
+
+    std::filesystem::path path = file_dir / "bench_group_commit.bin";
+
+    printf("%8s %16s %16s\n", "writers", "sync each/s", "group commit/s");
+
+    for (uint32_t num_writers = 1; num_writers <= kMaxWriters;
+        num_writers *= 2)
+    {
+        std::filesystem::remove(path);
+        double sync_each;
+        double group_commit;
+
+        {
+            ImageMemory memory{path};
+            sync_each = BenchSyncEach(memory, num_writers);
+        }
+
+        std::filesystem::remove(path);
+
+        {
+            ImageMemory memory{path};
+            group_commit = BenchGroupCommit(memory, num_writers);
+        }
+
+        printf("%8u %16.0f %16.0f\n", num_writers, sync_each, group_commit);
+    }
+
+    std::filesystem::remove(path);
+    return EXIT_SUCCESS;
+}
+
+}
@@ -0,0 +1,143 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Measures Save and Load throughput of LockedPersist as the number of
+// threads sharing one Persist grows, for each lock policy. "cached" counts
+// Load, which copies the last value under the lock without touching the
+// medium; "stored" counts LoadStored, which reads the medium via Persist.
+// The image file is bench_persist_threads.bin, either in the current
+// directory or in the directory specified by the optional first argument
+// passed to the program.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <thread>
+#include <vector>
+
+#include "persist/persist.h"
+#include "util/file_memory.h"
+#include "util/lock_policy.h"
+#include "util/locked_persist.h"
+
+namespace demo
+{
+
+static constexpr uint32_t kOpsPerThread = 2000;
+static constexpr uint32_t kMaxThreads = 8;
+
+struct BenchData
+{
+    uint32_t thread;
+    uint32_t count;
+};
+
+template <typename Locked, typename Op>
+double Run(Locked& persist, uint32_t num_threads, Op op)
+{
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+
+    for (uint32_t t = 0; t < num_threads; t++)
+    {
+        threads.emplace_back([&persist, &op, t]()
+        {
+            for (uint32_t i = 0; i < kOpsPerThread; i++)
+            {
+                op(persist, t, i);
+            }
+        });
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return num_threads * kOpsPerThread / elapsed.count();
+}
+
+template <typename Lock>
+void Bench(const char* name, const std::filesystem::path& path)
+{
+    using PersistType = persist::Persist<FileMemory, BenchData, 0>;
+    using Locked = LockedPersist<PersistType, BenchData, Lock>;
+
+    for (uint32_t num_threads = 1; num_threads <= kMaxThreads;
+        num_threads *= 2)
+    {
+        std::filesystem::remove(path);
+        FileMemory nvmem(path);
+        Locked persist{nvmem};
+        persist.Init();
+
+        double saves = Run(persist, num_threads,
+            [](Locked& p, uint32_t t, uint32_t i)
+            {
+                p.Save(BenchData{t, i});
+            });
+
+        double cached = Run(persist, num_threads,
+            [](Locked& p, uint32_t, uint32_t)
+            {
+                BenchData data;
+                p.Load(data);
+            });
+
+        double stored = Run(persist, num_threads,
+            [](Locked& p, uint32_t, uint32_t)
+            {
+                BenchData data;
+                p.LoadStored(data);
+            });
+
+        printf("%-8s %7u %14.0f %14.0f %14.0f\n",
+            name, num_threads, saves, cached, stored);
+    }
+}
+
+extern "C"
+int main(int argc, const char* argv[])
+{
+    std::filesystem::path file_dir = ".";
+
+    if (argc >= 2)
+    {
+        file_dir = argv[1];
+    }
+
+    std::filesystem::path path = file_dir / "bench_persist_threads.bin";
+
+    printf("%-8s %7s %14s %14s %14s\n", "lock", "threads", "saves/s",
+        "cached/s", "stored/s");
+    Bench<MutexLock>("mutex", path);
+    Bench<SpinLock>("spin", path);
+    Bench<SharedLock>("shared", path);
+
+    std::filesystem::remove(path);
+    return EXIT_SUCCESS;
+}
+
+}
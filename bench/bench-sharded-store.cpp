@@ -0,0 +1,128 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Measures aggregate save throughput of ShardedPersistStore from 1 to 64
+// shards. Several producer threads submit saves spread over all objects and
+// the time until everything is flushed is reported. The shard images are
+// written to a bench_sharded_store directory, either in the current
+// directory or in the directory specified by the optional first argument
+// passed to the program.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "persist/persist.h"
+#include "util/file_memory.h"
+#include "util/sharded_store.h"
+
+namespace demo
+{
+
+static constexpr uint32_t kNumProducers = 4;
+static constexpr uint32_t kSavesPerProducer = 20000;
+static constexpr uint32_t kMaxShards = 64;
+
+struct BenchData
+{
+    uint32_t id;
+    uint32_t count;
+    uint8_t payload[24];
+};
+
+using ShardMemory = BasicFileMemory<64 * 1024, 1024, 16>;
+using Store = ShardedPersistStore<ShardMemory, BenchData, 0, 16>;
+
+double Bench(const std::filesystem::path& dir, uint32_t num_shards)
+{
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+
+    Store store(num_shards, [&dir](uint32_t shard)
+    {
+        auto path = dir / ("shard" + std::to_string(shard) + ".bin");
+        return std::make_unique<ShardMemory>(path);
+    });
+    store.Init();
+
+    std::vector<std::thread> producers;
+    auto start = std::chrono::steady_clock::now();
+
+    for (uint32_t t = 0; t < kNumProducers; t++)
+    {
+        producers.emplace_back([&store, t]()
+        {
+            BenchData data{};
+
+            for (uint32_t i = 0; i < kSavesPerProducer; i++)
+            {
+                data.id = (i * kNumProducers + t) % store.capacity();
+                data.count = i;
+                store.Save(data.id, data);
+            }
+        });
+    }
+
+    for (auto& producer : producers)
+    {
+        producer.join();
+    }
+
+    if (!store.Flush())
+    {
+        fprintf(stderr, "Some saves failed\n");
+    }
+
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return kNumProducers * kSavesPerProducer / elapsed.count();
+}
+
+extern "C"
+int main(int argc, const char* argv[])
+{
+    std::filesystem::path file_dir = ".";
+
+    if (argc >= 2)
+    {
+        file_dir = argv[1];
+    }
+
+    std::filesystem::path dir = file_dir / "bench_sharded_store";
+
+    printf("%7s %14s\n", "shards", "saves/s");
+
+    for (uint32_t num_shards = 1; num_shards <= kMaxShards; num_shards *= 2)
+    {
+        printf("%7u %14.0f\n", num_shards, Bench(dir, num_shards));
+    }
+
+    std::filesystem::remove_all(dir);
+    return EXIT_SUCCESS;
+}
+
+}
@@ -0,0 +1,17 @@
+TARGET := demo-async
+SOURCES := demo/demo-async.cpp
+
+TGT_DEFS :=
+
+CPPFLAGS := -g -O0 -Wall -Wextra
+TGT_CFLAGS := $(CPPFLAGS) -std=c11
+TGT_CXXFLAGS := $(CPPFLAGS) -std=c++20
+
+TGT_LDLIBS :=
+
+.PHONY: demo-async
+demo-async: $(TARGET_DIR)/$(TARGET)
+
+.PHONY: run-demo-async
+run-demo-async: $(TARGET_DIR)/$(TARGET)
+	$< $(TARGET_DIR)
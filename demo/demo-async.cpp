@@ -0,0 +1,110 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Demonstrates the coroutine interface to Persist. A single thread runs an
+// EventLoop that keeps many persisted counters in flight at once, each one
+// loaded, incremented and saved by its own coroutine. The first counter is
+// stored in demo_async.bin, either in the current directory or in the
+// directory specified by the optional first argument passed to the program,
+// and the rest live in RAM.
+
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+#include "persist/persist.h"
+#include "util/async_persist.h"
+#include "util/file_memory.h"
+#include "util/ram_memory.h"
+
+namespace demo
+{
+
+static constexpr uint32_t kNumCounters = 1000;
+static constexpr uint32_t kIncrements = 10;
+
+template <typename Async>
+Task<void> Count(Async& persist, uint32_t& total)
+{
+    persist::Result result = co_await persist.InitAsync();
+    assert(result == persist::RESULT_SUCCESS);
+
+    uint32_t number = 0;
+    co_await persist.LoadAsync(number);
+
+    for (uint32_t i = 0; i < kIncrements; i++)
+    {
+        number++;
+        result = co_await persist.SaveAsync(number);
+        assert(result == persist::RESULT_SUCCESS);
+    }
+
+    total += number;
+}
+
+extern "C"
+int main(int argc, const char* argv[])
+{
+    std::filesystem::path file_dir = ".";
+
+    if (argc >= 2)
+    {
+        file_dir = argv[1];
+    }
+
+    using RamType = RamMemory<256>;
+    using FilePersist = persist::Persist<FileMemory, uint32_t, 0>;
+    using RamPersist = persist::Persist<RamType, uint32_t, 0>;
+
+    EventLoop loop;
+    uint32_t total = 0;
+
+    FileMemory nvmem(file_dir / "demo_async.bin");
+    AsyncPersist<FilePersist, uint32_t> file_persist{loop, nvmem};
+    loop.Spawn(Count(file_persist, total));
+
+    std::vector<std::unique_ptr<RamType>> memories;
+    std::vector<std::unique_ptr<AsyncPersist<RamPersist, uint32_t>>> persists;
+
+    for (uint32_t i = 1; i < kNumCounters; i++)
+    {
+        memories.push_back(std::make_unique<RamType>());
+        memories.back()->Init();
+        persists.push_back(std::make_unique<AsyncPersist<RamPersist, uint32_t>>(
+            loop, *memories.back()));
+        loop.Spawn(Count(*persists.back(), total));
+    }
+
+    loop.Run();
+
+    uint32_t number = 0;
+    file_persist.Load(number);
+    printf("File counter: %u.\n", number);
+    printf("Sum of %u counters: %u.\n", kNumCounters, total);
+
+    return EXIT_SUCCESS;
+}
+
+}
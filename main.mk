@@ -1,4 +1,11 @@
 BUILD_DIR := build
 TARGET_DIR := $(BUILD_DIR)/artifact
-SUBMAKEFILES := test.mk demo-load-save.mk demo-backward-compatible.mk
+SUBMAKEFILES := test.mk test-cpp20.mk demo-load-save.mk demo-backward-compatible.mk demo-async.mk \
+	bench-persist-threads.mk bench-sharded-store.mk bench-group-commit.mk \
+	persist-tool.mk persist-image-builder.mk persist-replay.mk
 INCDIRS := .
+
+# "make USDT=1" compiles in the static tracepoints from util/probes.h
+ifeq ($(USDT),1)
+    DEFS += PERSIST_DEMO_USDT
+endif
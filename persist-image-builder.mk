@@ -0,0 +1,13 @@
+TARGET := persist-image-builder
+SOURCES := tool/persist-image-builder.cpp
+
+TGT_DEFS :=
+
+CPPFLAGS := -g -O2 -Wall -Wextra
+TGT_CFLAGS := $(CPPFLAGS) -std=c11
+TGT_CXXFLAGS := $(CPPFLAGS) -std=c++17 -pthread
+
+TGT_LDLIBS := -lpthread
+
+.PHONY: persist-image-builder
+persist-image-builder: $(TARGET_DIR)/$(TARGET)
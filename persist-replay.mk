@@ -0,0 +1,13 @@
+TARGET := persist-replay
+SOURCES := tool/persist-replay.cpp
+
+TGT_DEFS :=
+
+CPPFLAGS := -g -O2 -Wall -Wextra
+TGT_CFLAGS := $(CPPFLAGS) -std=c11
+TGT_CXXFLAGS := $(CPPFLAGS) -std=c++17 -pthread
+
+TGT_LDLIBS := -lpthread
+
+.PHONY: persist-replay
+persist-replay: $(TARGET_DIR)/$(TARGET)
@@ -0,0 +1,13 @@
+TARGET := persist-tool
+SOURCES := tool/persist-tool.cpp
+
+TGT_DEFS :=
+
+CPPFLAGS := -g -O2 -Wall -Wextra
+TGT_CFLAGS := $(CPPFLAGS) -std=c11
+TGT_CXXFLAGS := $(CPPFLAGS) -std=c++17 -pthread
+
+TGT_LDLIBS := -lpthread
+
+.PHONY: persist-tool
+persist-tool: $(TARGET_DIR)/$(TARGET)
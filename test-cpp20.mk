@@ -0,0 +1,18 @@
+TARGET := test-cpp20
+SOURCES := \
+	unit_tests/cpp20/*.cpp \
+
+TGT_DEFS :=
+
+CPPFLAGS := -g -O0 -Wall -Wextra
+TGT_CFLAGS := $(CPPFLAGS) -std=c11
+TGT_CXXFLAGS := $(CPPFLAGS) -std=c++20 -pthread
+
+TGT_LDLIBS := -lgtest -lpthread -lgtest_main
+
+.PHONY: tests-cpp20
+tests-cpp20: $(TARGET_DIR)/$(TARGET)
+
+.PHONY: check-cpp20
+check-cpp20: $(TARGET_DIR)/$(TARGET)
+	$<
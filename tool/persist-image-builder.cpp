@@ -0,0 +1,131 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Provisioning tool that builds demo-load-save images for a batch of units.
+//
+//     persist-image-builder [-j threads] <output-dir>
+//
+// Reads one value per line from standard input and writes
+// <output-dir>/unit<N>.bin for the Nth value, ready to be used by
+// demo-load-save. All images are built in memory in parallel before being
+// written out. Units whose image could not be built get no file (a stale one
+// from an earlier run is removed), and the exit status is nonzero.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "persist/persist.h"
+#include "util/file_memory.h"
+#include "util/image_builder.h"
+#include "util/span_memory.h"
+
+namespace demo
+{
+
+// Matches SaveData in demo-load-save
+struct SaveData
+{
+    uint32_t number;
+};
+
+using Image = SpanMemory<FileMemory::kSize, FileMemory::kEraseGranularity,
+    FileMemory::kWriteGranularity>;
+
+extern "C"
+int main(int argc, const char* argv[])
+{
+    uint32_t num_threads = 0;
+    int arg = 1;
+
+    if (arg + 1 < argc && !strcmp(argv[arg], "-j"))
+    {
+        num_threads = atoi(argv[arg + 1]);
+        arg += 2;
+    }
+
+    if (argc - arg != 1)
+    {
+        fprintf(stderr,
+            "usage: persist-image-builder [-j threads] <output-dir> "
+            "< values\n");
+        return 2;
+    }
+
+    std::filesystem::path dir = argv[arg];
+    std::filesystem::create_directories(dir);
+
+    std::vector<SaveData> values;
+    unsigned long number;
+
+    while (scanf("%lu", &number) == 1)
+    {
+        values.push_back(SaveData{uint32_t(number)});
+    }
+
+    std::vector<uint8_t> images(values.size() * Image::kSize);
+    std::unique_ptr<bool[]> built(new bool[values.size()]);
+
+    auto start = std::chrono::steady_clock::now();
+    uint32_t failures = BuildImages<Image, SaveData, 0>(
+        values.data(), values.size(), images.data(), num_threads,
+        built.get());
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    for (uint32_t i = 0; i < values.size(); i++)
+    {
+        auto path = dir / ("unit" + std::to_string(i) + ".bin");
+
+        if (!built[i])
+        {
+            fprintf(stderr, "unit %u: could not build image\n", i);
+            std::error_code error;
+            std::filesystem::remove(path, error);
+            continue;
+        }
+
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&images[i * Image::kSize]),
+            Image::kSize);
+
+        if (!file)
+        {
+            failures++;
+        }
+    }
+
+    printf("Built %zu images in %.3f s (%.0f images/s), %u failed.\n",
+        values.size(), elapsed.count(), values.size() / elapsed.count(),
+        failures);
+
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+}
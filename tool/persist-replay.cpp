@@ -0,0 +1,346 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Replays a trace recorded with TracingMemory and TracingPersist against a
+// chosen memory backend, and reports throughput and latency percentiles.
+//
+//     persist-replay [-r repeat] <backend> <trace>
+//
+// Backends:
+//     ram       RamMemory
+//     file      FileMemory on a temporary file
+//     mmap      A memory-mapped temporary file
+//     nor       A timing model of a serial NOR flash, using the erase and
+//               write granularity recorded in the trace
+//
+// Every backend is kReplaySize bytes with byte granularity, so a trace from
+// any geometry up to that size replays unchanged. Each pass starts from an
+// erased backend and writes the bytes recorded in the trace.
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "util/file_memory.h"
+#include "util/ram_memory.h"
+#include "util/span_memory.h"
+#include "util/trace.h"
+
+namespace demo
+{
+
+static constexpr uint32_t kReplaySize = 4 * 1024 * 1024;
+
+using RamBackend = RamMemory<kReplaySize>;
+using FileBackend = BasicFileMemory<kReplaySize, 1, 1>;
+using SpanBackend = SpanMemory<kReplaySize, 1, 1>;
+
+// Serial NOR flash timing: reads stream at the bus rate, writes pay a fixed
+// cost per write unit plus a per-byte cost, and erases a fixed cost per
+// erase unit. Data is kept in RAM.
+class NorTimingMemory : public RamBackend
+{
+public:
+    static constexpr uint32_t kReadNsPerByte = 20;
+    static constexpr uint32_t kProgramNsPerUnit = 20000;
+    static constexpr uint32_t kProgramNsPerByte = 2500;
+    static constexpr uint32_t kEraseNsPerUnit = 45000000;
+    static constexpr uint32_t kWritableNsPerByte = kReadNsPerByte;
+
+    NorTimingMemory(const TraceHeader& header) :
+        write_granularity_(std::max<uint32_t>(header.write_granularity, 1)),
+        erase_granularity_(std::max<uint32_t>(header.erase_granularity, 1)),
+        latency_(0)
+    {}
+
+    bool Read(void* dst, uint32_t location, uint32_t length)
+    {
+        latency_ = Saturate(uint64_t(length) * kReadNsPerByte);
+        return RamBackend::Read(dst, location, length);
+    }
+
+    bool Writable(uint32_t location, uint32_t length)
+    {
+        latency_ = Saturate(uint64_t(length) * kWritableNsPerByte);
+
+        for (uint32_t i = 0; i < length; i++)
+        {
+            if (mem_[location + i] != kFillByte)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool Write(uint32_t location, const void* src, uint32_t length)
+    {
+        uint64_t units = (length + write_granularity_ - 1) / write_granularity_;
+        latency_ = Saturate(units * kProgramNsPerUnit +
+            uint64_t(length) * kProgramNsPerByte);
+        return RamBackend::Write(location, src, length);
+    }
+
+    bool Erase(uint32_t location, uint32_t length)
+    {
+        uint64_t units = (length + erase_granularity_ - 1) / erase_granularity_;
+        latency_ = Saturate(units * kEraseNsPerUnit);
+        std::memset(&mem_[location], kFillByte, length);
+        return true;
+    }
+
+    uint32_t modeled_latency(void) const
+    {
+        return latency_;
+    }
+
+protected:
+    uint32_t write_granularity_;
+    uint32_t erase_granularity_;
+    uint32_t latency_;
+
+    static uint32_t Saturate(uint64_t latency)
+    {
+        return uint32_t(std::min<uint64_t>(latency, UINT32_MAX));
+    }
+};
+
+class TempFile
+{
+public:
+    TempFile(void)
+    {
+        char path[] = "/tmp/persist-replay.XXXXXX";
+        int fd = mkstemp(path);
+
+        if (fd >= 0)
+        {
+            close(fd);
+            path_ = path;
+        }
+    }
+
+    ~TempFile()
+    {
+        if (!path_.empty())
+        {
+            unlink(path_.c_str());
+        }
+    }
+
+    const std::string& path(void) const
+    {
+        return path_;
+    }
+
+protected:
+    std::string path_;
+};
+
+static uint32_t Percentile(const std::vector<uint32_t>& sorted, double p)
+{
+    size_t index = size_t(p * (sorted.size() - 1) + 0.5);
+    return sorted[index];
+}
+
+static void Report(const ReplayResult& replay, bool modeled)
+{
+    double seconds = replay.elapsed / 1e9;
+    uint64_t num_ops = 0;
+
+    for (uint32_t op = TRACE_READ; op <= TRACE_ERASE; op++)
+    {
+        num_ops += replay.latencies[op].size();
+    }
+
+    printf("%s time %.6f s, %" PRIu64 " memory ops, %.0f ops/s, %.2f MB/s\n",
+        modeled ? "modeled" : "busy", seconds, num_ops,
+        seconds > 0 ? num_ops / seconds : 0.0,
+        seconds > 0 ? replay.bytes / seconds / 1e6 : 0.0);
+
+    if (replay.mismatches)
+    {
+        printf("%u results differ from the recording\n", replay.mismatches);
+    }
+
+    printf("%-9s %9s %10s %10s %10s %10s %10s\n",
+        "op", "count", "p50 ns", "p90 ns", "p99 ns", "p99.9 ns", "max ns");
+
+    for (uint32_t op = 0; op < TRACE_NUM_OPS; op++)
+    {
+        std::vector<uint32_t> sorted = replay.latencies[op];
+
+        if (sorted.empty())
+        {
+            continue;
+        }
+
+        std::sort(sorted.begin(), sorted.end());
+        printf("%-9s %9zu %10u %10u %10u %10u %10u\n", TraceOpName(op),
+            sorted.size(), Percentile(sorted, 0.5), Percentile(sorted, 0.9),
+            Percentile(sorted, 0.99), Percentile(sorted, 0.999),
+            sorted.back());
+    }
+}
+
+template <typename Memory>
+static ReplayResult ReplayRepeated(Memory& memory,
+    const std::vector<TraceRecord>& records,
+    const std::vector<uint8_t>& payload, uint32_t repeat)
+{
+    ReplayResult total{};
+
+    for (uint32_t i = 0; i < repeat; i++)
+    {
+        // Later passes must not find the first pass's data in place
+        memory.Erase(0, kReplaySize);
+        ReplayResult replay = Replay(memory, records, payload);
+
+        for (uint32_t op = 0; op < TRACE_NUM_OPS; op++)
+        {
+            total.latencies[op].insert(total.latencies[op].end(),
+                replay.latencies[op].begin(), replay.latencies[op].end());
+        }
+
+        total.bytes += replay.bytes;
+        total.elapsed += replay.elapsed;
+        total.mismatches += replay.mismatches;
+    }
+
+    return total;
+}
+
+static void Usage(void)
+{
+    fprintf(stderr,
+        "usage: persist-replay [-r repeat] <backend> <trace>\n"
+        "backends: ram, file, mmap, nor\n");
+}
+
+extern "C"
+int main(int argc, const char* argv[])
+{
+    uint32_t repeat = 1;
+    int arg = 1;
+
+    if (arg + 1 < argc && !strcmp(argv[arg], "-r"))
+    {
+        repeat = std::max(atoi(argv[arg + 1]), 1);
+        arg += 2;
+    }
+
+    if (argc - arg != 2)
+    {
+        Usage();
+        return 2;
+    }
+
+    const char* backend = argv[arg];
+    const char* trace_path = argv[arg + 1];
+    TraceHeader header;
+    std::vector<TraceRecord> records;
+    std::vector<uint8_t> payload;
+
+    if (!ReadTrace(trace_path, header, records, payload))
+    {
+        fprintf(stderr, "%s: not a readable trace\n", trace_path);
+        return EXIT_FAILURE;
+    }
+
+    if (header.size > kReplaySize)
+    {
+        fprintf(stderr, "%s: memory size %u exceeds %u\n", trace_path,
+            header.size, kReplaySize);
+        return EXIT_FAILURE;
+    }
+
+    printf("%s: %zu records, memory %u bytes, erase %u, write %u\n",
+        trace_path, records.size(), header.size, header.erase_granularity,
+        header.write_granularity);
+
+    ReplayResult replay;
+    bool modeled = false;
+
+    if (!strcmp(backend, "ram"))
+    {
+        auto memory = std::make_unique<RamBackend>();
+        memory->Init();
+        replay = ReplayRepeated(*memory, records, payload, repeat);
+    }
+    else if (!strcmp(backend, "file"))
+    {
+        TempFile file;
+        FileBackend memory{file.path()};
+        replay = ReplayRepeated(memory, records, payload, repeat);
+    }
+    else if (!strcmp(backend, "mmap"))
+    {
+        // FileMemory pads the new file to kReplaySize with the fill byte
+        TempFile file;
+        FileBackend{file.path()};
+        FILE* image = fopen(file.path().c_str(), "r+b");
+        void* data = (image == nullptr) ? MAP_FAILED : mmap(nullptr,
+            kReplaySize, PROT_READ | PROT_WRITE, MAP_SHARED, fileno(image), 0);
+
+        if (image != nullptr)
+        {
+            fclose(image);
+        }
+
+        if (data == MAP_FAILED)
+        {
+            fprintf(stderr, "cannot map %s\n", file.path().c_str());
+            return EXIT_FAILURE;
+        }
+
+        SpanBackend memory{data};
+        replay = ReplayRepeated(memory, records, payload, repeat);
+        munmap(data, kReplaySize);
+    }
+    else if (!strcmp(backend, "nor"))
+    {
+        auto memory = std::make_unique<NorTimingMemory>(header);
+        memory->Init();
+        replay = ReplayRepeated(*memory, records, payload, repeat);
+        modeled = true;
+    }
+    else
+    {
+        Usage();
+        return 2;
+    }
+
+    Report(replay, modeled);
+    return EXIT_SUCCESS;
+}
+
+}
@@ -0,0 +1,149 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Offline inspection and maintenance of Persist image files.
+//
+//     persist-tool [-j threads] <command> <profile> <image>...
+//
+// Commands:
+//     dump      List every valid generation, newest first, with its location
+//               and payload bytes.
+//     verify    Check that each image holds a valid newest generation.
+//     wear      Report how many erase units are blank, partly or fully
+//               programmed.
+//     compact   Rewrite each image so that it holds only its newest
+//               generation. The new image is built and verified in a
+//               private copy, then renamed over the original.
+//     format    Erase each image.
+//
+// A profile names the memory geometry, payload size and datatype version of
+// the images, since Persist needs all three to recognize its blocks. Images
+// are memory-mapped and processed in parallel; the exit status is nonzero if
+// any image fails.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "util/file_memory.h"
+#include "util/image_tool.h"
+#include "util/parallel_for.h"
+#include "util/span_memory.h"
+
+namespace demo
+{
+
+using FileImage = SpanMemory<FileMemory::kSize, FileMemory::kEraseGranularity,
+    FileMemory::kWriteGranularity>;
+
+// Add a line here for each kind of image to be inspected.
+static const Profile kProfiles[] = {
+    ProfileCommands<FileImage, 4, 0>::Make("load-save",
+        "demo-load-save images (SaveData, version 0)"),
+    ProfileCommands<FileImage, 8, 1>::Make("backward-compatible",
+        "demo-backward-compatible images (SaveData1, version 1)"),
+};
+
+static void Usage(void)
+{
+    fprintf(stderr,
+        "usage: persist-tool [-j threads] <command> <profile> <image>...\n"
+        "commands: dump, verify, wear, compact, format\n"
+        "profiles:\n");
+
+    for (auto& profile : kProfiles)
+    {
+        fprintf(stderr, "  %-20s %s\n", profile.name, profile.description);
+    }
+}
+
+extern "C"
+int main(int argc, const char* argv[])
+{
+    uint32_t num_threads = 0;
+    int arg = 1;
+
+    if (arg < argc && !strcmp(argv[arg], "-j"))
+    {
+        if (arg + 1 >= argc || !ParseCount(argv[arg + 1], num_threads))
+        {
+            fprintf(stderr, "-j needs a positive number of threads\n");
+            return 2;
+        }
+
+        arg += 2;
+    }
+
+    if (argc - arg < 3)
+    {
+        Usage();
+        return 2;
+    }
+
+    const ImageCommand* command = FindImageCommand(argv[arg++]);
+    const char* profile_name = argv[arg++];
+    const Profile* profile = nullptr;
+
+    for (auto& each : kProfiles)
+    {
+        if (!strcmp(each.name, profile_name))
+        {
+            profile = &each;
+        }
+    }
+
+    if (command == nullptr || profile == nullptr)
+    {
+        Usage();
+        return 2;
+    }
+
+    std::vector<const char*> paths(argv + arg, argv + argc);
+    std::vector<std::string> reports(paths.size());
+    std::vector<char> failed(paths.size(), 0);
+
+    ParallelFor(paths.size(), num_threads, [&](uint32_t i)
+    {
+        failed[i] = !RunImageCommand(*profile, *command, paths[i],
+            reports[i]);
+    });
+
+    uint32_t num_failed = 0;
+
+    for (uint32_t i = 0; i < paths.size(); i++)
+    {
+        printf("%s:\n%s", paths[i], reports[i].c_str());
+        num_failed += failed[i];
+    }
+
+    if (paths.size() > 1)
+    {
+        printf("%zu images, %u failed\n", paths.size(), num_failed);
+    }
+
+    return num_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+}
@@ -0,0 +1,341 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Built by test-cpp20.mk, since coroutines need C++20
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "persist/persist.h"
+#include "unit_tests/test_memory.h"
+#include "util/async_persist.h"
+
+namespace persist::test
+{
+
+using MemType = Memory<1024, 64, 4>;
+
+// Memory whose reads and writes can be made to fail or throw
+struct ErrorMemory : MemType
+{
+    bool fail_writes = false;
+    bool throw_reads = false;
+
+    bool Read(void* dst, uint32_t location, uint32_t length)
+    {
+        if (throw_reads)
+        {
+            throw std::runtime_error("read");
+        }
+
+        return MemType::Read(dst, location, length);
+    }
+
+    bool Write(uint32_t location, const void* src, uint32_t length)
+    {
+        return !fail_writes && MemType::Write(location, src, length);
+    }
+};
+
+// Memory whose operations complete on a later turn of the loop
+struct LoopMemory : MemType
+{
+    demo::EventLoop& loop;
+    std::vector<std::string>& events;
+    bool fail_writes = false;
+
+    LoopMemory(demo::EventLoop& loop, std::vector<std::string>& events) :
+        loop(loop),
+        events(events)
+    {
+        Init();
+    }
+
+    demo::Task<bool> ReadAsync(void* dst, uint32_t location, uint32_t length)
+    {
+        co_await loop.Schedule();
+        co_return Read(dst, location, length);
+    }
+
+    demo::Task<bool> WriteAsync(uint32_t location, const void* src,
+        uint32_t length)
+    {
+        co_await loop.Schedule();
+        events.push_back("write");
+        co_return !fail_writes && Write(location, src, length);
+    }
+
+    demo::Task<bool> EraseAsync(uint32_t location, uint32_t length)
+    {
+        co_await loop.Schedule();
+        events.push_back("erase");
+        co_return Erase(location, length);
+    }
+};
+
+static_assert(!demo::AsyncMemory<ErrorMemory>);
+static_assert(demo::AsyncMemory<LoopMemory>);
+
+using PersistType = Persist<ErrorMemory, uint32_t, 0>;
+using AsyncType = demo::AsyncPersist<PersistType, uint32_t>;
+using LoopPersistType = demo::AsyncPersist<Persist<LoopMemory, uint32_t, 0>,
+    uint32_t>;
+
+class AsyncPersistTest : public ::testing::Test
+{
+protected:
+    void SetUp(void) override
+    {
+        mem_a_.Init();
+        mem_b_.Init();
+    }
+
+    demo::EventLoop loop_;
+    ErrorMemory mem_a_;
+    ErrorMemory mem_b_;
+};
+
+TEST_F(AsyncPersistTest, Sync)
+{
+    AsyncType persist{loop_, mem_a_};
+    ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+
+    uint32_t data = 0;
+    ASSERT_EQ(persist.Load(data), RESULT_FAIL_NO_DATA);
+    ASSERT_EQ(persist.Save(42), RESULT_SUCCESS);
+    ASSERT_EQ(persist.Load(data), RESULT_SUCCESS);
+    ASSERT_EQ(data, 42u);
+}
+
+TEST_F(AsyncPersistTest, Completion)
+{
+    AsyncType a{loop_, mem_a_};
+    AsyncType b{loop_, mem_b_};
+    std::vector<std::string> events;
+
+    auto count = [&](AsyncType& persist, std::string name) -> demo::Task<void>
+    {
+        EXPECT_EQ(co_await persist.InitAsync(), RESULT_SUCCESS);
+
+        for (uint32_t i = 1; i <= 3; i++)
+        {
+            EXPECT_EQ(co_await persist.SaveAsync(i), RESULT_SUCCESS);
+            events.push_back(name + std::to_string(i));
+        }
+
+        uint32_t data = 0;
+        EXPECT_EQ(co_await persist.LoadAsync(data), RESULT_SUCCESS);
+        EXPECT_EQ(data, 3u);
+        events.push_back(name + "done");
+    };
+
+    loop_.Spawn(count(a, "a"));
+    loop_.Spawn(count(b, "b"));
+
+    // Nothing runs until the loop does
+    ASSERT_TRUE(events.empty());
+    loop_.Run();
+
+    // Each operation suspends, so the two objects take turns
+    std::vector<std::string> expected{"a1", "b1", "a2", "b2", "a3", "b3",
+        "adone", "bdone"};
+    ASSERT_EQ(events, expected);
+
+    PersistType check{mem_b_};
+    ASSERT_EQ(check.Init(), RESULT_SUCCESS);
+    uint32_t data = 0;
+    ASSERT_EQ(check.Load(data), RESULT_SUCCESS);
+    ASSERT_EQ(data, 3u);
+}
+
+TEST_F(AsyncPersistTest, FailedResult)
+{
+    AsyncType persist{loop_, mem_a_};
+    ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+
+    auto save = [&]() -> demo::Task<Result>
+    {
+        // A result from a nested task reaches the outer one
+        co_return co_await persist.SaveAsync(7);
+    };
+
+    mem_a_.fail_writes = true;
+    ASSERT_NE(loop_.SyncWait(save()), RESULT_SUCCESS);
+
+    uint32_t data = 0;
+    ASSERT_EQ(persist.Load(data), RESULT_FAIL_NO_DATA);
+}
+
+TEST_F(AsyncPersistTest, Exception)
+{
+    AsyncType persist{loop_, mem_a_};
+    ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+    ASSERT_EQ(persist.Save(5), RESULT_SUCCESS);
+
+    mem_a_.throw_reads = true;
+    bool caught = false;
+
+    auto load = [&]() -> demo::Task<void>
+    {
+        uint32_t data = 0;
+
+        try
+        {
+            co_await persist.LoadAsync(data);
+        }
+        catch (const std::runtime_error&)
+        {
+            caught = true;
+        }
+    };
+
+    loop_.SyncWait(load());
+    ASSERT_TRUE(caught);
+
+    // Uncaught, it escapes SyncWait
+    uint32_t data = 0;
+    ASSERT_THROW(persist.Load(data), std::runtime_error);
+
+    // and Run, for a spawned task
+    auto spawned = [&]() -> demo::Task<void>
+    {
+        uint32_t value = 0;
+        co_await persist.LoadAsync(value);
+    };
+
+    loop_.Spawn(spawned());
+    ASSERT_THROW(loop_.Run(), std::runtime_error);
+
+    mem_a_.throw_reads = false;
+    ASSERT_EQ(persist.Load(data), RESULT_SUCCESS);
+    ASSERT_EQ(data, 5u);
+}
+
+TEST_F(AsyncPersistTest, AwaitsMemory)
+{
+    std::vector<std::string> events;
+    LoopMemory memory{loop_, events};
+    LoopPersistType persist{loop_, memory};
+    ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+
+    auto ticker = [&]() -> demo::Task<void>
+    {
+        for (uint32_t i = 0; i < 8; i++)
+        {
+            events.push_back("tick");
+            co_await loop_.Schedule();
+        }
+    };
+
+    auto save = [](LoopPersistType& persist, uint32_t value) ->
+        demo::Task<void>
+    {
+        EXPECT_EQ(co_await persist.SaveAsync(value), RESULT_SUCCESS);
+    };
+
+    // Save until Persist wraps around and has to erase
+    uint32_t target = 0;
+
+    do
+    {
+        events.clear();
+        loop_.Spawn(save(persist, ++target));
+        loop_.Spawn(ticker());
+        loop_.Run();
+        ASSERT_LT(target, MemType::kSize);
+    }
+    while (std::find(events.begin(), events.end(), "erase") == events.end());
+
+    // The loop ran the ticker between the erase and the write of one Save
+    auto erase = std::find(events.begin(), events.end(), "erase");
+    auto write = std::find(erase, events.end(), "write");
+    ASSERT_NE(write, events.end());
+    ASSERT_NE(std::find(erase, write, "tick"), write);
+
+    uint32_t data = 0;
+    Persist<LoopMemory, uint32_t, 0> check{memory};
+    ASSERT_EQ(check.Init(), RESULT_SUCCESS);
+    ASSERT_EQ(check.Load(data), RESULT_SUCCESS);
+    ASSERT_EQ(data, target);
+}
+
+TEST_F(AsyncPersistTest, AwaitsMemoryInOrder)
+{
+    std::vector<std::string> events;
+    LoopMemory memory{loop_, events};
+    LoopPersistType persist{loop_, memory};
+    ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+
+    auto save = [](LoopPersistType& persist, uint32_t value) ->
+        demo::Task<void>
+    {
+        EXPECT_EQ(co_await persist.SaveAsync(value), RESULT_SUCCESS);
+    };
+
+    // Saves on one object queue behind each other
+    for (uint32_t i = 1; i <= 20; i++)
+    {
+        loop_.Spawn(save(persist, i));
+    }
+
+    loop_.Run();
+
+    uint32_t data = 0;
+    ASSERT_EQ(persist.Load(data), RESULT_SUCCESS);
+    ASSERT_EQ(data, 20u);
+
+    Persist<LoopMemory, uint32_t, 0> check{memory};
+    ASSERT_EQ(check.Init(), RESULT_SUCCESS);
+    ASSERT_EQ(check.Load(data), RESULT_SUCCESS);
+    ASSERT_EQ(data, 20u);
+}
+
+TEST_F(AsyncPersistTest, AwaitsMemoryFailure)
+{
+    std::vector<std::string> events;
+    LoopMemory memory{loop_, events};
+    LoopPersistType persist{loop_, memory};
+    ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+    ASSERT_EQ(persist.Save(5), RESULT_SUCCESS);
+
+    memory.fail_writes = true;
+    ASSERT_EQ(persist.Save(6), RESULT_FAIL_MEMORY);
+    memory.fail_writes = false;
+
+    // Load reads the medium back in rather than trusting the copy
+    uint32_t data = 0;
+    ASSERT_EQ(persist.Load(data), RESULT_SUCCESS);
+    ASSERT_EQ(data, 5u);
+    ASSERT_EQ(persist.Save(7), RESULT_SUCCESS);
+
+    Persist<LoopMemory, uint32_t, 0> check{memory};
+    ASSERT_EQ(check.Init(), RESULT_SUCCESS);
+    ASSERT_EQ(check.Load(data), RESULT_SUCCESS);
+    ASSERT_EQ(data, 7u);
+}
+
+}
@@ -0,0 +1,183 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "util/blank_scan.h"
+#include "unit_tests/test_memory.h"
+
+namespace persist::test
+{
+
+static uint32_t ReferenceFind(const uint8_t* data, uint32_t size, uint8_t fill)
+{
+    for (uint32_t i = 0; i < size; i++)
+    {
+        if (data[i] != fill)
+        {
+            return i;
+        }
+    }
+
+    return size;
+}
+
+// Every kernel this build and CPU can run, whichever is dispatched to
+static std::vector<demo::detail::BlankScanKernel> Kernels(void)
+{
+    std::vector<demo::detail::BlankScanKernel> kernels{
+        {"word", demo::detail::FindFirstNotFillWord}};
+
+#if defined(__SSE2__)
+    kernels.push_back({"sse2", demo::detail::FindFirstNotFillSse2});
+#endif
+
+#if defined(DEMO_BLANK_SCAN_AVX2)
+    if (demo::detail::CpuHasAvx2())
+    {
+        kernels.push_back({"avx2", demo::detail::FindFirstNotFillAvx2});
+    }
+#endif
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+    kernels.push_back({"neon", demo::detail::FindFirstNotFillNeon});
+#endif
+
+    return kernels;
+}
+
+TEST(BlankScanTest, Dispatch)
+{
+    std::string name = demo::BlankScanKernelName();
+
+#if defined(DEMO_BLANK_SCAN_AVX2)
+    if (demo::detail::CpuHasAvx2())
+    {
+        ASSERT_EQ(name, "avx2");
+        return;
+    }
+#endif
+
+    ASSERT_EQ(name, Kernels().back().name);
+}
+
+TEST(BlankScanTest, Exhaustive)
+{
+    constexpr uint32_t kMaxSize = 100;
+    uint8_t buffer[kMaxSize + 32];
+
+    for (auto& kernel : Kernels())
+    {
+        SCOPED_TRACE(kernel.name);
+
+        for (uint8_t fill : {uint8_t(0xFF), uint8_t(0x00)})
+        {
+            for (uint32_t offset = 0; offset < 32; offset++)
+            {
+                uint8_t* data = buffer + offset;
+
+                for (uint32_t size = 0; size <= kMaxSize; size++)
+                {
+                    memset(buffer, fill, sizeof(buffer));
+                    ASSERT_EQ(kernel.find(data, size, fill), size);
+
+                    for (uint32_t dirty = 0; dirty < size; dirty++)
+                    {
+                        memset(buffer, fill, sizeof(buffer));
+
+                        // Flip a single bit, which is the smallest difference
+                        data[dirty] ^= 1 << (dirty % 8);
+
+                        // Dirty bytes outside the range must be ignored
+                        data[size] = ~fill;
+
+                        ASSERT_EQ(kernel.find(data, size, fill), dirty);
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST(BlankScanTest, IsAllFill)
+{
+    uint8_t buffer[100];
+    memset(buffer, 0xFF, sizeof(buffer));
+    ASSERT_TRUE(demo::IsAllFill(buffer, sizeof(buffer), 0xFF));
+    ASSERT_EQ(demo::FindFirstNotFill(buffer, sizeof(buffer), 0xFF), 100u);
+
+    buffer[77] = 0xFE;
+    ASSERT_FALSE(demo::IsAllFill(buffer, sizeof(buffer), 0xFF));
+    ASSERT_TRUE(demo::IsAllFill(buffer, 77, 0xFF));
+    ASSERT_EQ(demo::FindFirstNotFill(buffer, sizeof(buffer), 0xFF), 77u);
+}
+
+TEST(BlankScanTest, Random)
+{
+    constexpr uint32_t kSize = 4096;
+    static uint8_t data[kSize];
+    std::minstd_rand rng;
+    std::uniform_int_distribution<uint32_t> dist(0, kSize - 1);
+
+    for (uint32_t i = 0; i < 1000; i++)
+    {
+        memset(data, 0xFF, kSize);
+        uint32_t dirty = dist(rng);
+        data[dirty] = dist(rng) & 0xFE;
+        data[dist(rng)] = 0;
+
+        uint32_t size = dist(rng);
+        ASSERT_EQ(demo::FindFirstNotFill(data, size, 0xFF),
+            ReferenceFind(data, size, 0xFF));
+    }
+}
+
+TEST(BlankScanTest, Memory)
+{
+    using MemType = Memory<4096, 256, 4>;
+    MemType memory;
+    memory.Init();
+
+    uint32_t found = 0;
+    ASSERT_TRUE(demo::FindFirstNotFill(memory, 0, 4096, found));
+    ASSERT_EQ(found, 4096u);
+
+    uint8_t byte = 0x7F;
+    memory.Write(3000, &byte, 1);
+    ASSERT_TRUE(demo::FindFirstNotFill(memory, 100, 3900, found));
+    ASSERT_EQ(found, 3000u);
+    ASSERT_TRUE(demo::FindFirstNotFill(memory, 3001, 1095, found));
+    ASSERT_EQ(found, 4096u);
+
+    ASSERT_FALSE(memory.Writable(2996, 8));
+    ASSERT_TRUE(memory.Writable(3004, 8));
+
+    // Reads beyond the end of the memory fail
+    ASSERT_FALSE(demo::FindFirstNotFill(memory, 4000, 200, found));
+}
+
+}
@@ -0,0 +1,176 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include "persist/persist.h"
+#include "util/block_device_memory.h"
+
+namespace persist::test
+{
+
+// Sector-sized writes suit any logical block up to the buffer alignment
+using MemType = demo::BlockDeviceMemory<64 * 1024, 4096, 4096>;
+
+class BlockDeviceMemoryTest : public ::testing::TestWithParam<demo::Durability>
+{
+protected:
+    void SetUp(void) override
+    {
+        char path[] = "/tmp/test_block_device_memory.XXXXXX";
+        int fd = mkstemp(path);
+        ASSERT_GE(fd, 0);
+        close(fd);
+        path_ = path;
+
+        MemType memory{path_, GetParam()};
+
+        if (!memory.valid())
+        {
+            GTEST_SKIP() << "O_DIRECT is not supported on /tmp";
+        }
+    }
+
+    void TearDown(void) override
+    {
+        unlink(path_.c_str());
+    }
+
+    std::string path_;
+};
+
+TEST_P(BlockDeviceMemoryTest, Padded)
+{
+    MemType memory{path_, GetParam()};
+    ASSERT_TRUE(memory.valid());
+    ASSERT_TRUE(memory.Writable(0, MemType::kSize));
+
+    FILE* file = fopen(path_.c_str(), "rb");
+    ASSERT_NE(file, nullptr);
+    fseek(file, 0, SEEK_END);
+    ASSERT_EQ(ftell(file), long(MemType::kSize));
+    fclose(file);
+}
+
+TEST_P(BlockDeviceMemoryTest, Unaligned)
+{
+    MemType memory{path_, GetParam()};
+    uint8_t data[10000];
+
+    for (uint32_t i = 0; i < sizeof(data); i++)
+    {
+        data[i] = i * 7;
+    }
+
+    ASSERT_TRUE(memory.Write(1234, data, sizeof(data)));
+
+    uint8_t readback[10000];
+    ASSERT_TRUE(memory.Read(readback, 1234, sizeof(readback)));
+    ASSERT_EQ(memcmp(data, readback, sizeof(data)), 0);
+
+    // Neighbouring bytes are untouched
+    uint8_t edge[2];
+    ASSERT_TRUE(memory.Read(&edge[0], 1233, 1));
+    ASSERT_TRUE(memory.Read(&edge[1], 1234 + sizeof(data), 1));
+    ASSERT_EQ(edge[0], MemType::kFillByte);
+    ASSERT_EQ(edge[1], MemType::kFillByte);
+
+    ASSERT_FALSE(memory.Writable(0, 4096));
+    ASSERT_FALSE(memory.Erase(0, 512));
+    ASSERT_TRUE(memory.Erase(0, 4 * 4096));
+    ASSERT_TRUE(memory.Writable(0, MemType::kSize));
+    ASSERT_FALSE(memory.Read(data, MemType::kSize - 1, 2));
+}
+
+TEST_P(BlockDeviceMemoryTest, PersistAcrossReopen)
+{
+    {
+        MemType memory{path_, GetParam()};
+        Persist<MemType, uint32_t, 0> persist{memory};
+        ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+
+        for (uint32_t i = 0; i < 100; i++)
+        {
+            ASSERT_EQ(persist.Save(i), RESULT_SUCCESS);
+        }
+
+        ASSERT_TRUE(memory.Sync());
+    }
+
+    MemType memory{path_, GetParam()};
+    Persist<MemType, uint32_t, 0> persist{memory};
+    ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+    uint32_t data = 0;
+    ASSERT_EQ(persist.Load(data), RESULT_SUCCESS);
+    ASSERT_EQ(data, 99u);
+}
+
+TEST(BlockDeviceGeometryTest, RejectsSubSectorWrites)
+{
+    char path[] = "/tmp/test_block_device_memory.XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    close(fd);
+
+    // Logical blocks are at least 512 bytes; without O_DIRECT the memory is
+    // invalid anyway
+    demo::BlockDeviceMemory<64 * 1024, 4096, 256> memory{path};
+    unlink(path);
+    ASSERT_FALSE(memory.valid());
+}
+
+TEST(BlockDeviceGeometryTest, DefaultOnFile)
+{
+    char path[] = "/tmp/test_block_device_memory.XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    close(fd);
+
+    if (!MemType{path}.valid())
+    {
+        unlink(path);
+        GTEST_SKIP() << "O_DIRECT is not supported on /tmp";
+    }
+
+    demo::BlockDeviceMemory<64 * 1024> memory{path};
+    ASSERT_TRUE(memory.valid());
+
+    Persist<decltype(memory), uint32_t, 0> persist{memory};
+    ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+    ASSERT_EQ(persist.Save(7), RESULT_SUCCESS);
+    uint32_t data = 0;
+    ASSERT_EQ(persist.Load(data), RESULT_SUCCESS);
+    unlink(path);
+    ASSERT_EQ(data, 7u);
+}
+
+INSTANTIATE_TEST_SUITE_P(Durability, BlockDeviceMemoryTest,
+    ::testing::Values(demo::DURABILITY_DSYNC, demo::DURABILITY_FDATASYNC,
+        demo::DURABILITY_NONE));
+
+}
@@ -0,0 +1,136 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <cstdint>
+#include <random>
+
+#include <gtest/gtest.h>
+
+#include "persist/persist.h"
+#include "unit_tests/test_memory.h"
+#include "util/cached_memory.h"
+
+namespace persist::test
+{
+
+using CountingMemory = ReadCountingMemory<4096, 256, 4>;
+
+using CachedType = demo::CachedMemory<CountingMemory, 4>;
+
+TEST(CachedMemoryTest, RepeatedInit)
+{
+    CountingMemory memory;
+    memory.Init();
+
+    {
+        Persist<CountingMemory, uint32_t, 0> persist{memory};
+        ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+
+        for (uint32_t i = 0; i < 100; i++)
+        {
+            ASSERT_EQ(persist.Save(i), RESULT_SUCCESS);
+        }
+    }
+
+    // All 16 units fit in the cache, so the second mount reads nothing
+    demo::CachedMemory<CountingMemory, 16> cached{memory};
+
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        uint32_t reads = memory.read_count_;
+        Persist<demo::CachedMemory<CountingMemory, 16>, uint32_t, 0>
+            persist{cached};
+        ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+        uint32_t data = 0;
+        ASSERT_EQ(persist.Load(data), RESULT_SUCCESS);
+        ASSERT_EQ(data, 99u);
+
+        if (i)
+        {
+            ASSERT_EQ(memory.read_count_, reads);
+        }
+    }
+
+    ASSERT_GT(cached.stats().hits, 0u);
+    ASSERT_LE(cached.stats().misses, 16u);
+}
+
+TEST(CachedMemoryTest, Coherent)
+{
+    CountingMemory memory;
+    memory.Init();
+    CachedType cached{memory};
+
+    Memory<4096, 256, 4> reference;
+    reference.Init();
+
+    std::minstd_rand rng;
+    rng.seed(0);
+    uint8_t buffer[600];
+    uint8_t expected[600];
+
+    for (uint32_t i = 0; i < 10000; i++)
+    {
+        uint32_t length = rng() % sizeof(buffer) + 1;
+        uint32_t location = rng() % (4096 - length);
+
+        switch (rng() % 4)
+        {
+        case 0:
+        case 1:
+            ASSERT_TRUE(cached.Read(buffer, location, length));
+            ASSERT_TRUE(reference.Read(expected, location, length));
+            ASSERT_EQ(memcmp(buffer, expected, length), 0);
+            break;
+
+        case 2:
+            location &= ~3u;
+            length = (length + 3) & ~3u;
+
+            for (uint32_t j = 0; j < length; j++)
+            {
+                buffer[j] = rng();
+            }
+
+            ASSERT_EQ(cached.Writable(location, length),
+                reference.Writable(location, length));
+            ASSERT_TRUE(cached.Write(location, buffer, length));
+            ASSERT_TRUE(reference.Write(location, buffer, length));
+            break;
+
+        case 3:
+            location &= ~255u;
+            length = 256;
+            ASSERT_TRUE(cached.Erase(location, length));
+            ASSERT_TRUE(reference.Erase(location, length));
+            ASSERT_TRUE(cached.Writable(location, length));
+            break;
+        }
+    }
+
+    auto& stats = cached.stats();
+    ASSERT_GT(stats.hits, 0u);
+    ASSERT_GT(stats.misses, 0u);
+    ASSERT_GT(stats.evictions, 0u);
+}
+
+}
@@ -0,0 +1,139 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <cstdint>
+
+#include <gtest/gtest.h>
+
+#include "persist/persist.h"
+#include "unit_tests/test_memory.h"
+#include "util/elide_persist.h"
+
+namespace persist::test
+{
+
+using CountingMemory = ReadCountingMemory<4096, 256, 4>;
+
+struct Payload
+{
+    uint32_t values[16];
+};
+
+using PersistType = Persist<CountingMemory, Payload, 0>;
+using ElidingType = demo::ElidingPersist<PersistType, Payload>;
+
+TEST(ElidingPersistTest, ElidesIdenticalSaves)
+{
+    CountingMemory memory;
+    memory.Init();
+    ElidingType persist{memory};
+    ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+
+    Payload payload{};
+
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        payload.values[i % 16] = i;
+        ASSERT_EQ(persist.Save(payload), RESULT_SUCCESS);
+
+        uint32_t reads = memory.read_count_;
+        uint32_t writes = memory.write_count_;
+        ASSERT_EQ(persist.Save(payload), RESULT_SUCCESS);
+        ASSERT_EQ(memory.read_count_, reads);
+        ASSERT_EQ(memory.write_count_, writes);
+    }
+
+    ASSERT_EQ(persist.stats().saves, 200u);
+    ASSERT_EQ(persist.stats().elided, 100u);
+
+    Payload loaded;
+    ASSERT_EQ(persist.Load(loaded), RESULT_SUCCESS);
+    ASSERT_EQ(loaded.values[3], payload.values[3]);
+}
+
+TEST(ElidingPersistTest, FingerprintFromInit)
+{
+    CountingMemory memory;
+    memory.Init();
+
+    Payload payload{};
+    payload.values[0] = 7;
+
+    {
+        PersistType persist{memory};
+        ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+        ASSERT_EQ(persist.Save(payload), RESULT_SUCCESS);
+    }
+
+    demo::ElidingPersist<PersistType, Payload, false> persist{memory};
+    ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+
+    uint32_t writes = memory.write_count_;
+    ASSERT_EQ(persist.Save(payload), RESULT_SUCCESS);
+    ASSERT_EQ(memory.write_count_, writes);
+    ASSERT_EQ(persist.stats().elided, 1u);
+
+    payload.values[0] = 8;
+    ASSERT_EQ(persist.Save(payload), RESULT_SUCCESS);
+    ASSERT_GT(memory.write_count_, writes);
+    ASSERT_EQ(persist.stats().elided, 1u);
+}
+
+TEST(ElidingPersistTest, ExactCompareWithoutHash)
+{
+    CountingMemory memory;
+    memory.Init();
+    demo::ElidingPersist<PersistType, Payload, false> persist{memory};
+    ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+
+    Payload first{};
+    first.values[0] = 1;
+    ASSERT_EQ(persist.Save(first), RESULT_SUCCESS);
+
+    // Find a different payload with the same length and CRC-16
+    demo::ProbedCrc16 crc;
+    crc.Init();
+    crc.Seed(0);
+    uint16_t target = crc.Process(&first, sizeof(first));
+    Payload second = first;
+
+    for (second.values[1] = 1; ; second.values[1]++)
+    {
+        crc.Seed(0);
+
+        if (crc.Process(&second, sizeof(second)) == target)
+        {
+            break;
+        }
+    }
+
+    uint32_t writes = memory.write_count_;
+    ASSERT_EQ(persist.Save(second), RESULT_SUCCESS);
+    ASSERT_GT(memory.write_count_, writes);
+    ASSERT_EQ(persist.stats().elided, 0u);
+
+    Payload loaded;
+    ASSERT_EQ(persist.Load(loaded), RESULT_SUCCESS);
+    ASSERT_EQ(loaded.values[1], second.values[1]);
+}
+
+}
@@ -0,0 +1,235 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <thread>
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "util/file_memory.h"
+#include "util/ram_memory.h"
+#include "util/scatter_gather.h"
+
+namespace persist::test
+{
+
+class FileMemoryTest : public ::testing::Test
+{
+public:
+    std::filesystem::path path_;
+
+    void SetUp() override
+    {
+        // A unique name lets parallel test runs share the temp directory
+        std::string path = (std::filesystem::temp_directory_path() /
+            "test_file_memory.XXXXXX").string();
+        int fd = mkstemp(path.data());
+        ASSERT_GE(fd, 0);
+        close(fd);
+        path_ = path;
+    }
+
+    void TearDown() override
+    {
+        std::filesystem::remove(path_);
+    }
+};
+
+TEST_F(FileMemoryTest, Padded)
+{
+    demo::FileMemory memory(path_);
+    ASSERT_EQ(std::filesystem::file_size(path_), demo::FileMemory::kSize);
+    ASSERT_TRUE(memory.Writable(0, demo::FileMemory::kSize));
+}
+
+TEST_F(FileMemoryTest, ScatterGather)
+{
+    static_assert(demo::HasReadV<demo::FileMemory>::value);
+    static_assert(demo::HasWriteV<demo::FileMemory>::value);
+
+    demo::FileMemory memory(path_);
+
+    uint8_t header[4] = {1, 2, 3, 4};
+    uint8_t payload[28];
+
+    for (uint32_t i = 0; i < sizeof(payload); i++)
+    {
+        payload[i] = 100 + i;
+    }
+
+    demo::ConstSegment src[] = {
+        {header, sizeof(header)},
+        {payload, sizeof(payload)},
+    };
+    ASSERT_TRUE(demo::WriteV(memory, 16, src, 2));
+
+    // Scalar reads observe the vectored write
+    uint8_t flat[32];
+    ASSERT_TRUE(memory.Read(flat, 16, sizeof(flat)));
+    ASSERT_EQ(0, memcmp(flat, header, sizeof(header)));
+    ASSERT_EQ(0, memcmp(flat + sizeof(header), payload, sizeof(payload)));
+    ASSERT_FALSE(memory.Writable(16, 32));
+    ASSERT_TRUE(memory.Writable(48, 16));
+
+    uint8_t header_in[4];
+    uint8_t payload_in[28];
+    demo::Segment dst[] = {
+        {header_in, sizeof(header_in)},
+        {payload_in, sizeof(payload_in)},
+    };
+    ASSERT_TRUE(demo::ReadV(memory, dst, 2, 16));
+    ASSERT_EQ(0, memcmp(header_in, header, sizeof(header)));
+    ASSERT_EQ(0, memcmp(payload_in, payload, sizeof(payload)));
+
+    // Reads past the end of the file fail
+    ASSERT_FALSE(demo::ReadV(memory, dst, 2, demo::FileMemory::kSize - 16));
+}
+
+TEST_F(FileMemoryTest, ManySegments)
+{
+    demo::FileMemory memory(path_);
+
+    // More segments than one preadv/pwritev call takes, with a short one
+    // straddling the chunk boundary
+    constexpr uint32_t kNumSegments = 19;
+    uint8_t out[kNumSegments][5];
+    uint8_t in[kNumSegments][5];
+    demo::ConstSegment src[kNumSegments];
+    demo::Segment dst[kNumSegments];
+    uint32_t total = 0;
+
+    for (uint32_t i = 0; i < kNumSegments; i++)
+    {
+        uint32_t size = (i == 8) ? 1 : 5;
+
+        for (uint32_t j = 0; j < size; j++)
+        {
+            out[i][j] = i * 8 + j;
+        }
+
+        src[i] = {out[i], size};
+        dst[i] = {in[i], size};
+        total += size;
+    }
+
+    ASSERT_TRUE(demo::WriteV(memory, 32, src, kNumSegments));
+
+    uint8_t flat[kNumSegments * 5];
+    ASSERT_TRUE(memory.Read(flat, 32, total));
+    uint32_t offset = 0;
+
+    for (uint32_t i = 0; i < kNumSegments; i++)
+    {
+        ASSERT_EQ(0, memcmp(flat + offset, out[i], src[i].size)) << i;
+        offset += src[i].size;
+    }
+
+    ASSERT_TRUE(demo::ReadV(memory, dst, kNumSegments, 32));
+
+    for (uint32_t i = 0; i < kNumSegments; i++)
+    {
+        ASSERT_EQ(0, memcmp(in[i], out[i], dst[i].size)) << i;
+    }
+
+    // A failure in a later chunk fails the whole call
+    ASSERT_FALSE(demo::ReadV(memory, dst, kNumSegments,
+        demo::FileMemory::kSize - 48));
+}
+
+TEST_F(FileMemoryTest, SharedBetweenThreads)
+{
+    demo::FileMemory memory(path_);
+
+    constexpr uint32_t kNumThreads = 4;
+    constexpr uint32_t kRegion = demo::FileMemory::kSize / kNumThreads;
+    std::vector<std::thread> threads;
+    std::atomic<uint32_t> failures{0};
+
+    // Each thread owns a region of the file. With a shared seek position
+    // the threads' reads and writes would land in each other's regions.
+    for (uint32_t t = 0; t < kNumThreads; t++)
+    {
+        threads.emplace_back([&, t]()
+        {
+            uint8_t out[kRegion];
+            uint8_t in[kRegion];
+
+            for (uint32_t i = 0; i < 1000; i++)
+            {
+                memset(out, t * 16 + (i & 15), kRegion);
+
+                if (!memory.Write(t * kRegion, out, kRegion) ||
+                    !memory.Read(in, t * kRegion, kRegion) ||
+                    memcmp(in, out, kRegion))
+                {
+                    failures++;
+                }
+            }
+        });
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    ASSERT_EQ(failures, 0u);
+}
+
+TEST(ScatterGatherTest, Fallback)
+{
+    using MemType = demo::RamMemory<64>;
+    static_assert(!demo::HasReadV<MemType>::value);
+    static_assert(!demo::HasWriteV<MemType>::value);
+
+    MemType memory;
+    memory.Init();
+
+    uint8_t a[3] = {1, 2, 3};
+    uint8_t b[5] = {4, 5, 6, 7, 8};
+    demo::ConstSegment src[] = {{a, sizeof(a)}, {b, sizeof(b)}};
+    ASSERT_TRUE(demo::WriteV(memory, 10, src, 2));
+
+    for (uint32_t i = 0; i < 8; i++)
+    {
+        ASSERT_EQ(memory.mem_[10 + i], i + 1);
+    }
+
+    uint8_t c[6];
+    uint8_t d[2];
+    demo::Segment dst[] = {{c, sizeof(c)}, {d, sizeof(d)}};
+    ASSERT_TRUE(demo::ReadV(memory, dst, 2, 10));
+    ASSERT_EQ(c[0], 1);
+    ASSERT_EQ(c[5], 6);
+    ASSERT_EQ(d[0], 7);
+    ASSERT_EQ(d[1], 8);
+}
+
+}
@@ -0,0 +1,200 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include "persist/persist.h"
+#include "unit_tests/test_memory.h"
+#include "util/file_memory.h"
+#include "util/group_commit.h"
+#include "util/partition_memory.h"
+
+namespace persist::test
+{
+
+TEST(GroupCommitTest, BatchesConcurrentCommits)
+{
+    static constexpr uint32_t kNumThreads = 8;
+    static constexpr uint32_t kCommitsPerThread = 50;
+
+    std::atomic<uint32_t> syncs{0};
+    demo::GroupCommit group{[&]()
+    {
+        syncs++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return true;
+    }};
+
+    std::vector<std::thread> threads;
+    std::atomic<uint32_t> failures{0};
+
+    for (uint32_t i = 0; i < kNumThreads; i++)
+    {
+        threads.emplace_back([&]()
+        {
+            for (uint32_t j = 0; j < kCommitsPerThread; j++)
+            {
+                failures += !group.Commit();
+            }
+        });
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    auto stats = group.stats();
+    ASSERT_EQ(failures, 0u);
+    ASSERT_EQ(stats.commits, kNumThreads * kCommitsPerThread);
+    ASSERT_EQ(stats.batches, syncs);
+    ASSERT_LT(stats.batches, stats.commits);
+    ASSERT_GT(stats.max_batch, 1u);
+}
+
+TEST(GroupCommitTest, Window)
+{
+    demo::GroupCommit group{[]() { return true; },
+        std::chrono::milliseconds(100), 4};
+
+    std::vector<std::thread> threads;
+
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        threads.emplace_back([&]() { ASSERT_TRUE(group.Commit()); });
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    // The leader waited for the batch to fill rather than the full window
+    auto stats = group.stats();
+    ASSERT_EQ(stats.commits, 4u);
+    ASSERT_EQ(stats.batches, 1u);
+    ASSERT_EQ(stats.max_batch, 4u);
+}
+
+TEST(GroupCommitTest, SyncFailure)
+{
+    bool ok = false;
+    demo::GroupCommit group{[&]() { return ok; }};
+
+    ASSERT_FALSE(group.Commit());
+    ok = true;
+    ASSERT_TRUE(group.Commit());
+    ASSERT_EQ(group.stats().failed_batches, 1u);
+}
+
+TEST(GroupCommitTest, SaveSyncFailure)
+{
+    using MemType = Memory<1024, 64, 4>;
+    MemType memory;
+    memory.Init();
+
+    bool ok = false;
+    demo::GroupCommit group{[&]() { return ok; }};
+    demo::GroupCommitPersist<Persist<MemType, uint32_t, 0>, uint32_t> persist{
+        group, memory};
+    ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+    ASSERT_EQ(persist.Save(1), RESULT_FAIL_MEMORY);
+
+    ok = true;
+    ASSERT_EQ(persist.Save(2), RESULT_SUCCESS);
+    uint32_t data = 0;
+    ASSERT_EQ(persist.Load(data), RESULT_SUCCESS);
+    ASSERT_EQ(data, 2u);
+}
+
+TEST(GroupCommitTest, SharedFile)
+{
+    static constexpr uint32_t kNumSlots = 4;
+    using MemType = demo::BasicFileMemory<kNumSlots * 1024, 64, 16>;
+    using SlotMemory = demo::PartitionMemory<MemType, 1024>;
+    using SlotPersist = demo::GroupCommitPersist<
+        Persist<SlotMemory, uint32_t, 0>, uint32_t>;
+
+    std::string path = "/tmp/test_group_commit." + std::to_string(getpid());
+    unlink(path.c_str());
+
+    {
+        MemType memory{path};
+        demo::GroupCommit group{[&]() { return memory.Sync(); }};
+        std::vector<std::unique_ptr<SlotMemory>> slot_memories;
+        std::vector<std::unique_ptr<SlotPersist>> slots;
+
+        for (uint32_t i = 0; i < kNumSlots; i++)
+        {
+            slot_memories.push_back(
+                std::make_unique<SlotMemory>(memory, i * 1024));
+            slots.push_back(
+                std::make_unique<SlotPersist>(group, *slot_memories.back()));
+            ASSERT_EQ(slots.back()->Init(), RESULT_SUCCESS);
+        }
+
+        std::vector<std::thread> threads;
+
+        for (uint32_t i = 0; i < kNumSlots; i++)
+        {
+            threads.emplace_back([&, i]()
+            {
+                for (uint32_t j = 0; j < 20; j++)
+                {
+                    ASSERT_EQ(slots[i]->Save(i * 100 + j), RESULT_SUCCESS);
+                }
+            });
+        }
+
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        ASSERT_EQ(group.stats().commits, kNumSlots * 20);
+    }
+
+    MemType memory{path};
+
+    for (uint32_t i = 0; i < kNumSlots; i++)
+    {
+        SlotMemory slot_memory{memory, i * 1024};
+        Persist<SlotMemory, uint32_t, 0> persist{slot_memory};
+        ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+        uint32_t data = 0;
+        ASSERT_EQ(persist.Load(data), RESULT_SUCCESS);
+        ASSERT_EQ(data, i * 100 + 19);
+    }
+
+    unlink(path.c_str());
+}
+
+}
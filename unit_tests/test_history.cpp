@@ -0,0 +1,190 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <cstdint>
+
+#include <gtest/gtest.h>
+
+#include "persist/persist.h"
+#include "util/history.h"
+#include "unit_tests/test_memory.h"
+
+namespace persist::test
+{
+
+class HistoryTest : public ::testing::Test
+{
+public:
+    using MemType = Memory<1024, 64, 4>;
+    using PersistType = Persist<MemType, uint32_t, 0>;
+    using HistoryType = demo::PersistHistory<MemType, uint32_t, 0>;
+
+    MemType mem_;
+    PersistType persist_{mem_};
+
+    void SetUp() override
+    {
+        mem_.Init();
+        persist_.Init();
+    }
+};
+
+TEST_F(HistoryTest, Empty)
+{
+    HistoryType history{mem_};
+    ASSERT_EQ(history.Init(), RESULT_SUCCESS);
+    ASSERT_EQ(history.size(), 0u);
+
+    uint32_t data = 0;
+    ASSERT_EQ(history.LoadGeneration(0, data), RESULT_FAIL_NO_DATA);
+}
+
+TEST_F(HistoryTest, NewestFirst)
+{
+    for (uint32_t i = 1; i <= 5; i++)
+    {
+        ASSERT_EQ(persist_.Save(i), RESULT_SUCCESS);
+    }
+
+    HistoryType history{mem_};
+    ASSERT_EQ(history.Init(), RESULT_SUCCESS);
+    ASSERT_EQ(history.size(), 5u);
+
+    uint32_t expected = 5;
+
+    for (auto& generation : history)
+    {
+        ASSERT_EQ(generation.data, expected--);
+        ASSERT_LE(generation.location + generation.size, MemType::kSize);
+    }
+
+    uint32_t data = 0;
+    ASSERT_EQ(history.LoadGeneration(2, data), RESULT_SUCCESS);
+    ASSERT_EQ(data, 3u);
+    ASSERT_EQ(history.LoadGeneration(5, data), RESULT_FAIL_NO_DATA);
+}
+
+TEST_F(HistoryTest, Depth)
+{
+    for (uint32_t i = 1; i <= 20; i++)
+    {
+        ASSERT_EQ(persist_.Save(i), RESULT_SUCCESS);
+    }
+
+    HistoryType history{mem_};
+    ASSERT_EQ(history.Init(), RESULT_SUCCESS);
+    ASSERT_EQ(history.size(), HistoryType::kDefaultDepth);
+
+    // The newest generations are the ones found
+    HistoryType shallow{mem_, 3};
+    ASSERT_EQ(shallow.Init(), RESULT_SUCCESS);
+    ASSERT_EQ(shallow.size(), 3u);
+    ASSERT_EQ(shallow[0].data, 20u);
+    ASSERT_EQ(shallow[2].data, 18u);
+}
+
+TEST_F(HistoryTest, RecycledGenerations)
+{
+    constexpr uint32_t kNumSaves = 1000;
+
+    for (uint32_t i = 1; i <= kNumSaves; i++)
+    {
+        ASSERT_EQ(persist_.Save(i), RESULT_SUCCESS);
+    }
+
+    HistoryType history{mem_, kNumSaves};
+    ASSERT_EQ(history.Init(), RESULT_SUCCESS);
+    ASSERT_GE(history.size(), 2u);
+    ASSERT_LT(history.size(), kNumSaves);
+
+    // Surviving generations are listed newest first
+    ASSERT_EQ(history[0].data, kNumSaves);
+
+    for (uint32_t n = 1; n < history.size(); n++)
+    {
+        ASSERT_LT(history[n].data, history[n - 1].data);
+    }
+}
+
+TEST_F(HistoryTest, Rollback)
+{
+    ASSERT_EQ(persist_.Save(100), RESULT_SUCCESS);
+    ASSERT_EQ(persist_.Save(666), RESULT_SUCCESS);
+
+    HistoryType history{mem_};
+    ASSERT_EQ(history.Init(), RESULT_SUCCESS);
+
+    uint32_t good = 0;
+    ASSERT_EQ(history.LoadGeneration(1, good), RESULT_SUCCESS);
+    ASSERT_EQ(persist_.Save(good), RESULT_SUCCESS);
+
+    PersistType read_persist{mem_};
+    ASSERT_EQ(read_persist.Init(), RESULT_SUCCESS);
+    uint32_t data = 0;
+    ASSERT_EQ(read_persist.Load(data), RESULT_SUCCESS);
+    ASSERT_EQ(data, 100u);
+}
+
+TEST(HistoryScanTest, SingleScan)
+{
+    using MemType = ReadCountingMemory<1024, 64, 4>;
+
+    MemType mem;
+    mem.Init();
+    Persist<MemType, uint32_t, 0> persist{mem};
+    ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+
+    for (uint32_t i = 1; i <= 20; i++)
+    {
+        ASSERT_EQ(persist.Save(i), RESULT_SUCCESS);
+    }
+
+    // The medium is read once, however many generations there are
+    mem.read_count_ = 0;
+    demo::PersistHistory<MemType, uint32_t, 0> history{mem, 20};
+    ASSERT_EQ(history.Init(), RESULT_SUCCESS);
+    ASSERT_GE(history.size(), 2u);
+    ASSERT_EQ(mem.read_count_, 1u);
+}
+
+TEST_F(HistoryTest, CorruptGenerationSkipped)
+{
+    for (uint32_t i = 1; i <= 3; i++)
+    {
+        ASSERT_EQ(persist_.Save(i), RESULT_SUCCESS);
+    }
+
+    HistoryType before{mem_};
+    ASSERT_EQ(before.Init(), RESULT_SUCCESS);
+    ASSERT_EQ(before.size(), 3u);
+
+    // Corrupt the middle generation
+    mem_.mem_[before[1].location] ^= 1;
+
+    HistoryType after{mem_};
+    ASSERT_EQ(after.Init(), RESULT_SUCCESS);
+    ASSERT_EQ(after.size(), 2u);
+    ASSERT_EQ(after[0].data, 3u);
+    ASSERT_EQ(after[1].data, 1u);
+}
+
+}
@@ -0,0 +1,90 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <cstdint>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "persist/persist.h"
+#include "util/image_builder.h"
+#include "util/span_memory.h"
+
+namespace persist::test
+{
+
+TEST(ImageBuilderTest, LoadsOnTarget)
+{
+    using MemType = demo::SpanMemory<1024, 256, 4>;
+    using PersistType = Persist<MemType, uint32_t, 3>;
+    constexpr uint32_t kNumUnits = 500;
+
+    std::vector<uint32_t> values;
+
+    for (uint32_t i = 0; i < kNumUnits; i++)
+    {
+        values.push_back(0xA5000000 + i);
+    }
+
+    std::vector<uint8_t> images(kNumUnits * MemType::kSize, 0);
+    bool built[kNumUnits];
+    uint32_t failures = demo::BuildImages<MemType, uint32_t, 3>(
+        values.data(), kNumUnits, images.data(), 4, built);
+    ASSERT_EQ(failures, 0u);
+
+    for (uint32_t i = 0; i < kNumUnits; i++)
+    {
+        ASSERT_TRUE(built[i]);
+
+        MemType memory{&images[i * MemType::kSize]};
+        PersistType persist{memory};
+        ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+
+        uint32_t data = 0;
+        ASSERT_EQ(persist.Load(data), RESULT_SUCCESS);
+        ASSERT_EQ(data, values[i]);
+
+        // The unit can keep saving from the provisioned state
+        ASSERT_EQ(persist.Save(data + 1), RESULT_SUCCESS);
+    }
+}
+
+TEST(ImageBuilderTest, SpanMemoryWritesOnlyErased)
+{
+    using MemType = demo::SpanMemory<1024, 256, 4>;
+    std::vector<uint8_t> buffer(MemType::kSize, 0);
+    MemType memory{buffer.data()};
+    uint32_t value = 0x12345678;
+
+    // Not erased yet
+    ASSERT_FALSE(memory.Write(0, &value, sizeof(value)));
+
+    memory.Format();
+    ASSERT_TRUE(memory.Write(0, &value, sizeof(value)));
+    ASSERT_FALSE(memory.Write(0, &value, sizeof(value)));
+    ASSERT_FALSE(memory.Write(2, &value, sizeof(value)));
+
+    ASSERT_TRUE(memory.Erase(0, MemType::kEraseGranularity));
+    ASSERT_TRUE(memory.Write(0, &value, sizeof(value)));
+}
+
+}
@@ -0,0 +1,300 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "persist/persist.h"
+#include "util/image_tool.h"
+#include "util/span_memory.h"
+
+namespace persist::test
+{
+
+class ImageToolTest : public ::testing::Test
+{
+public:
+    using MemType = demo::SpanMemory<1024, 64, 4>;
+    using Commands = demo::ProfileCommands<MemType, 4, 0>;
+    using Data = Commands::Data;
+
+    const demo::Profile profile_ = Commands::Make("test", "test images");
+    std::filesystem::path dir_;
+
+    void SetUp() override
+    {
+        std::string dir = (std::filesystem::temp_directory_path() /
+            "test_image_tool.XXXXXX").string();
+        ASSERT_NE(mkdtemp(dir.data()), nullptr);
+        dir_ = dir;
+    }
+
+    void TearDown() override
+    {
+        std::filesystem::remove_all(dir_);
+    }
+
+    static Data Value(uint32_t n)
+    {
+        Data data;
+        std::memcpy(data.bytes, &n, sizeof(n));
+        return data;
+    }
+
+    // Writes an image holding the values 1 to num_saves.
+    std::string Generate(const char* name, uint32_t num_saves)
+    {
+        std::vector<uint8_t> image(MemType::kSize);
+        MemType memory{image.data()};
+        memory.Format();
+        Persist<MemType, Data, 0> persist{memory};
+        EXPECT_EQ(persist.Init(), RESULT_SUCCESS);
+
+        for (uint32_t i = 1; i <= num_saves; i++)
+        {
+            EXPECT_EQ(persist.Save(Value(i)), RESULT_SUCCESS);
+        }
+
+        return WriteFile(name, image);
+    }
+
+    std::string WriteFile(const char* name, const std::vector<uint8_t>& bytes)
+    {
+        std::string path = (dir_ / name).string();
+        FILE* file = fopen(path.c_str(), "wb");
+        EXPECT_NE(file, nullptr);
+        EXPECT_EQ(fwrite(bytes.data(), 1, bytes.size(), file), bytes.size());
+        fclose(file);
+        return path;
+    }
+
+    static std::vector<uint8_t> ReadFile(const std::string& path)
+    {
+        std::vector<uint8_t> bytes(std::filesystem::file_size(path));
+        FILE* file = fopen(path.c_str(), "rb");
+        EXPECT_NE(file, nullptr);
+        EXPECT_EQ(fread(bytes.data(), 1, bytes.size(), file), bytes.size());
+        fclose(file);
+        return bytes;
+    }
+
+    bool Run(const char* command, const std::string& path,
+        std::string& report)
+    {
+        return demo::RunImageCommand(profile_,
+            *demo::FindImageCommand(command), path.c_str(), report);
+    }
+
+    // Newest value a fresh Persist finds in the image at path.
+    static bool Newest(const std::string& path, uint32_t& value)
+    {
+        std::vector<uint8_t> image = ReadFile(path);
+        MemType memory{image.data()};
+        Persist<MemType, Data, 0> persist{memory};
+        Data data;
+
+        if (persist.Init() != RESULT_SUCCESS ||
+            persist.Load(data) != RESULT_SUCCESS)
+        {
+            return false;
+        }
+
+        std::memcpy(&value, data.bytes, sizeof(value));
+        return true;
+    }
+
+    uint32_t NumFiles(void) const
+    {
+        uint32_t count = 0;
+
+        for (auto& entry : std::filesystem::directory_iterator(dir_))
+        {
+            (void)entry;
+            count++;
+        }
+
+        return count;
+    }
+};
+
+TEST_F(ImageToolTest, Inspect)
+{
+    std::string path = Generate("image.bin", 3);
+    std::vector<uint8_t> before = ReadFile(path);
+
+    std::string report;
+    ASSERT_TRUE(Run("dump", path, report));
+    ASSERT_NE(report.find("generation 0"), std::string::npos);
+    ASSERT_NE(report.find("generation 2"), std::string::npos);
+    ASSERT_EQ(report.find("generation 3"), std::string::npos);
+    ASSERT_NE(report.find(": 03 00 00 00\n"), std::string::npos);
+
+    report.clear();
+    ASSERT_TRUE(Run("verify", path, report));
+    ASSERT_EQ(report, "  OK: 3 valid generations\n");
+
+    report.clear();
+    ASSERT_TRUE(Run("wear", path, report));
+    ASSERT_NE(report.find("erase units:"), std::string::npos);
+
+    // Read-only commands leave the file alone
+    ASSERT_EQ(ReadFile(path), before);
+}
+
+TEST_F(ImageToolTest, Corrupted)
+{
+    std::vector<uint8_t> garbage(MemType::kSize);
+
+    for (uint32_t i = 0; i < garbage.size(); i++)
+    {
+        garbage[i] = i * 37 + 11;
+    }
+
+    std::string path = WriteFile("garbage.bin", garbage);
+    std::string report;
+    ASSERT_FALSE(Run("dump", path, report));
+    ASSERT_FALSE(Run("verify", path, report));
+    ASSERT_TRUE(Run("wear", path, report));
+
+    // Compact refuses to throw away data it cannot read
+    ASSERT_FALSE(Run("compact", path, report));
+    ASSERT_EQ(ReadFile(path), garbage);
+    ASSERT_EQ(NumFiles(), 1u);
+
+    // A file of the wrong size is not touched at all
+    std::string short_path = WriteFile("short.bin",
+        std::vector<uint8_t>(MemType::kSize / 2, 0xFF));
+    report.clear();
+    ASSERT_FALSE(Run("format", short_path, report));
+    ASSERT_NE(report.find("size is not"), std::string::npos);
+    ASSERT_FALSE(Run("compact", (dir_ / "missing.bin").string(), report));
+}
+
+TEST_F(ImageToolTest, CorruptNewestGeneration)
+{
+    std::string path = Generate("image.bin", 3);
+    std::vector<uint8_t> image = ReadFile(path);
+
+    // Damage the newest generation's payload
+    std::vector<uint8_t> scratch = image;
+    MemType memory{scratch.data()};
+    demo::PersistHistory<MemType, Data, 0> history{memory};
+    ASSERT_EQ(history.Init(), RESULT_SUCCESS);
+    image[history[0].location + history[0].size - 1] ^= 0x55;
+    WriteFile("image.bin", image);
+
+    std::string report;
+    ASSERT_TRUE(Run("verify", path, report));
+    ASSERT_EQ(report, "  OK: 2 valid generations\n");
+
+    ASSERT_TRUE(Run("compact", path, report));
+    uint32_t value = 0;
+    ASSERT_TRUE(Newest(path, value));
+    ASSERT_EQ(value, 2u);
+}
+
+TEST_F(ImageToolTest, Compact)
+{
+    std::string path = Generate("image.bin", 40);
+    std::string report;
+    ASSERT_TRUE(Run("compact", path, report));
+    ASSERT_EQ(report, "  compacted\n");
+
+    report.clear();
+    ASSERT_TRUE(Run("verify", path, report));
+    ASSERT_EQ(report, "  OK: 1 valid generation\n");
+
+    uint32_t value = 0;
+    ASSERT_TRUE(Newest(path, value));
+    ASSERT_EQ(value, 40u);
+
+    // No temporary file is left behind
+    ASSERT_EQ(NumFiles(), 1u);
+}
+
+TEST_F(ImageToolTest, CompactSameFileTwice)
+{
+    std::string path = Generate("image.bin", 40);
+    std::string link = (dir_ / "link.bin").string();
+    ASSERT_EQ(symlink(path.c_str(), link.c_str()), 0);
+
+    // Both names resolve to one file; each run uses its own temporary
+    bool ok[2];
+    std::string reports[2];
+    std::thread a([&]() { ok[0] = Run("compact", path, reports[0]); });
+    std::thread b([&]() { ok[1] = Run("compact", link, reports[1]); });
+    a.join();
+    b.join();
+    ASSERT_TRUE(ok[0]) << reports[0];
+    ASSERT_TRUE(ok[1]) << reports[1];
+
+    // The link still points at the compacted image
+    ASSERT_TRUE(std::filesystem::is_symlink(link));
+    ASSERT_EQ(NumFiles(), 2u);
+
+    uint32_t value = 0;
+    ASSERT_TRUE(Newest(link, value));
+    ASSERT_EQ(value, 40u);
+}
+
+TEST_F(ImageToolTest, Format)
+{
+    std::string path = Generate("image.bin", 3);
+    std::string report;
+    ASSERT_TRUE(Run("format", path, report));
+
+    std::vector<uint8_t> image = ReadFile(path);
+    ASSERT_TRUE(demo::IsAllFill(image.data(), image.size(),
+        MemType::kFillByte));
+
+    report.clear();
+    ASSERT_FALSE(Run("verify", path, report));
+    ASSERT_EQ(report, "  FAIL: no valid data\n");
+}
+
+TEST(ImageToolArgsTest, ParseCount)
+{
+    uint32_t count = 0;
+    ASSERT_TRUE(demo::ParseCount("4", count));
+    ASSERT_EQ(count, 4u);
+    ASSERT_FALSE(demo::ParseCount("0", count));
+    ASSERT_FALSE(demo::ParseCount("-1", count));
+    ASSERT_FALSE(demo::ParseCount("+2", count));
+    ASSERT_FALSE(demo::ParseCount(" 2", count));
+    ASSERT_FALSE(demo::ParseCount("2x", count));
+    ASSERT_FALSE(demo::ParseCount("", count));
+    ASSERT_FALSE(demo::ParseCount("99999999999", count));
+    ASSERT_EQ(count, 4u);
+}
+
+}
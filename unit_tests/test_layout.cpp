@@ -0,0 +1,183 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <cstdint>
+
+#include <gtest/gtest.h>
+
+#include "unit_tests/test_memory.h"
+#include "util/layout.h"
+#include "util/persist_log.h"
+#include "util/serializer.h"
+
+namespace persist::test
+{
+
+// A 1-byte payload and 4-byte header share one 32-byte write granule
+using Tiny = demo::BlockLayout<Memory<128, 4, 32>, 4, 1>;
+static_assert(Tiny::kBlockSize == 32);
+static_assert(!Tiny::kSplit);
+static_assert(Tiny::kCapacity == 4);
+static_assert(Tiny::kLayout.padding == 27);
+static_assert(Tiny::kLayout.write_amplification == 32.0);
+
+// Splitting header from payload costs nothing when both fill their granules
+using Exact = demo::BlockLayout<Memory<4096, 256, 16>, 16, 48>;
+static_assert(Exact::kBlockSize == 64);
+static_assert(Exact::kSplit);
+static_assert(Exact::kHeaderOffset == 48);
+static_assert(Exact::kPayloadOffset == 0);
+static_assert(Exact::kBlocksPerUnit == 4);
+static_assert(Exact::kLayout.erases_per_save == 0.25);
+
+// Packing saves a granule when header and payload together fit
+using Packed = demo::BlockLayout<Memory<4096, 256, 16>, 4, 8>;
+static_assert(Packed::kBlockSize == 16);
+static_assert(!Packed::kSplit);
+static_assert(Packed::kCapacity == 256);
+
+// 96-byte blocks leave 64 bytes unused per 256-byte unit unless they may
+// straddle units
+using Straddle = demo::BlockLayout<Memory<4096, 256, 16>, 8, 88>;
+static_assert(Straddle::kBlockSize == 96);
+static_assert(Straddle::kStraddle);
+static_assert(Straddle::kCapacity == 42);
+
+using NoStraddle = demo::BlockLayout<Memory<4096, 256, 16>, 8, 88,
+    demo::LAYOUT_PACKED | demo::LAYOUT_SPLIT | demo::LAYOUT_ALIGNED>;
+static_assert(!NoStraddle::kStraddle);
+static_assert(NoStraddle::kCapacity == 32);
+
+// Blocks larger than an erase unit start on a unit and occupy whole units,
+// unless straddling fits more of them
+using Large = demo::BlockLayout<Memory<1024, 256, 1>, 12, 500>;
+static_assert(!Large::kStraddle);
+static_assert(Large::kBlocksPerUnit == 0);
+static_assert(Large::kUnitsPerBlock == 2);
+static_assert(Large::kLayout.erases_per_save == 2.0);
+
+using LargeStraddle = demo::BlockLayout<Memory<1024, 256, 1>, 4, 300>;
+static_assert(LargeStraddle::kStraddle);
+static_assert(LargeStraddle::kCapacity == 3);
+
+// A unit header takes the first write granule of every unit
+using UnitHeader = demo::BlockLayout<Memory<1024, 256, 16>, 6, 10,
+    demo::LAYOUT_PACKED | demo::LAYOUT_ALIGNED, 10>;
+static_assert(UnitHeader::kUnitDataOffset == 16);
+static_assert(UnitHeader::kBlocksPerUnit == 15);
+static_assert(UnitHeader::kCapacity == 60);
+static_assert(UnitHeader::kMaxPayload == 234);
+static_assert(UnitHeader::kLayout.padding == 0);
+
+// Formats in the tree size themselves from their layouts
+using SerialType = demo::SerializedPersist<Memory<4096, 256, 16>,
+    std::string, 0, 100>;
+static_assert(SerialType::kMaxRecord == 128);
+static_assert(SerialType::kLayout.straddle);
+static_assert(SerialType::kLayout.capacity == 32);
+static_assert(SerialType::kLayout.erases_per_save == 0.5);
+
+using LogType = demo::BasicPersistLog<Memory<4096, 256, 16>>;
+static_assert(LogType::kDataOffset == 16);
+static_assert(LogType::kMaxEntrySize == 234);
+static_assert(LogType::kLayout<10>.blocks_per_unit == 15);
+static_assert(LogType::kLayout<10>.capacity == 240);
+
+static_assert(demo::layout::IsPow2(1));
+static_assert(demo::layout::IsPow2(256));
+static_assert(!demo::layout::IsPow2(0));
+static_assert(!demo::layout::IsPow2(24));
+static_assert(demo::layout::Log2(256) == 8);
+
+static_assert(demo::layout::RoundUp<32>(0) == 0);
+static_assert(demo::layout::RoundUp<32>(1) == 32);
+static_assert(demo::layout::RoundUp<24>(25) == 48);
+static_assert(demo::layout::RoundDown<24>(47) == 24);
+
+template <uint32_t divisor>
+void CheckDivision(void)
+{
+    for (uint32_t x = 0; x < 4 * divisor + 3; x++)
+    {
+        ASSERT_EQ(demo::layout::Div<divisor>(x), x / divisor);
+        ASSERT_EQ(demo::layout::Mod<divisor>(x), x % divisor);
+        ASSERT_EQ(demo::layout::RoundUp<divisor>(x),
+            (x + divisor - 1) / divisor * divisor);
+        ASSERT_EQ(demo::layout::RoundDown<divisor>(x), x / divisor * divisor);
+    }
+}
+
+template <typename Layout>
+void CheckBlocks(void)
+{
+    uint32_t previous = 0;
+
+    for (uint32_t index = 0; index < Layout::kCapacity; index++)
+    {
+        uint32_t location = Layout::BlockLocation(index);
+
+        ASSERT_LE(location + Layout::kBlockSize, Layout::kSize);
+        ASSERT_EQ(location % Layout::kWriteGranularity, 0u);
+        ASSERT_EQ(Layout::BlockIndex(location), index);
+        ASSERT_EQ(Layout::BlockIndex(location + Layout::kBlockSize - 1),
+            index);
+        ASSERT_EQ(Layout::UnitOf(index),
+            location / Layout::kEraseGranularity);
+
+        if (index)
+        {
+            ASSERT_GE(location, previous + Layout::kBlockSize);
+        }
+
+        if (!Layout::kStraddle && Layout::kBlocksPerUnit)
+        {
+            ASSERT_EQ(location / Layout::kEraseGranularity,
+                (location + Layout::kBlockSize - 1) /
+                    Layout::kEraseGranularity);
+        }
+
+        previous = location;
+    }
+}
+
+TEST(LayoutTest, BlocksDoNotOverlap)
+{
+    CheckBlocks<Tiny>();
+    CheckBlocks<Exact>();
+    CheckBlocks<Packed>();
+    CheckBlocks<Straddle>();
+    CheckBlocks<NoStraddle>();
+    CheckBlocks<Large>();
+    CheckBlocks<LargeStraddle>();
+    CheckBlocks<UnitHeader>();
+}
+
+TEST(LayoutTest, MatchesDivision)
+{
+    CheckDivision<1>();
+    CheckDivision<16>();
+    CheckDivision<256>();
+    CheckDivision<24>();
+    CheckDivision<100>();
+}
+
+}
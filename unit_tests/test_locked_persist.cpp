@@ -0,0 +1,225 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "persist/persist.h"
+#include "util/file_memory.h"
+#include "util/lock_policy.h"
+#include "util/locked_persist.h"
+
+namespace persist::test
+{
+
+struct Record
+{
+    uint32_t thread;
+    uint32_t count;
+    uint32_t check;
+
+    static Record Make(uint32_t thread, uint32_t count)
+    {
+        return Record{thread, count, (thread * 0x9E3779B9) ^ count};
+    }
+
+    bool Consistent(void) const
+    {
+        return check == ((thread * 0x9E3779B9) ^ count);
+    }
+};
+
+using LockTypes = ::testing::Types<
+    demo::MutexLock,
+    demo::SpinLock,
+    demo::SharedLock>;
+
+template <typename Lock>
+class LockedPersistTest : public ::testing::Test
+{
+public:
+    static constexpr uint32_t kNumThreads = 4;
+    static constexpr uint32_t kNumSaves = 500;
+
+    using PersistType = Persist<demo::FileMemory, Record, 0>;
+    using LockedType = demo::LockedPersist<PersistType, Record, Lock>;
+
+    std::filesystem::path path_;
+
+    void SetUp() override
+    {
+        path_ = std::filesystem::temp_directory_path() /
+            "test_locked_persist.bin";
+        std::filesystem::remove(path_);
+    }
+
+    void TearDown() override
+    {
+        std::filesystem::remove(path_);
+    }
+};
+
+TYPED_TEST_CASE(LockedPersistTest, LockTypes);
+
+TYPED_TEST(LockedPersistTest, Stress)
+{
+    using Fixture = TestFixture;
+    constexpr uint32_t kNumThreads = Fixture::kNumThreads;
+    constexpr uint32_t kNumSaves = Fixture::kNumSaves;
+
+    demo::FileMemory memory(this->path_);
+    typename Fixture::LockedType persist{memory};
+    ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+
+    std::vector<std::thread> threads;
+    std::atomic<uint32_t> failures{0};
+
+    for (uint32_t t = 0; t < kNumThreads; t++)
+    {
+        // Writer
+        threads.emplace_back([&, t]()
+        {
+            for (uint32_t i = 0; i < kNumSaves; i++)
+            {
+                if (persist.Save(Record::Make(t, i)) != RESULT_SUCCESS)
+                {
+                    failures++;
+                }
+            }
+        });
+
+        // Reader, alternating between the cache and the medium
+        threads.emplace_back([&]()
+        {
+            for (uint32_t i = 0; i < kNumSaves; i++)
+            {
+                Record record;
+                Result result = (i % 2) ? persist.LoadStored(record) :
+                    persist.Load(record);
+
+                if (result == RESULT_SUCCESS && !record.Consistent())
+                {
+                    failures++;
+                }
+            }
+        });
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    ASSERT_EQ(failures, 0u);
+
+    // The medium holds the last value saved by one of the writers
+    Record cached;
+    ASSERT_EQ(persist.Load(cached), RESULT_SUCCESS);
+
+    typename Fixture::PersistType read_persist{memory};
+    ASSERT_EQ(read_persist.Init(), RESULT_SUCCESS);
+    Record stored;
+    ASSERT_EQ(read_persist.Load(stored), RESULT_SUCCESS);
+    ASSERT_TRUE(stored.Consistent());
+    ASSERT_EQ(stored.count, kNumSaves - 1);
+    ASSERT_EQ(stored.thread, cached.thread);
+    ASSERT_EQ(stored.count, cached.count);
+}
+
+TEST(LockedPersistTest, NullLock)
+{
+    auto path = std::filesystem::temp_directory_path() /
+        "test_locked_persist_null.bin";
+    std::filesystem::remove(path);
+
+    {
+        using PersistType = Persist<demo::FileMemory, Record, 0>;
+        demo::FileMemory memory(path);
+        demo::LockedPersist<PersistType, Record, demo::NullLock> persist{
+            memory};
+        ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+
+        Record record;
+        ASSERT_EQ(persist.Load(record), RESULT_FAIL_NO_DATA);
+        ASSERT_EQ(persist.Save(Record::Make(1, 2)), RESULT_SUCCESS);
+
+        demo::LockedPersist<PersistType, Record, demo::NullLock> reopened{
+            memory};
+        ASSERT_EQ(reopened.Init(), RESULT_SUCCESS);
+        ASSERT_EQ(reopened.Load(record), RESULT_SUCCESS);
+        ASSERT_EQ(record.thread, 1u);
+        ASSERT_EQ(record.count, 2u);
+    }
+
+    std::filesystem::remove(path);
+}
+
+TEST(LockedPersistTest, LoadLegacyRefreshesCache)
+{
+    struct OldRecord
+    {
+        uint32_t thread;
+        uint32_t count;
+        uint32_t check;
+
+        operator Record(void) const
+        {
+            return Record{thread, count, check};
+        }
+    };
+
+    auto path = std::filesystem::temp_directory_path() /
+        "test_locked_persist_legacy.bin";
+    std::filesystem::remove(path);
+
+    {
+        demo::FileMemory memory(path);
+        Persist<demo::FileMemory, OldRecord, 0> old{memory};
+        ASSERT_EQ(old.Init(), RESULT_SUCCESS);
+        Record made = Record::Make(3, 4);
+        ASSERT_EQ(old.Save(OldRecord{made.thread, made.count, made.check}),
+            RESULT_SUCCESS);
+
+        using PersistType = Persist<demo::FileMemory, Record, 1>;
+        demo::LockedPersist<PersistType, Record> persist{memory};
+        ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+
+        Record record;
+        ASSERT_EQ(persist.Load(record), RESULT_FAIL_NO_DATA);
+        using OldPersist = Persist<demo::FileMemory, OldRecord, 0>;
+        ASSERT_EQ(persist.LoadLegacy<OldPersist>(record), RESULT_SUCCESS);
+
+        Record cached;
+        ASSERT_EQ(persist.Load(cached), RESULT_SUCCESS);
+        ASSERT_EQ(cached.thread, 3u);
+        ASSERT_EQ(cached.count, 4u);
+    }
+
+    std::filesystem::remove(path);
+}
+
+}
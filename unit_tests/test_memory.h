@@ -0,0 +1,153 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include "util/blank_scan.h"
+
+namespace persist::test
+{
+
+template <uint32_t size, uint32_t erase_granularity, uint32_t write_granularity>
+struct Memory
+{
+    static constexpr uint32_t kSize = size;
+    static constexpr uint32_t kEraseGranularity = erase_granularity;
+    static constexpr uint32_t kWriteGranularity = write_granularity;
+    static constexpr uint8_t kFillByte = 0xFF;
+
+    uint8_t mem_[kSize];
+    uint32_t write_histogram_[kSize];
+    uint32_t erase_histogram_[kSize];
+    uint32_t write_count_;
+    uint32_t erase_count_;
+
+    void Init(void)
+    {
+        memset(mem_, kFillByte, kSize);
+
+        for (uint32_t i = 0; i < kSize; i++)
+        {
+            write_histogram_[i] = 0;
+            erase_histogram_[i] = 0;
+            write_count_ = 0;
+            erase_count_ = 0;
+        }
+    }
+
+    bool Read(void* dst, uint32_t location, uint32_t length)
+    {
+        if (!Accessible(location, length))
+        {
+            return false;
+        }
+
+        auto src = reinterpret_cast<const void*>(&mem_[location]);
+        memcpy(dst, src, length);
+        return true;
+    }
+
+    bool Writable(uint32_t location, uint32_t length)
+    {
+        if (!Accessible(location, length))
+        {
+            return false;
+        }
+
+        if ((location % kWriteGranularity) || (length % kWriteGranularity))
+        {
+            return false;
+        }
+
+        return demo::IsAllFill(&mem_[location], length, kFillByte);
+    }
+
+    bool Write(uint32_t location, const void* src, uint32_t length)
+    {
+        auto dst = reinterpret_cast<void*>(&mem_[location]);
+        memcpy(dst, src, length);
+        write_count_ += length;
+
+        for (uint32_t i = 0; i < length; i++)
+        {
+            write_histogram_[location + i]++;
+        }
+
+        return true;
+    }
+
+    bool Erase(uint32_t location, uint32_t length)
+    {
+        if (!Erasable(location, length))
+        {
+            return false;
+        }
+
+        auto dst = reinterpret_cast<void*>(&mem_[location]);
+        memset(dst, kFillByte, length);
+        erase_count_ += length;
+
+        for (uint32_t i = 0; i < length; i++)
+        {
+            erase_histogram_[location + i]++;
+        }
+
+        return true;
+    }
+
+    bool Accessible(uint32_t location, uint32_t length)
+    {
+        return (location + length) <= kSize;
+    }
+
+    bool Erasable(uint32_t location, uint32_t length)
+    {
+        return Accessible(location, length) &&
+            (location % kEraseGranularity == 0) &&
+            (length % kEraseGranularity == 0);
+    }
+
+    void Fill(uint8_t byte)
+    {
+        std::fill_n(mem_, kSize, byte);
+    }
+};
+
+// Memory that also counts Read calls
+template <uint32_t size, uint32_t erase_granularity, uint32_t write_granularity>
+struct ReadCountingMemory : Memory<size, erase_granularity, write_granularity>
+{
+    uint32_t read_count_ = 0;
+
+    bool Read(void* dst, uint32_t location, uint32_t length)
+    {
+        read_count_++;
+        return Memory<size, erase_granularity, write_granularity>::Read(dst,
+            location, length);
+    }
+};
+
+}
@@ -0,0 +1,311 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "unit_tests/test_memory.h"
+#include "util/mirrored_persist.h"
+
+namespace persist::test
+{
+
+using MemType = Memory<4096, 256, 4>;
+
+// Memory whose reads can be made slow or held up until released, and whose
+// writes can be made to fail
+struct FlakyMemory : MemType
+{
+    std::atomic<bool> slow{false};
+    std::atomic<bool> hold{false};
+    std::atomic<bool> fail{false};
+
+    bool Read(void* dst, uint32_t location, uint32_t length)
+    {
+        if (slow)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+
+        while (hold)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        return MemType::Read(dst, location, length);
+    }
+
+    bool Write(uint32_t location, const void* src, uint32_t length)
+    {
+        return !fail && MemType::Write(location, src, length);
+    }
+};
+
+using MirroredType = demo::MirroredPersist<MemType, FlakyMemory, uint32_t, 0>;
+
+class MirroredPersistTest : public ::testing::Test
+{
+protected:
+    void SetUp(void) override
+    {
+        mem_a_.Init();
+        mem_b_.Init();
+    }
+
+    MemType mem_a_;
+    FlakyMemory mem_b_;
+};
+
+TEST_F(MirroredPersistTest, SaveLoad)
+{
+    MirroredType persist{mem_a_, mem_b_};
+    ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+
+    uint32_t data = 0;
+    ASSERT_EQ(persist.Load(data), RESULT_FAIL_NO_DATA);
+
+    for (uint32_t i = 1; i <= 100; i++)
+    {
+        ASSERT_EQ(persist.Save(i), RESULT_SUCCESS);
+        ASSERT_EQ(persist.Load(data), RESULT_SUCCESS);
+        ASSERT_EQ(data, i);
+    }
+
+    ASSERT_TRUE(persist.synced(0));
+    ASSERT_TRUE(persist.synced(1));
+    auto stats = persist.stats();
+    ASSERT_EQ(stats.loads, 101u);
+    ASSERT_EQ(stats.wins[0] + stats.wins[1], 100u);
+}
+
+TEST_F(MirroredPersistTest, ResyncLaggingBank)
+{
+    {
+        MirroredType persist{mem_a_, mem_b_};
+        ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+
+        for (uint32_t i = 1; i <= 10; i++)
+        {
+            ASSERT_EQ(persist.Save(i), RESULT_SUCCESS);
+        }
+    }
+
+    // Replace bank B with a blank memory
+    mem_b_.Init();
+
+    MirroredType persist{mem_a_, mem_b_};
+    ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+    persist.Drain();
+    ASSERT_TRUE(persist.synced(1));
+    ASSERT_EQ(persist.stats().resyncs, 1u);
+
+    // Bank B alone now holds the newest value
+    mem_a_.Init();
+    MirroredType restored{mem_a_, mem_b_};
+    ASSERT_EQ(restored.Init(), RESULT_SUCCESS);
+    uint32_t data = 0;
+    ASSERT_EQ(restored.Load(data), RESULT_SUCCESS);
+    ASSERT_EQ(data, 10u);
+}
+
+TEST_F(MirroredPersistTest, SlowBankDoesNotStallLoad)
+{
+    MirroredType persist{mem_a_, mem_b_};
+    ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+    ASSERT_EQ(persist.Save(7), RESULT_SUCCESS);
+
+    mem_b_.slow = true;
+    auto start = std::chrono::steady_clock::now();
+    uint32_t data = 0;
+    ASSERT_EQ(persist.Load(data), RESULT_SUCCESS);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    ASSERT_EQ(data, 7u);
+    ASSERT_LT(elapsed, std::chrono::milliseconds(50));
+    ASSERT_EQ(persist.stats().wins[0], 1u);
+
+    mem_b_.slow = false;
+    persist.Drain();
+}
+
+TEST_F(MirroredPersistTest, SlowBankReadsOnce)
+{
+    MirroredType persist{mem_a_, mem_b_};
+    ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+    ASSERT_EQ(persist.Save(7), RESULT_SUCCESS);
+    auto before = persist.stats();
+
+    // Loads answered by bank A join bank B's outstanding read
+    mem_b_.slow = true;
+
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        uint32_t data = 0;
+        ASSERT_EQ(persist.Load(data), RESULT_SUCCESS);
+        ASSERT_EQ(data, 7u);
+    }
+
+    auto stats = persist.stats();
+    ASSERT_EQ(stats.reads[0] - before.reads[0], 100u);
+    ASSERT_LE(stats.reads[1] - before.reads[1], 2u);
+
+    mem_b_.slow = false;
+    persist.Drain();
+}
+
+TEST_F(MirroredPersistTest, FailingBank)
+{
+    MirroredType persist{mem_a_, mem_b_};
+    ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+    ASSERT_EQ(persist.Save(1), RESULT_SUCCESS);
+
+    mem_b_.fail = true;
+    ASSERT_EQ(persist.Save(2), RESULT_SUCCESS);
+    persist.Drain();
+    ASSERT_FALSE(persist.synced(1));
+    ASSERT_EQ(persist.stats().save_failures[1], 1u);
+
+    uint32_t data = 0;
+    ASSERT_EQ(persist.Load(data), RESULT_SUCCESS);
+    ASSERT_EQ(data, 2u);
+
+    mem_b_.fail = false;
+    ASSERT_EQ(persist.Save(3), RESULT_SUCCESS);
+    ASSERT_TRUE(persist.synced(1));
+}
+
+TEST_F(MirroredPersistTest, BothBanksFail)
+{
+    mem_b_.fail = true;
+
+    // Bank A is full of programmed bytes it cannot erase
+    struct StuckMemory : MemType
+    {
+        bool Erase(uint32_t, uint32_t)
+        {
+            return false;
+        }
+    } stuck;
+
+    stuck.Init();
+    memset(stuck.mem_, 0, MemType::kSize);
+
+    demo::MirroredPersist<StuckMemory, FlakyMemory, uint32_t, 0> persist{
+        stuck, mem_b_};
+    ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+    ASSERT_EQ(persist.Save(1), RESULT_FAIL_MEMORY);
+    ASSERT_EQ(persist.stats().save_failures[0], 1u);
+    ASSERT_EQ(persist.stats().save_failures[1], 1u);
+
+    uint32_t data = 0;
+    ASSERT_EQ(persist.Load(data), RESULT_FAIL_NO_DATA);
+}
+
+TEST_F(MirroredPersistTest, HungBankDoesNotStallSave)
+{
+    MirroredType persist{mem_a_, mem_b_, std::chrono::milliseconds(5)};
+    ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+    ASSERT_EQ(persist.Save(1), RESULT_SUCCESS);
+
+    mem_b_.hold = true;
+
+    for (uint32_t i = 2; i <= 10; i++)
+    {
+        ASSERT_EQ(persist.Save(i), RESULT_SUCCESS);
+        ASSERT_FALSE(persist.synced(1));
+    }
+
+    uint32_t data = 0;
+    ASSERT_EQ(persist.Load(data), RESULT_SUCCESS);
+    ASSERT_EQ(data, 10u);
+
+    // Bank B catches up with the newest value once it is released
+    mem_b_.hold = false;
+    persist.Drain();
+    ASSERT_TRUE(persist.synced(1));
+
+    mem_a_.Init();
+    MirroredType restored{mem_a_, mem_b_};
+    ASSERT_EQ(restored.Init(), RESULT_SUCCESS);
+    ASSERT_EQ(restored.Load(data), RESULT_SUCCESS);
+    ASSERT_EQ(data, 10u);
+}
+
+TEST_F(MirroredPersistTest, HungBankDoesNotStallInit)
+{
+    {
+        MirroredType persist{mem_a_, mem_b_};
+        ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+        ASSERT_EQ(persist.Save(5), RESULT_SUCCESS);
+    }
+
+    mem_b_.hold = true;
+    MirroredType persist{mem_a_, mem_b_, std::chrono::milliseconds(5)};
+    ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+    ASSERT_FALSE(persist.synced(1));
+
+    uint32_t data = 0;
+    ASSERT_EQ(persist.Load(data), RESULT_SUCCESS);
+    ASSERT_EQ(data, 5u);
+
+    mem_b_.hold = false;
+    persist.Drain();
+    ASSERT_TRUE(persist.synced(1));
+}
+
+TEST_F(MirroredPersistTest, LateBankWithNewerValue)
+{
+    {
+        MirroredType persist{mem_a_, mem_b_};
+        ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+        ASSERT_EQ(persist.Save(5), RESULT_SUCCESS);
+    }
+
+    // Only bank B holds the newer value
+    {
+        MemType blank;
+        blank.Init();
+        MirroredType persist{blank, mem_b_};
+        ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+        ASSERT_EQ(persist.Save(6), RESULT_SUCCESS);
+        persist.Drain();
+    }
+
+    mem_b_.hold = true;
+    MirroredType persist{mem_a_, mem_b_, std::chrono::milliseconds(5)};
+    ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+
+    mem_b_.hold = false;
+    persist.Drain();
+    ASSERT_TRUE(persist.synced(0));
+
+    uint32_t data = 0;
+    ASSERT_EQ(persist.Load(data), RESULT_SUCCESS);
+    ASSERT_EQ(data, 6u);
+}
+
+}
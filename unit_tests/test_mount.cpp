@@ -0,0 +1,178 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "persist/persist.h"
+#include "util/mount.h"
+#include "unit_tests/test_memory.h"
+
+namespace persist::test
+{
+
+class MountTest : public ::testing::Test
+{
+public:
+    using MemType = Memory<1024, 64, 4>;
+    using PersistType = Persist<MemType, uint32_t, 0>;
+    using LazyType = demo::LazyPersist<PersistType, uint32_t>;
+
+    static constexpr uint32_t kNumInstances = 32;
+
+    std::vector<std::unique_ptr<MemType>> memories_;
+
+    void SetUp() override
+    {
+        for (uint32_t i = 0; i < kNumInstances; i++)
+        {
+            memories_.push_back(std::make_unique<MemType>());
+            memories_.back()->Init();
+
+            PersistType persist{*memories_.back()};
+            persist.Init();
+            persist.Save(i * 10);
+        }
+    }
+};
+
+struct CountingMemory : Memory<1024, 64, 4>
+{
+    uint32_t reads_ = 0;
+
+    bool Read(void* dst, uint32_t location, uint32_t length)
+    {
+        reads_++;
+        return Memory::Read(dst, location, length);
+    }
+};
+
+TEST(LazyPersistTest, DefersScan)
+{
+    CountingMemory memory;
+    memory.Init();
+
+    demo::LazyPersist<Persist<CountingMemory, uint32_t, 0>, uint32_t> persist{
+        memory};
+    ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+    ASSERT_FALSE(persist.mounted());
+    ASSERT_EQ(memory.reads_, 0u);
+
+    ASSERT_EQ(persist.Save(1234), RESULT_SUCCESS);
+    ASSERT_TRUE(persist.mounted());
+
+    uint32_t data = 0;
+    ASSERT_EQ(persist.Load(data), RESULT_SUCCESS);
+    ASSERT_EQ(data, 1234u);
+}
+
+TEST_F(MountTest, Lazy)
+{
+    for (uint32_t i = 0; i < kNumInstances; i++)
+    {
+        LazyType persist{*memories_[i]};
+        ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+
+        uint32_t data = 0;
+        ASSERT_EQ(persist.Load(data), RESULT_SUCCESS);
+        ASSERT_EQ(data, i * 10);
+    }
+}
+
+TEST_F(MountTest, MountRange)
+{
+    std::vector<std::unique_ptr<LazyType>> persists;
+
+    for (auto& memory : memories_)
+    {
+        persists.push_back(std::make_unique<LazyType>(*memory));
+        persists.back()->Init();
+    }
+
+    std::vector<LazyType*> pointers;
+
+    for (auto& persist : persists)
+    {
+        pointers.push_back(persist.get());
+    }
+
+    ASSERT_EQ(demo::MountRange(pointers.begin(), pointers.end(), 4),
+        RESULT_SUCCESS);
+
+    for (uint32_t i = 0; i < kNumInstances; i++)
+    {
+        ASSERT_TRUE(persists[i]->mounted());
+
+        uint32_t data = 0;
+        ASSERT_EQ(persists[i]->Load(data), RESULT_SUCCESS);
+        ASSERT_EQ(data, i * 10);
+    }
+}
+
+TEST_F(MountTest, MountList)
+{
+    // Bidirectional iterators over the objects themselves
+    std::list<LazyType> persists;
+
+    for (auto& memory : memories_)
+    {
+        persists.emplace_back(*memory);
+        persists.back().Init();
+    }
+
+    ASSERT_EQ(demo::MountRange(persists.begin(), persists.end(), 4),
+        RESULT_SUCCESS);
+
+    uint32_t i = 0;
+
+    for (auto& persist : persists)
+    {
+        ASSERT_TRUE(persist.mounted());
+
+        uint32_t data = 0;
+        ASSERT_EQ(persist.Load(data), RESULT_SUCCESS);
+        ASSERT_EQ(data, i * 10);
+        i++;
+    }
+}
+
+TEST_F(MountTest, MountAll)
+{
+    PersistType eager{*memories_[0]};
+    LazyType lazy{*memories_[1]};
+    lazy.Init();
+
+    ASSERT_EQ(demo::MountAll(eager, lazy), RESULT_SUCCESS);
+    ASSERT_TRUE(lazy.mounted());
+
+    uint32_t data = 0;
+    ASSERT_EQ(eager.Load(data), RESULT_SUCCESS);
+    ASSERT_EQ(data, 0u);
+    ASSERT_EQ(lazy.Load(data), RESULT_SUCCESS);
+    ASSERT_EQ(data, 10u);
+}
+
+}
@@ -31,123 +31,11 @@
 
 #include "persist/persist.h"
 #include "util/ram_memory.h"
+#include "unit_tests/test_memory.h"
 
 namespace persist::test
 {
 
-template <uint32_t size, uint32_t erase_granularity, uint32_t write_granularity>
-struct Memory
-{
-    static constexpr uint32_t kSize = size;
-    static constexpr uint32_t kEraseGranularity = erase_granularity;
-    static constexpr uint32_t kWriteGranularity = write_granularity;
-    static constexpr uint8_t kFillByte = 0xFF;
-
-    uint8_t mem_[kSize];
-    uint32_t write_histogram_[kSize];
-    uint32_t erase_histogram_[kSize];
-    uint32_t write_count_;
-    uint32_t erase_count_;
-
-    void Init(void)
-    {
-        memset(mem_, kFillByte, kSize);
-
-        for (uint32_t i = 0; i < kSize; i++)
-        {
-            write_histogram_[i] = 0;
-            erase_histogram_[i] = 0;
-            write_count_ = 0;
-            erase_count_ = 0;
-        }
-    }
-
-    bool Read(void* dst, uint32_t location, uint32_t length)
-    {
-        if (!Accessible(location, length))
-        {
-            return false;
-        }
-
-        auto src = reinterpret_cast<const void*>(&mem_[location]);
-        memcpy(dst, src, length);
-        return true;
-    }
-
-    bool Writable(uint32_t location, uint32_t length)
-    {
-        if (!Accessible(location, length))
-        {
-            return false;
-        }
-
-        if ((location % kWriteGranularity) || (length % kWriteGranularity))
-        {
-            return false;
-        }
-
-        for (uint32_t i = 0; i < length; i++)
-        {
-            if (mem_[location + i] != kFillByte)
-            {
-                return false;
-            }
-        }
-
-        return true;
-    }
-
-    bool Write(uint32_t location, const void* src, uint32_t length)
-    {
-        auto dst = reinterpret_cast<void*>(&mem_[location]);
-        memcpy(dst, src, length);
-        write_count_ += length;
-
-        for (uint32_t i = 0; i < length; i++)
-        {
-            write_histogram_[location + i]++;
-        }
-
-        return true;
-    }
-
-    bool Erase(uint32_t location, uint32_t length)
-    {
-        if (!Erasable(location, length))
-        {
-            return false;
-        }
-
-        auto dst = reinterpret_cast<void*>(&mem_[location]);
-        memset(dst, kFillByte, length);
-        erase_count_ += length;
-
-        for (uint32_t i = 0; i < length; i++)
-        {
-            erase_histogram_[location + i]++;
-        }
-
-        return true;
-    }
-
-    bool Accessible(uint32_t location, uint32_t length)
-    {
-        return (location + length) <= kSize;
-    }
-
-    bool Erasable(uint32_t location, uint32_t length)
-    {
-        return Accessible(location, length) &&
-            (location % kEraseGranularity == 0) &&
-            (length % kEraseGranularity == 0);
-    }
-
-    void Fill(uint8_t byte)
-    {
-        std::fill_n(mem_, kSize, byte);
-    }
-};
-
 template <int A, int B, int C, int D>
 using ParamType = std::tuple<
     std::integral_constant<int, A>,
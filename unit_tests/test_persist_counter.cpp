@@ -0,0 +1,107 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <cstdint>
+
+#include <gtest/gtest.h>
+
+#include "persist/persist.h"
+#include "util/persist_counter.h"
+#include "unit_tests/test_memory.h"
+
+namespace persist::test
+{
+
+class PersistCounterTest : public ::testing::Test
+{
+public:
+    using MemType = Memory<1024, 64, 4>;
+    using CounterType = demo::PersistCounter<MemType, 128>;
+
+    MemType mem_;
+
+    void SetUp() override
+    {
+        mem_.Init();
+    }
+};
+
+TEST_F(PersistCounterTest, StartsAtZero)
+{
+    CounterType counter{mem_};
+    ASSERT_EQ(counter.Init(), RESULT_SUCCESS);
+    ASSERT_EQ(counter.Value(), 0u);
+}
+
+TEST_F(PersistCounterTest, IncrementSurvivesReboot)
+{
+    constexpr uint32_t kCount = 5000;
+
+    CounterType counter{mem_};
+    ASSERT_EQ(counter.Init(), RESULT_SUCCESS);
+
+    for (uint32_t i = 1; i <= kCount; i++)
+    {
+        ASSERT_TRUE(counter.Increment());
+        ASSERT_EQ(counter.Value(), i);
+
+        if (i % 97 == 0 || i % CounterType::kTallyBits == 0)
+        {
+            CounterType reboot{mem_};
+            ASSERT_EQ(reboot.Init(), RESULT_SUCCESS);
+            ASSERT_EQ(reboot.Value(), i);
+        }
+    }
+
+    // Only folds erase, so there are far fewer erases than increments
+    uint32_t erases = mem_.erase_count_ / MemType::kEraseGranularity;
+    ASSERT_LT(erases, kCount / 100);
+}
+
+TEST_F(PersistCounterTest, ExplicitFold)
+{
+    CounterType counter{mem_};
+    ASSERT_EQ(counter.Init(), RESULT_SUCCESS);
+
+    for (uint32_t i = 0; i < 10; i++)
+    {
+        ASSERT_TRUE(counter.Increment());
+    }
+
+    ASSERT_TRUE(counter.Fold());
+    ASSERT_EQ(counter.Value(), 10u);
+    ASSERT_TRUE(counter.Increment());
+
+    CounterType reboot{mem_};
+    ASSERT_EQ(reboot.Init(), RESULT_SUCCESS);
+    ASSERT_EQ(reboot.Value(), 11u);
+
+    // Stale increments in the retired tally are erased by the next fold
+    ASSERT_TRUE(reboot.Fold());
+    ASSERT_TRUE(reboot.Increment());
+
+    CounterType again{mem_};
+    ASSERT_EQ(again.Init(), RESULT_SUCCESS);
+    ASSERT_EQ(again.Value(), 12u);
+}
+
+}
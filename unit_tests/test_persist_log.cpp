@@ -0,0 +1,274 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "unit_tests/test_memory.h"
+#include "util/persist_log.h"
+
+namespace persist::test
+{
+
+using LogMemory = Memory<4096, 256, 16>;
+
+struct Event
+{
+    uint32_t id;
+    uint32_t value;
+};
+
+using EventLog = demo::PersistLog<LogMemory, Event>;
+
+static void ExpectRange(const EventLog& log, uint32_t first, uint32_t last)
+{
+    ASSERT_EQ(log.size(), last - first + 1);
+    uint32_t id = first;
+
+    for (auto event : log)
+    {
+        ASSERT_EQ(event.id, id);
+        ASSERT_EQ(event.value, id * 3);
+        id++;
+    }
+
+    for (auto it = log.rbegin(); it != log.rend(); ++it)
+    {
+        id--;
+        ASSERT_EQ((*it).id, id);
+    }
+}
+
+TEST(PersistLogTest, AppendAndIterate)
+{
+    LogMemory memory;
+    memory.Init();
+
+    {
+        EventLog log{memory};
+        ASSERT_TRUE(log.Init());
+        ASSERT_TRUE(log.empty());
+
+        for (uint32_t i = 0; i < 100; i++)
+        {
+            ASSERT_TRUE(log.Append(Event{i, i * 3}));
+        }
+
+        ExpectRange(log, 0, 99);
+    }
+
+    EventLog log{memory};
+    ASSERT_TRUE(log.Init());
+    ExpectRange(log, 0, 99);
+
+    ASSERT_TRUE(log.Append(Event{100, 300}));
+    ExpectRange(log, 0, 100);
+}
+
+TEST(PersistLogTest, OneWritePerAppend)
+{
+    LogMemory memory;
+    memory.Init();
+    EventLog log{memory};
+    ASSERT_TRUE(log.Init());
+    ASSERT_TRUE(log.Append(Event{0, 0}));
+
+    // A frame with one 8-byte record fits in a single 16-byte granule
+    uint32_t written = memory.write_count_;
+    ASSERT_TRUE(log.Append(Event{1, 3}));
+    ASSERT_EQ(memory.write_count_ - written, 16u);
+}
+
+TEST(PersistLogTest, BatchPacksGranules)
+{
+    LogMemory single;
+    LogMemory batched;
+    single.Init();
+    batched.Init();
+    EventLog a{single};
+    EventLog b{batched};
+    ASSERT_TRUE(a.Init());
+    ASSERT_TRUE(b.Init());
+
+    std::vector<Event> events;
+
+    for (uint32_t i = 0; i < 20; i++)
+    {
+        events.push_back(Event{i, i * 3});
+        ASSERT_TRUE(a.Append(events.back()));
+    }
+
+    ASSERT_TRUE(b.Append(events.data(), events.size()));
+    ExpectRange(b, 0, 19);
+
+    // 20 granules over two units, against 13 granules in one
+    ASSERT_EQ(single.write_count_, 2 * EventLog::kDataOffset + 20 * 16);
+    ASSERT_EQ(batched.write_count_, EventLog::kDataOffset + 13 * 16);
+
+    EventLog reloaded{batched};
+    ASSERT_TRUE(reloaded.Init());
+    ExpectRange(reloaded, 0, 19);
+}
+
+TEST(PersistLogTest, ReclaimsOldestWhenFull)
+{
+    LogMemory memory;
+    memory.Init();
+    EventLog log{memory};
+    ASSERT_TRUE(log.Init());
+
+    uint32_t count = 2000;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        ASSERT_TRUE(log.Append(Event{i, i * 3}));
+    }
+
+    // Only whole units are dropped, and the newest records always survive
+    ASSERT_LT(log.size(), count);
+    ASSERT_GT(log.size(), 0u);
+    ExpectRange(log, count - log.size(), count - 1);
+
+    EventLog reloaded{memory};
+    ASSERT_TRUE(reloaded.Init());
+    ExpectRange(reloaded, count - log.size(), count - 1);
+
+    // The ring spreads erases evenly
+    uint32_t min = UINT32_MAX;
+    uint32_t max = 0;
+
+    for (uint32_t unit = 0; unit < EventLog::kNumUnits; unit++)
+    {
+        min = std::min(min, memory.erase_histogram_[unit * 256]);
+        max = std::max(max, memory.erase_histogram_[unit * 256]);
+    }
+
+    ASSERT_GT(min, 0u);
+    ASSERT_LE(max - min, 1u);
+}
+
+TEST(PersistLogTest, ReclaimOldest)
+{
+    LogMemory memory;
+    memory.Init();
+    EventLog log{memory};
+    ASSERT_TRUE(log.Init());
+
+    // 15 single-granule frames per unit
+    for (uint32_t i = 0; i < 40; i++)
+    {
+        ASSERT_TRUE(log.Append(Event{i, i * 3}));
+    }
+
+    ASSERT_TRUE(log.ReclaimOldest());
+    ExpectRange(log, 15, 39);
+
+    EventLog reloaded{memory};
+    ASSERT_TRUE(reloaded.Init());
+    ExpectRange(reloaded, 15, 39);
+
+    ASSERT_TRUE(reloaded.ReclaimOldest());
+    ASSERT_TRUE(reloaded.ReclaimOldest());
+    ASSERT_TRUE(reloaded.empty());
+    ASSERT_FALSE(reloaded.ReclaimOldest());
+    ASSERT_TRUE(reloaded.Append(Event{40, 120}));
+    ExpectRange(reloaded, 40, 40);
+}
+
+TEST(PersistLogTest, TornFrame)
+{
+    LogMemory memory;
+    memory.Init();
+
+    {
+        EventLog log{memory};
+        ASSERT_TRUE(log.Init());
+
+        for (uint32_t i = 0; i < 5; i++)
+        {
+            ASSERT_TRUE(log.Append(Event{i, i * 3}));
+        }
+    }
+
+    // Corrupt the payload of the last frame
+    uint32_t last = EventLog::kDataOffset + 4 * 16;
+    memory.mem_[last + 8] ^= 0x5A;
+
+    EventLog log{memory};
+    ASSERT_TRUE(log.Init());
+    ExpectRange(log, 0, 3);
+
+    // The torn frame is not blank, so appends resume in the next unit
+    ASSERT_TRUE(log.Append(Event{4, 12}));
+    ExpectRange(log, 0, 4);
+    ASSERT_EQ(log.entry(4).location / 256, 1u);
+
+    EventLog reloaded{memory};
+    ASSERT_TRUE(reloaded.Init());
+    ExpectRange(reloaded, 0, 4);
+}
+
+TEST(PersistLogTest, VariableSize)
+{
+    using Log = demo::BasicPersistLog<LogMemory>;
+
+    LogMemory memory;
+    memory.Init();
+
+    std::vector<std::vector<uint8_t>> records;
+    std::vector<demo::ConstSegment> segments;
+
+    for (uint32_t i = 1; i <= 60; i++)
+    {
+        records.emplace_back(i, uint8_t(i));
+    }
+
+    for (auto& record : records)
+    {
+        segments.push_back(demo::ConstSegment{record.data(),
+            uint32_t(record.size())});
+    }
+
+    {
+        Log log{memory};
+        ASSERT_TRUE(log.Init());
+        ASSERT_FALSE(log.Append(records[0].data(), 0));
+        ASSERT_FALSE(log.Append(records[0].data(), Log::kMaxEntrySize + 1));
+        ASSERT_TRUE(log.AppendBatch(segments.data(), segments.size()));
+    }
+
+    Log log{memory};
+    ASSERT_TRUE(log.Init());
+    ASSERT_EQ(log.size(), records.size());
+
+    for (uint32_t i = 0; i < log.size(); i++)
+    {
+        std::vector<uint8_t> data(log.entry(i).size);
+        ASSERT_TRUE(log.Read(log.entry(i), data.data()));
+        ASSERT_EQ(data, records[i]);
+    }
+}
+
+}
@@ -0,0 +1,103 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <cstdint>
+
+#include <gtest/gtest.h>
+
+#include "persist/inc/crc16.h"
+#include "persist/persist.h"
+#include "unit_tests/test_memory.h"
+#include "util/probed_persist.h"
+
+namespace persist::test
+{
+
+using MemType = Memory<4096, 256, 4>;
+
+TEST(ProbedPersistTest, PassThrough)
+{
+    MemType memory;
+    memory.Init();
+    demo::ProbedPersist<Persist<MemType, uint32_t, 0>, uint32_t> persist{
+        memory};
+
+    ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+    uint32_t data = 0;
+    ASSERT_EQ(persist.Load(data), RESULT_FAIL_NO_DATA);
+
+    for (uint32_t i = 0; i < 10; i++)
+    {
+        ASSERT_EQ(persist.Save(i), RESULT_SUCCESS);
+    }
+
+    ASSERT_EQ(persist.saves(), 10u);
+    ASSERT_EQ(persist.Load(data), RESULT_SUCCESS);
+    ASSERT_EQ(data, 9u);
+}
+
+TEST(ProbedPersistTest, ProbedMemory)
+{
+    MemType memory;
+    memory.Init();
+    demo::ProbedMemory<MemType> probed{memory};
+    Persist<demo::ProbedMemory<MemType>, uint32_t, 0> persist{probed};
+
+    ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+    ASSERT_EQ(persist.Save(5), RESULT_SUCCESS);
+
+    Persist<MemType, uint32_t, 0> direct{memory};
+    ASSERT_EQ(direct.Init(), RESULT_SUCCESS);
+    uint32_t data = 0;
+    ASSERT_EQ(direct.Load(data), RESULT_SUCCESS);
+    ASSERT_EQ(data, 5u);
+}
+
+TEST(ProbedPersistTest, Crc16)
+{
+    uint8_t bytes[100];
+
+    for (uint32_t i = 0; i < sizeof(bytes); i++)
+    {
+        bytes[i] = i * 13;
+    }
+
+    Crc16 crc;
+    demo::ProbedCrc16 probed;
+    crc.Init();
+    probed.Init();
+    crc.Seed(0xFFFF);
+    probed.Seed(0xFFFF);
+    ASSERT_EQ(probed.Process(bytes, sizeof(bytes)),
+        crc.Process(bytes, sizeof(bytes)));
+}
+
+TEST(ProbedPersistTest, DisabledProbesSkipArguments)
+{
+#if !defined(PERSIST_DEMO_USDT)
+    uint32_t evaluated = 0;
+    DEMO_PROBE1(test, evaluated++);
+    ASSERT_EQ(evaluated, 0u);
+#endif
+}
+
+}
@@ -0,0 +1,256 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "persist/persist.h"
+#include "unit_tests/test_memory.h"
+#include "util/history.h"
+#include "util/scrubber.h"
+
+namespace persist::test
+{
+
+using MemType = Memory<4096, 256, 4>;
+
+// Memory whose reads of one range can be made to fail, and whose long
+// reads, such as the scrubber's, can be held up until released
+struct UnreadableMemory : MemType
+{
+    uint32_t bad_location = MemType::kSize;
+    std::atomic<bool> hold{false};
+    std::atomic<bool> holding{false};
+
+    bool Read(void* dst, uint32_t location, uint32_t length)
+    {
+        if (location <= bad_location && bad_location < location + length)
+        {
+            return false;
+        }
+
+        if (length >= 64)
+        {
+            while (hold)
+            {
+                holding = true;
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+
+            holding = false;
+        }
+
+        return MemType::Read(dst, location, length);
+    }
+};
+
+// Version 0 held plain uint32_t values
+using ScrubbedType = demo::ScrubbedPersist<UnreadableMemory, uint32_t, 1>;
+
+// Same layout as the scrubber's stored record
+struct StoredRecord
+{
+    uint32_t data;
+    uint32_t rewrites;
+};
+
+class ScrubberTest : public ::testing::Test
+{
+protected:
+    void SetUp(void) override
+    {
+        mem_.Init();
+    }
+
+    void ScrubPass(ScrubbedType& persist)
+    {
+        while (!persist.Scrub(300))
+        {
+        }
+    }
+
+    uint32_t Stored(void)
+    {
+        Persist<MemType, StoredRecord, 1> persist{mem_};
+        StoredRecord record{};
+        EXPECT_EQ(persist.Init(), RESULT_SUCCESS);
+        EXPECT_EQ(persist.Load(record), RESULT_SUCCESS);
+        return record.data;
+    }
+
+    UnreadableMemory mem_;
+};
+
+TEST_F(ScrubberTest, CleanPass)
+{
+    ScrubbedType persist{mem_};
+    ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+    ScrubPass(persist);
+
+    for (uint32_t i = 0; i < 50; i++)
+    {
+        ASSERT_EQ(persist.Save(i), RESULT_SUCCESS);
+
+        // Interleave saves with partial scrubbing
+        persist.Scrub(100);
+    }
+
+    ScrubPass(persist);
+    ScrubPass(persist);
+
+    auto stats = persist.stats();
+    ASSERT_GE(stats.passes, 3u);
+    ASSERT_EQ(stats.degraded, 0u);
+    ASSERT_EQ(stats.rewrites, 0u);
+    ASSERT_EQ(stats.bytes_scrubbed, stats.passes * MemType::kSize);
+}
+
+TEST_F(ScrubberTest, RewritesCorruptedGeneration)
+{
+    ScrubbedType persist{mem_};
+    ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+
+    for (uint32_t i = 0; i < 10; i++)
+    {
+        ASSERT_EQ(persist.Save(i), RESULT_SUCCESS);
+    }
+
+    // Flip a bit in the newest block
+    demo::PersistHistory<MemType, StoredRecord, 1> history{mem_};
+    ASSERT_EQ(history.Init(), RESULT_SUCCESS);
+    ASSERT_GT(history.size(), 0u);
+    mem_.mem_[history[0].location + history[0].size / 2] ^= 0x04;
+    ASSERT_NE(Stored(), 9u);
+
+    ScrubPass(persist);
+
+    auto stats = persist.stats();
+    ASSERT_EQ(stats.degraded, 1u);
+    ASSERT_EQ(stats.rewrites, 1u);
+    ASSERT_EQ(Stored(), 9u);
+
+    uint32_t data = 0;
+    ASSERT_EQ(persist.Load(data), RESULT_SUCCESS);
+    ASSERT_EQ(data, 9u);
+
+    // The rewritten generation verifies cleanly
+    ScrubPass(persist);
+    ASSERT_EQ(persist.stats().degraded, 1u);
+}
+
+TEST_F(ScrubberTest, ReadError)
+{
+    ScrubbedType persist{mem_};
+    ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+    ASSERT_EQ(persist.Save(5), RESULT_SUCCESS);
+
+    mem_.bad_location = 1000;
+    ScrubPass(persist);
+    mem_.bad_location = MemType::kSize;
+
+    auto stats = persist.stats();
+    ASSERT_EQ(stats.read_errors, 1u);
+    ASSERT_EQ(stats.degraded, 1u);
+    ASSERT_EQ(stats.rewrites, 1u);
+    ASSERT_EQ(Stored(), 5u);
+}
+
+TEST_F(ScrubberTest, Thread)
+{
+    ScrubbedType persist{mem_};
+    ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+    persist.StartScrubThread(512, std::chrono::milliseconds(1));
+
+    for (uint32_t i = 0; i < 200; i++)
+    {
+        ASSERT_EQ(persist.Save(i), RESULT_SUCCESS);
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+
+    while (persist.stats().passes < 2)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    persist.StopScrubThread();
+    ASSERT_EQ(persist.stats().degraded, 0u);
+    ASSERT_EQ(Stored(), 199u);
+}
+
+TEST_F(ScrubberTest, LoadLegacy)
+{
+    {
+        Persist<MemType, uint32_t, 0> persist{mem_};
+        ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+        ASSERT_EQ(persist.Save(42), RESULT_SUCCESS);
+    }
+
+    ScrubbedType persist{mem_};
+    ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+    uint32_t data = 0;
+    ASSERT_EQ(persist.Load(data), RESULT_FAIL_NO_DATA);
+    using LegacyPersist = ScrubbedType::Legacy<uint32_t, 0>;
+    ASSERT_EQ(persist.LoadLegacy<LegacyPersist>(data), RESULT_SUCCESS);
+    ASSERT_EQ(data, 42u);
+
+    // A scrub pass rewrites it in the current format
+    ScrubPass(persist);
+    ASSERT_EQ(persist.stats().rewrites, 1u);
+    ASSERT_EQ(Stored(), 42u);
+}
+
+TEST_F(ScrubberTest, ScrubReadDoesNotBlockForeground)
+{
+    ScrubbedType persist{mem_};
+    ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+    ASSERT_EQ(persist.Save(1), RESULT_SUCCESS);
+
+    mem_.hold = true;
+    std::thread scrubber{[&]() { ScrubPass(persist); }};
+
+    while (!mem_.holding)
+    {
+        std::this_thread::yield();
+    }
+
+    // The scrubber is stuck reading the medium
+    ASSERT_EQ(persist.Save(2), RESULT_SUCCESS);
+    uint32_t data = 0;
+    ASSERT_EQ(persist.Load(data), RESULT_SUCCESS);
+    ASSERT_EQ(data, 2u);
+    ASSERT_TRUE(mem_.holding);
+
+    mem_.hold = false;
+    scrubber.join();
+
+    // The chunk read across the Save was read again
+    auto stats = persist.stats();
+    ASSERT_GE(stats.collisions, 1u);
+    ASSERT_EQ(stats.degraded, 0u);
+    ASSERT_EQ(stats.bytes_scrubbed, MemType::kSize);
+}
+
+}
@@ -0,0 +1,268 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "persist/persist.h"
+#include "unit_tests/test_memory.h"
+#include "util/locked_persist.h"
+#include "util/ram_memory.h"
+#include "util/serializer.h"
+
+namespace persist::test
+{
+
+struct Profile
+{
+    std::string name;
+    std::vector<uint16_t> values;
+    std::vector<std::string> tags;
+    uint8_t flags;
+};
+
+}
+
+template <>
+struct demo::Serializer<persist::test::Profile>
+{
+    using Profile = persist::test::Profile;
+
+    static uint32_t Size(const Profile& value)
+    {
+        return Serializer<std::string>::Size(value.name) +
+            Serializer<std::vector<uint16_t>>::Size(value.values) +
+            Serializer<std::vector<std::string>>::Size(value.tags) +
+            Serializer<uint8_t>::Size(value.flags);
+    }
+
+    static void Write(SerialWriter& out, const Profile& value)
+    {
+        out(value.name);
+        out(value.values);
+        out(value.tags);
+        out(value.flags);
+    }
+
+    static void Read(SerialReader& in, Profile& value)
+    {
+        in(value.name);
+        in(value.values);
+        in(value.tags);
+        in(value.flags);
+    }
+};
+
+namespace persist::test
+{
+
+class SerializerTest : public ::testing::Test
+{
+public:
+    using MemType = demo::RamMemory<4096>;
+    using PersistType = demo::SerializedPersist<MemType, Profile, 0, 200>;
+
+    MemType mem_;
+
+    void SetUp() override
+    {
+        mem_.Init();
+    }
+};
+
+TEST_F(SerializerTest, RoundTrip)
+{
+    Profile profile{"sensor", {1, 2, 3, 65535}, {"a", "", "tag"}, 0x5A};
+
+    PersistType persist{mem_};
+    ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+    ASSERT_EQ(persist.Save(profile), RESULT_SUCCESS);
+
+    PersistType read_persist{mem_};
+    ASSERT_EQ(read_persist.Init(), RESULT_SUCCESS);
+    Profile loaded;
+    ASSERT_EQ(read_persist.Load(loaded), RESULT_SUCCESS);
+    ASSERT_EQ(loaded.name, profile.name);
+    ASSERT_EQ(loaded.values, profile.values);
+    ASSERT_EQ(loaded.tags, profile.tags);
+    ASSERT_EQ(loaded.flags, profile.flags);
+}
+
+TEST_F(SerializerTest, ShrinkingValue)
+{
+    PersistType persist{mem_};
+    ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+
+    Profile profile{std::string(100, 'x'), {}, {}, 0};
+    ASSERT_EQ(persist.Save(profile), RESULT_SUCCESS);
+    profile.name = "y";
+    ASSERT_EQ(persist.Save(profile), RESULT_SUCCESS);
+
+    PersistType read_persist{mem_};
+    ASSERT_EQ(read_persist.Init(), RESULT_SUCCESS);
+    Profile loaded;
+    ASSERT_EQ(read_persist.Load(loaded), RESULT_SUCCESS);
+    ASSERT_EQ(loaded.name, "y");
+}
+
+TEST_F(SerializerTest, EmptyLoadLeavesData)
+{
+    PersistType persist{mem_};
+    ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+
+    Profile loaded{"default", {7}, {}, 1};
+    ASSERT_EQ(persist.Load(loaded), RESULT_FAIL_NO_DATA);
+    ASSERT_EQ(loaded.name, "default");
+    ASSERT_EQ(loaded.values.size(), 1u);
+}
+
+TEST_F(SerializerTest, TooLarge)
+{
+    PersistType persist{mem_};
+    ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+
+    Profile profile{std::string(300, 'x'), {}, {}, 0};
+    ASSERT_FALSE(PersistType::Fits(profile));
+    ASSERT_EQ(persist.Save(profile), RESULT_FAIL_MEMORY);
+
+    Profile loaded;
+    ASSERT_EQ(persist.Load(loaded), RESULT_FAIL_NO_DATA);
+}
+
+TEST_F(SerializerTest, Wrapped)
+{
+    // Results match Persist's, so the wrappers accept it
+    demo::LockedPersist<PersistType, Profile> persist{mem_};
+    ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+    ASSERT_EQ(persist.Save(Profile{"locked", {4}, {}, 0}), RESULT_SUCCESS);
+
+    Profile loaded;
+    ASSERT_EQ(persist.LoadStored(loaded), RESULT_SUCCESS);
+    ASSERT_EQ(loaded.name, "locked");
+}
+
+TEST(SerializedPersistTest, WritesEncodedLength)
+{
+    using MemType = Memory<4096, 256, 4>;
+    using PersistType = demo::SerializedPersist<MemType, Profile, 0, 900>;
+
+    MemType mem;
+    mem.Init();
+    PersistType persist{mem};
+    ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+
+    // Header, 4-byte name, two empty vectors, flags and CRC, rounded up
+    Profile profile{"a", {}, {}, 1};
+    ASSERT_EQ(persist.Save(profile), RESULT_SUCCESS);
+    ASSERT_EQ(mem.write_count_, 28u);
+
+    // An unchanged value writes nothing
+    ASSERT_EQ(persist.Save(profile), RESULT_SUCCESS);
+    ASSERT_EQ(mem.write_count_, 28u);
+}
+
+TEST(SerializedPersistTest, StreamsAndWraps)
+{
+    using MemType = Memory<4096, 256, 4>;
+    using PersistType = demo::SerializedPersist<MemType, Profile, 0, 900>;
+
+    MemType mem;
+    mem.Init();
+
+    // Encodings longer than the streaming chunk, saved often enough that
+    // the ring wraps several times
+    for (uint32_t i = 0; i < 40; i++)
+    {
+        PersistType persist{mem};
+        ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+
+        Profile profile{std::string(100 + i * 15, char('a' + i % 26)),
+            std::vector<uint16_t>(i, uint16_t(i)), {"t"}, uint8_t(i)};
+        ASSERT_EQ(persist.Save(profile), RESULT_SUCCESS);
+
+        PersistType read_persist{mem};
+        ASSERT_EQ(read_persist.Init(), RESULT_SUCCESS);
+        Profile loaded;
+        ASSERT_EQ(read_persist.Load(loaded), RESULT_SUCCESS);
+        ASSERT_EQ(loaded.name, profile.name);
+        ASSERT_EQ(loaded.values, profile.values);
+        ASSERT_EQ(loaded.flags, profile.flags);
+    }
+
+    ASSERT_GT(mem.erase_count_, MemType::kSize);
+}
+
+TEST(SerializedPersistTest, TornRecord)
+{
+    using MemType = Memory<4096, 256, 4>;
+    using PersistType = demo::SerializedPersist<MemType, Profile, 0, 900>;
+
+    MemType mem;
+    mem.Init();
+    PersistType persist{mem};
+    ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+    ASSERT_EQ(persist.Save(Profile{"old", {}, {}, 0}), RESULT_SUCCESS);
+    uint32_t first = mem.write_count_;
+    ASSERT_EQ(persist.Save(Profile{"new", {}, {}, 0}), RESULT_SUCCESS);
+
+    // Lose the second record's trailing CRC
+    std::memset(&mem.mem_[first + 28], 0xFF, 2);
+
+    PersistType read_persist{mem};
+    ASSERT_EQ(read_persist.Init(), RESULT_SUCCESS);
+    Profile loaded;
+    ASSERT_EQ(read_persist.Load(loaded), RESULT_SUCCESS);
+    ASSERT_EQ(loaded.name, "old");
+
+    // The torn record's space is not reused without an erase
+    ASSERT_EQ(read_persist.Save(Profile{"next", {}, {}, 0}),
+        RESULT_SUCCESS);
+    PersistType again{mem};
+    ASSERT_EQ(again.Init(), RESULT_SUCCESS);
+    ASSERT_EQ(again.Load(loaded), RESULT_SUCCESS);
+    ASSERT_EQ(loaded.name, "next");
+}
+
+TEST(SerialReaderTest, Truncated)
+{
+    uint8_t buffer[64];
+    demo::SerialWriter out{{buffer, sizeof(buffer)}};
+    out(std::string("hello"));
+    ASSERT_TRUE(out.ok());
+
+    // Claimed length exceeds the available bytes
+    std::string value;
+    demo::SerialReader in{{buffer, out.position() - 1}};
+    in(value);
+    ASSERT_FALSE(in.ok());
+
+    // Writing past the end of the buffer fails rather than overflowing
+    demo::SerialWriter small{{buffer, 4}};
+    small(std::string("hello"));
+    ASSERT_FALSE(small.ok());
+}
+
+}
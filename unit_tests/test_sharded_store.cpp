@@ -0,0 +1,308 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "persist/persist.h"
+#include "util/file_memory.h"
+#include "util/sharded_store.h"
+
+namespace persist::test
+{
+
+class ShardedStoreTest : public ::testing::Test
+{
+public:
+    using MemType = demo::BasicFileMemory<4096, 64, 16>;
+    using StoreType = demo::ShardedPersistStore<MemType, uint32_t, 0, 8, 16>;
+
+    static constexpr uint32_t kNumShards = 4;
+
+    std::filesystem::path dir_;
+
+    void SetUp() override
+    {
+        dir_ = std::filesystem::temp_directory_path() / "test_sharded_store";
+        std::filesystem::remove_all(dir_);
+        std::filesystem::create_directories(dir_);
+    }
+
+    void TearDown() override
+    {
+        std::filesystem::remove_all(dir_);
+    }
+
+    std::unique_ptr<StoreType> Open(void)
+    {
+        auto store = std::make_unique<StoreType>(kNumShards,
+            [this](uint32_t shard)
+            {
+                auto path = dir_ / ("shard" + std::to_string(shard) + ".bin");
+                return std::make_unique<MemType>(path);
+            });
+
+        EXPECT_EQ(store->Init(), RESULT_SUCCESS);
+        return store;
+    }
+};
+
+TEST_F(ShardedStoreTest, SaveLoad)
+{
+    auto store = Open();
+    ASSERT_EQ(store->capacity(), kNumShards * 8);
+
+    uint32_t data = 0;
+    ASSERT_EQ(store->Load(0, data), RESULT_FAIL_NO_DATA);
+    ASSERT_EQ(store->Load(store->capacity(), data), RESULT_FAIL_NO_DATA);
+    ASSERT_FALSE(store->Save(store->capacity(), 1));
+
+    for (uint32_t id = 0; id < store->capacity(); id++)
+    {
+        ASSERT_TRUE(store->Save(id, id * 3));
+
+        // Queued values are visible immediately
+        ASSERT_EQ(store->Load(id, data), RESULT_SUCCESS);
+        ASSERT_EQ(data, id * 3);
+    }
+
+    ASSERT_TRUE(store->Flush());
+    store.reset();
+
+    store = Open();
+
+    for (uint32_t id = 0; id < store->capacity(); id++)
+    {
+        ASSERT_EQ(store->Load(id, data), RESULT_SUCCESS);
+        ASSERT_EQ(data, id * 3);
+    }
+}
+
+TEST_F(ShardedStoreTest, ConcurrentProducers)
+{
+    constexpr uint32_t kNumThreads = 4;
+    constexpr uint32_t kNumSaves = 2000;
+
+    auto store = Open();
+    std::vector<std::thread> threads;
+
+    for (uint32_t t = 0; t < kNumThreads; t++)
+    {
+        threads.emplace_back([&, t]()
+        {
+            // Each thread owns the ids congruent to t
+            for (uint32_t i = 0; i < kNumSaves; i++)
+            {
+                uint32_t id = (i * kNumThreads + t) % store->capacity();
+                store->Save(id, i);
+            }
+        });
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    ASSERT_TRUE(store->Flush());
+
+    auto stats = store->stats();
+    ASSERT_EQ(stats.submitted, kNumThreads * kNumSaves);
+    ASSERT_EQ(stats.written + stats.coalesced, stats.submitted);
+    ASSERT_EQ(stats.failed, 0u);
+
+    // Destroying the store drains its queues
+    store.reset();
+    store = Open();
+
+    for (uint32_t id = 0; id < store->capacity(); id++)
+    {
+        uint32_t expected = 0;
+
+        for (uint32_t i = 0; i < kNumSaves; i++)
+        {
+            if ((i * kNumThreads + id % kNumThreads) % store->capacity() == id)
+            {
+                expected = i;
+            }
+        }
+
+        uint32_t data = 0;
+        ASSERT_EQ(store->Load(id, data), RESULT_SUCCESS);
+        ASSERT_EQ(data, expected);
+    }
+}
+
+TEST_F(ShardedStoreTest, RejectsBeforeInit)
+{
+    StoreType store(kNumShards, [this](uint32_t shard)
+    {
+        auto path = dir_ / ("shard" + std::to_string(shard) + ".bin");
+        return std::make_unique<MemType>(path);
+    });
+
+    ASSERT_FALSE(store.Save(0, 1));
+    ASSERT_FALSE(store.Flush());
+
+    ASSERT_EQ(store.Init(), RESULT_SUCCESS);
+    ASSERT_TRUE(store.Save(0, 1));
+    ASSERT_TRUE(store.Flush());
+}
+
+// File memory whose writes can be made to fail
+class WriteFailMemory : public ShardedStoreTest::MemType
+{
+public:
+    using MemType = ShardedStoreTest::MemType;
+
+    WriteFailMemory(const std::string& path, std::atomic<bool>& fail) :
+        MemType(path),
+        fail_(fail)
+    {
+    }
+
+    bool Write(uint32_t location, const void* src, uint32_t size)
+    {
+        return !fail_ && MemType::Write(location, src, size);
+    }
+
+    bool WriteV(uint32_t location, const demo::ConstSegment* src,
+        uint32_t count)
+    {
+        return !fail_ && MemType::WriteV(location, src, count);
+    }
+
+private:
+    std::atomic<bool>& fail_;
+};
+
+TEST_F(ShardedStoreTest, FlushReportsFailure)
+{
+    std::atomic<bool> fail{false};
+    demo::ShardedPersistStore<WriteFailMemory, uint32_t, 0, 8, 16> store(
+        kNumShards, [&](uint32_t shard)
+        {
+            auto path = dir_ / ("shard" + std::to_string(shard) + ".bin");
+            return std::make_unique<WriteFailMemory>(path, fail);
+        });
+
+    ASSERT_EQ(store.Init(), RESULT_SUCCESS);
+    ASSERT_TRUE(store.Save(3, 1));
+    ASSERT_TRUE(store.Flush());
+
+    // Queued successfully, lost on the medium
+    fail = true;
+    ASSERT_TRUE(store.Save(3, 2));
+    ASSERT_FALSE(store.Flush());
+    ASSERT_EQ(store.stats().failed, 1u);
+
+    // Each failure is reported once
+    fail = false;
+    ASSERT_TRUE(store.Flush());
+    ASSERT_TRUE(store.Save(3, 4));
+    ASSERT_TRUE(store.Flush());
+}
+
+// File memory that counts syncs and can be made to fail them
+class SyncFailMemory : public ShardedStoreTest::MemType
+{
+public:
+    using MemType = ShardedStoreTest::MemType;
+
+    SyncFailMemory(const std::string& path, std::atomic<bool>& fail,
+        std::atomic<uint32_t>& syncs) :
+        MemType(path),
+        fail_(fail),
+        syncs_(syncs)
+    {
+    }
+
+    bool Sync(void)
+    {
+        syncs_++;
+        return !fail_ && MemType::Sync();
+    }
+
+private:
+    std::atomic<bool>& fail_;
+    std::atomic<uint32_t>& syncs_;
+};
+
+TEST_F(ShardedStoreTest, SyncsEachBatch)
+{
+    std::atomic<bool> fail{false};
+    std::atomic<uint32_t> syncs{0};
+    demo::ShardedPersistStore<SyncFailMemory, uint32_t, 0, 8, 16> store(
+        kNumShards, [&](uint32_t shard)
+        {
+            auto path = dir_ / ("shard" + std::to_string(shard) + ".bin");
+            return std::make_unique<SyncFailMemory>(path, fail, syncs);
+        });
+
+    ASSERT_EQ(store.Init(), RESULT_SUCCESS);
+
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        ASSERT_TRUE(store.Save(i % store.capacity(), i));
+    }
+
+    // Flush returns only once the batches holding the saves are synced
+    ASSERT_TRUE(store.Flush());
+    auto stats = store.stats();
+    ASSERT_EQ(syncs, stats.batches);
+    ASSERT_GE(stats.batches, 1u);
+
+    fail = true;
+    ASSERT_TRUE(store.Save(3, 1000));
+    ASSERT_FALSE(store.Flush());
+    ASSERT_EQ(store.stats().failed_syncs, 1u);
+    ASSERT_EQ(store.stats().failed, 0u);
+
+    fail = false;
+    ASSERT_TRUE(store.Flush());
+}
+
+TEST_F(ShardedStoreTest, DrainOnDestruction)
+{
+    {
+        auto store = Open();
+
+        for (uint32_t i = 0; i < 100; i++)
+        {
+            store->Save(5, i);
+        }
+    }
+
+    auto store = Open();
+    uint32_t data = 0;
+    ASSERT_EQ(store->Load(5, data), RESULT_SUCCESS);
+    ASSERT_EQ(data, 99u);
+}
+
+}
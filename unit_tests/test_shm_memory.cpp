@@ -0,0 +1,225 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "persist/persist.h"
+#include "util/shm_memory.h"
+
+namespace persist::test
+{
+
+using MemType = demo::ShmMemory<4096, 256, 4>;
+using PersistType = Persist<MemType, uint32_t, 0>;
+using WriterType = demo::ShmPersist<MemType, uint32_t, 0>;
+
+TEST(ShmMemoryTest, SharedMappings)
+{
+    int fd = MemType::CreateMemfd("test_shm_memory");
+    ASSERT_GE(fd, 0);
+
+    MemType writer_memory{fd};
+    MemType reader_memory{fd};
+    close(fd);
+    ASSERT_TRUE(writer_memory.valid());
+    ASSERT_TRUE(reader_memory.valid());
+    ASSERT_TRUE(reader_memory.Writable(0, MemType::kSize));
+
+    PersistType writer{writer_memory};
+    ASSERT_EQ(writer.Init(), RESULT_SUCCESS);
+    ASSERT_EQ(writer.Save(1), RESULT_SUCCESS);
+
+    PersistType reader{reader_memory};
+    ASSERT_EQ(reader.Init(), RESULT_SUCCESS);
+    uint32_t data = 0;
+    ASSERT_EQ(reader.Load(data), RESULT_SUCCESS);
+    ASSERT_EQ(data, 1u);
+}
+
+TEST(ShmMemoryTest, WritesOnlyErased)
+{
+    int fd = MemType::CreateMemfd("test_shm_memory");
+    ASSERT_GE(fd, 0);
+
+    MemType memory{fd};
+    close(fd);
+    ASSERT_TRUE(memory.valid());
+
+    uint32_t value = 0x12345678;
+    ASSERT_TRUE(memory.Write(0, &value, sizeof(value)));
+
+    // Programmed, misaligned or out of range
+    ASSERT_FALSE(memory.Write(0, &value, sizeof(value)));
+    ASSERT_FALSE(memory.Write(2, &value, sizeof(value)));
+    ASSERT_FALSE(memory.Write(MemType::kSize, &value, sizeof(value)));
+
+    ASSERT_TRUE(memory.Erase(0, MemType::kEraseGranularity));
+    ASSERT_TRUE(memory.Write(0, &value, sizeof(value)));
+}
+
+TEST(ShmMemoryTest, WaitForChange)
+{
+    int fd = MemType::CreateMemfd("test_shm_memory");
+    ASSERT_GE(fd, 0);
+
+    MemType writer_memory{fd};
+    MemType reader_memory{fd};
+    close(fd);
+
+    uint32_t seen = reader_memory.sequence();
+    ASSERT_FALSE(reader_memory.WaitForChange(seen,
+        std::chrono::milliseconds(10)));
+
+    std::thread writer_thread([&]()
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        WriterType writer{writer_memory};
+        writer.Init();
+        writer.Save(42);
+    });
+
+    ASSERT_TRUE(reader_memory.WaitForChange(seen, std::chrono::seconds(10)));
+    writer_thread.join();
+
+    PersistType reader{reader_memory};
+    ASSERT_EQ(reader.Init(), RESULT_SUCCESS);
+    uint32_t data = 0;
+    ASSERT_EQ(reader.Load(data), RESULT_SUCCESS);
+    ASSERT_EQ(data, 42u);
+}
+
+TEST(ShmMemoryTest, AcrossProcesses)
+{
+    std::string name = "/test_shm_memory." + std::to_string(getpid());
+    MemType::Unlink(name);
+    MemType memory{name};
+    ASSERT_TRUE(memory.valid());
+    uint32_t seen = memory.sequence();
+
+    pid_t child = fork();
+    ASSERT_GE(child, 0);
+
+    if (child == 0)
+    {
+        MemType child_memory{name};
+        WriterType writer{child_memory};
+        bool ok = child_memory.valid() &&
+            writer.Init() == RESULT_SUCCESS &&
+            writer.Save(1234) == RESULT_SUCCESS;
+        _exit(ok ? 0 : 1);
+    }
+
+    ASSERT_TRUE(memory.WaitForChange(seen, std::chrono::seconds(10)));
+
+    int status = 0;
+    waitpid(child, &status, 0);
+    ASSERT_TRUE(WIFEXITED(status));
+    ASSERT_EQ(WEXITSTATUS(status), 0);
+
+    PersistType reader{memory};
+    ASSERT_EQ(reader.Init(), RESULT_SUCCESS);
+    uint32_t data = 0;
+    ASSERT_EQ(reader.Load(data), RESULT_SUCCESS);
+    ASSERT_EQ(data, 1234u);
+
+    MemType::Unlink(name);
+}
+
+TEST(ShmMemoryTest, OneChangePerSave)
+{
+    int fd = MemType::CreateMemfd("test_shm_memory");
+    ASSERT_GE(fd, 0);
+
+    MemType memory{fd};
+    close(fd);
+    uint32_t seen = memory.sequence();
+
+    WriterType writer{memory};
+    ASSERT_EQ(writer.Init(), RESULT_SUCCESS);
+
+    for (uint32_t i = 1; i <= 10; i++)
+    {
+        ASSERT_EQ(writer.Save(i), RESULT_SUCCESS);
+        ASSERT_EQ(memory.sequence(), seen + i);
+    }
+
+    // Plain writes stay unpublished until Publish
+    uint32_t value = 0;
+    ASSERT_TRUE(memory.Write(MemType::kSize - 4, &value, sizeof(value)));
+    ASSERT_EQ(memory.sequence(), seen + 10);
+    memory.Publish();
+    memory.Publish();
+    ASSERT_EQ(memory.sequence(), seen + 11);
+}
+
+TEST(ShmMemoryTest, CrashedFormatter)
+{
+    int fd = MemType::CreateMemfd("test_shm_memory");
+    ASSERT_GE(fd, 0);
+
+    // Leave the segment claimed by a process that has exited
+    pid_t child = fork();
+    ASSERT_GE(child, 0);
+
+    if (child == 0)
+    {
+        _exit(0);
+    }
+
+    waitpid(child, nullptr, 0);
+    uint32_t state = child;
+    ASSERT_EQ(pwrite(fd, &state, sizeof(state), 0), ssize_t(sizeof(state)));
+
+    MemType memory{fd};
+    close(fd);
+    ASSERT_TRUE(memory.valid());
+    ASSERT_TRUE(memory.Writable(0, MemType::kSize));
+}
+
+TEST(ShmMemoryTest, HugePages)
+{
+    int fd = MemType::CreateMemfd("test_shm_memory", true);
+
+    if (fd < 0)
+    {
+        GTEST_SKIP() << "No huge pages available";
+    }
+
+    MemType memory{fd, true};
+    close(fd);
+
+    if (!memory.valid())
+    {
+        GTEST_SKIP() << "No huge pages reserved";
+    }
+
+    ASSERT_TRUE(memory.Writable(0, MemType::kSize));
+}
+
+}
@@ -0,0 +1,233 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "persist/persist.h"
+#include "unit_tests/test_memory.h"
+#include "util/striped_memory.h"
+
+namespace persist::test
+{
+
+using MemberType = Memory<16384, 256, 4>;
+
+using StripedType = demo::StripedMemory<MemberType, MemberType, MemberType>;
+
+TEST(StripedMemoryTest, Interleaving)
+{
+    MemberType a, b, c;
+    a.Init();
+    b.Init();
+    c.Init();
+    StripedType striped{a, b, c};
+    ASSERT_EQ(StripedType::kSize, 3u * 16384);
+
+    std::vector<uint8_t> pattern(StripedType::kSize);
+
+    for (uint32_t i = 0; i < pattern.size(); i++)
+    {
+        pattern[i] = uint8_t(i * 7 + i / 256);
+    }
+
+    ASSERT_TRUE(striped.Write(0, pattern.data(), pattern.size()));
+
+    MemberType* members[] = {&a, &b, &c};
+
+    for (uint32_t i = 0; i < pattern.size(); i += 97)
+    {
+        auto [index, location] = StripedType::Locate(i);
+        ASSERT_EQ(index, (i / 256) % 3);
+        ASSERT_EQ(members[index]->mem_[location], pattern[i]);
+    }
+
+    // Unaligned reads crossing several stripes
+    std::vector<uint8_t> data(1000);
+    ASSERT_TRUE(striped.Read(data.data(), 200, data.size()));
+    ASSERT_TRUE(std::equal(data.begin(), data.end(), pattern.begin() + 200));
+
+    ASSERT_FALSE(striped.Read(data.data(), StripedType::kSize - 10, 20));
+    ASSERT_FALSE(striped.Writable(0, 256));
+}
+
+TEST(StripedMemoryTest, ManySegments)
+{
+    // 256 stripes per member, more than one ReadV or WriteV takes
+    using SmallStripe = Memory<16384, 64, 4>;
+    using Striped = demo::StripedMemory<SmallStripe, SmallStripe>;
+    static_assert(SmallStripe::kSize / 64 > Striped::kMaxSegments);
+
+    SmallStripe a, b;
+    a.Init();
+    b.Init();
+    Striped striped{a, b};
+
+    std::vector<uint8_t> pattern(Striped::kSize - 100);
+
+    for (uint32_t i = 0; i < pattern.size(); i++)
+    {
+        pattern[i] = uint8_t(i * 13 + i / 64);
+    }
+
+    // Unaligned, and large enough to run on both members at once
+    for (uint32_t pass = 0; pass < 3; pass++)
+    {
+        a.Init();
+        b.Init();
+        ASSERT_TRUE(striped.Write(36, pattern.data(), pattern.size()));
+
+        for (uint32_t i = 0; i < pattern.size(); i++)
+        {
+            auto [index, location] = Striped::Locate(36 + i);
+            ASSERT_EQ((index ? b : a).mem_[location], pattern[i]);
+        }
+
+        std::vector<uint8_t> data(pattern.size());
+        ASSERT_TRUE(striped.Read(data.data(), 36, data.size()));
+        ASSERT_EQ(data, pattern);
+    }
+}
+
+TEST(StripedMemoryTest, EraseAndWritable)
+{
+    MemberType a, b, c;
+    a.Init();
+    b.Init();
+    c.Init();
+    StripedType striped{a, b, c};
+
+    std::vector<uint8_t> zeros(1024, 0);
+    ASSERT_TRUE(striped.Writable(256, 1024));
+    ASSERT_TRUE(striped.Write(256, zeros.data(), zeros.size()));
+    ASSERT_FALSE(striped.Writable(0, 512));
+    ASSERT_TRUE(striped.Writable(1280, 512));
+
+    ASSERT_FALSE(striped.Erase(100, 256));
+    ASSERT_TRUE(striped.Erase(0, 1536));
+    ASSERT_TRUE(striped.Writable(0, StripedType::kSize));
+
+    // Each member erased its own share exactly once
+    ASSERT_EQ(a.erase_count_ + b.erase_count_ + c.erase_count_, 1536u);
+    ASSERT_EQ(a.erase_count_, 512u);
+}
+
+TEST(StripedMemoryTest, Persist)
+{
+    struct Payload
+    {
+        uint32_t values[3000];
+    };
+
+    MemberType a, b, c;
+    a.Init();
+    b.Init();
+    c.Init();
+    StripedType striped{a, b, c};
+
+    auto payload = std::make_unique<Payload>();
+
+    {
+        persist::Persist<StripedType, Payload, 0> persist{striped};
+        ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+
+        for (uint32_t i = 0; i < 8; i++)
+        {
+            std::fill_n(payload->values, 3000, i);
+            ASSERT_EQ(persist.Save(*payload), RESULT_SUCCESS);
+        }
+    }
+
+    persist::Persist<StripedType, Payload, 0> persist{striped};
+    ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+    auto loaded = std::make_unique<Payload>();
+    ASSERT_EQ(persist.Load(*loaded), RESULT_SUCCESS);
+    ASSERT_EQ(loaded->values[0], 7u);
+    ASSERT_EQ(loaded->values[2999], 7u);
+
+    // Every member carries part of the data
+    ASSERT_GT(a.write_count_, 0u);
+    ASSERT_GT(b.write_count_, 0u);
+    ASSERT_GT(c.write_count_, 0u);
+}
+
+// Member whose Read waits until every member has entered its own Read, or
+// gives up after a second
+struct RendezvousMemory : MemberType
+{
+    std::atomic<uint32_t>* arrived;
+    uint32_t expected;
+    bool concurrent = false;
+
+    bool Read(void* dst, uint32_t location, uint32_t length)
+    {
+        arrived->fetch_add(1);
+        auto deadline = std::chrono::steady_clock::now() +
+            std::chrono::seconds(1);
+
+        while (arrived->load() < expected &&
+            std::chrono::steady_clock::now() < deadline)
+        {
+            std::this_thread::yield();
+        }
+
+        concurrent = arrived->load() >= expected;
+        return MemberType::Read(dst, location, length);
+    }
+};
+
+TEST(StripedMemoryTest, ParallelMembers)
+{
+    using Striped = demo::StripedMemory<RendezvousMemory, RendezvousMemory>;
+
+    std::atomic<uint32_t> arrived{0};
+    auto a = std::make_unique<RendezvousMemory>();
+    auto b = std::make_unique<RendezvousMemory>();
+
+    for (auto* member : {a.get(), b.get()})
+    {
+        member->Init();
+        member->arrived = &arrived;
+        member->expected = 2;
+    }
+
+    Striped striped{*a, *b};
+    std::vector<uint8_t> data(Striped::kParallelThreshold);
+    ASSERT_TRUE(striped.Read(data.data(), 0, data.size()));
+    ASSERT_TRUE(a->concurrent);
+    ASSERT_TRUE(b->concurrent);
+
+    // Small reads stay on the calling thread
+    arrived = 0;
+    a->expected = 1;
+    ASSERT_TRUE(striped.Read(data.data(), 0, 16));
+    ASSERT_EQ(arrived.load(), 1u);
+}
+
+}
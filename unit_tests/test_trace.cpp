@@ -0,0 +1,161 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include "persist/persist.h"
+#include "unit_tests/test_memory.h"
+#include "util/trace.h"
+
+namespace persist::test
+{
+
+using MemType = Memory<4096, 256, 4>;
+using TracedMemory = demo::TracingMemory<MemType>;
+using PersistType = Persist<TracedMemory, uint32_t, 0>;
+using TracedPersist = demo::TracingPersist<PersistType, uint32_t>;
+
+TEST(TraceTest, RecordAndReplay)
+{
+    std::string path = "/tmp/test_trace." + std::to_string(getpid());
+    MemType memory;
+    memory.Init();
+
+    {
+        demo::TraceWriter writer;
+        ASSERT_TRUE(writer.Open<MemType>(path.c_str()));
+        TracedMemory traced_memory{memory, writer};
+        TracedPersist persist{writer, traced_memory};
+
+        ASSERT_EQ(persist.Init(), RESULT_SUCCESS);
+
+        for (uint32_t i = 0; i < 100; i++)
+        {
+            ASSERT_EQ(persist.Save(i), RESULT_SUCCESS);
+            uint32_t data;
+            ASSERT_EQ(persist.Load(data), RESULT_SUCCESS);
+            ASSERT_EQ(data, i);
+        }
+    }
+
+    demo::TraceHeader header;
+    std::vector<demo::TraceRecord> records;
+    std::vector<uint8_t> payload;
+    ASSERT_TRUE(demo::ReadTrace(path.c_str(), header, records, payload));
+    unlink(path.c_str());
+
+    ASSERT_EQ(header.size, MemType::kSize);
+    ASSERT_EQ(header.erase_granularity, MemType::kEraseGranularity);
+    ASSERT_EQ(header.write_granularity, MemType::kWriteGranularity);
+
+    uint32_t counts[demo::TRACE_NUM_OPS] = {};
+    uint64_t last_time = 0;
+
+    for (auto& record : records)
+    {
+        ASSERT_LT(record.op, demo::TRACE_NUM_OPS);
+
+        if (record.phase == demo::TRACE_CALL)
+        {
+            // Memory operations are recorded in order
+            ASSERT_GE(record.time, last_time);
+            last_time = record.time;
+        }
+
+        if (record.phase != demo::TRACE_BEGIN)
+        {
+            counts[record.op]++;
+        }
+    }
+
+    ASSERT_EQ(counts[demo::TRACE_INIT], 1u);
+    ASSERT_EQ(counts[demo::TRACE_SAVE], 100u);
+    ASSERT_EQ(counts[demo::TRACE_LOAD], 100u);
+    ASSERT_GT(counts[demo::TRACE_WRITE], 0u);
+
+    // Replaying against an identical fresh memory reproduces every result
+    MemType replay_memory;
+    replay_memory.Init();
+    demo::ReplayResult replay = demo::Replay(replay_memory, records,
+        payload);
+
+    ASSERT_EQ(replay.mismatches, 0u);
+    ASSERT_EQ(replay_memory.write_count_, memory.write_count_);
+    ASSERT_EQ(replay_memory.erase_count_, memory.erase_count_);
+    ASSERT_EQ(memcmp(replay_memory.mem_, memory.mem_, MemType::kSize), 0);
+
+    for (uint32_t op = 0; op < demo::TRACE_NUM_OPS; op++)
+    {
+        ASSERT_EQ(replay.latencies[op].size(), counts[op]);
+    }
+}
+
+// Charges a fixed modeled latency for every operation
+struct FixedLatencyMemory : MemType
+{
+    uint32_t modeled_latency(void) const
+    {
+        return 100;
+    }
+};
+
+TEST(TraceTest, InterleavedThreads)
+{
+    auto make = [](uint32_t thread, demo::TraceOp op, demo::TracePhase phase)
+    {
+        demo::TraceRecord record{};
+        record.thread = thread;
+        record.op = op;
+        record.phase = phase;
+        record.length = (op == demo::TRACE_READ) ? 4 : 0;
+        record.result = 1;
+        return record;
+    };
+
+    // Two threads save at once; only thread 0 touches the memory
+    std::vector<demo::TraceRecord> records = {
+        make(0, demo::TRACE_SAVE, demo::TRACE_BEGIN),
+        make(1, demo::TRACE_SAVE, demo::TRACE_BEGIN),
+        make(0, demo::TRACE_READ, demo::TRACE_CALL),
+        make(1, demo::TRACE_SAVE, demo::TRACE_END),
+        make(0, demo::TRACE_READ, demo::TRACE_CALL),
+        make(0, demo::TRACE_SAVE, demo::TRACE_END),
+    };
+
+    FixedLatencyMemory memory;
+    memory.Init();
+    demo::ReplayResult replay = demo::Replay(memory, records, {});
+
+    ASSERT_EQ(replay.mismatches, 0u);
+    ASSERT_EQ(replay.elapsed, 200u);
+    ASSERT_EQ(replay.latencies[demo::TRACE_SAVE],
+        (std::vector<uint32_t>{0, 200}));
+}
+
+}
@@ -0,0 +1,308 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <cstdint>
+
+#include <gtest/gtest.h>
+
+#include "persist/persist.h"
+#include "util/transaction.h"
+#include "unit_tests/test_memory.h"
+
+namespace persist::test
+{
+
+class TransactionTest : public ::testing::Test
+{
+public:
+    using MemType = Memory<1024, 64, 4>;
+
+    struct Config
+    {
+        uint32_t rate;
+        uint8_t mode;
+    };
+
+    struct Limits
+    {
+        uint16_t low;
+        uint16_t high;
+    };
+
+    using ConfigParticipant = demo::Participant<MemType, Config, 1>;
+    using LimitsParticipant = demo::Participant<MemType, Limits, 2>;
+    using LogType = demo::TransactionLog<MemType>;
+
+    MemType config_mem_;
+    MemType limits_mem_;
+    MemType log_mem_;
+
+    void SetUp() override
+    {
+        config_mem_.Init();
+        limits_mem_.Init();
+        log_mem_.Init();
+    }
+
+    // Mounts everything from scratch, as after a reboot
+    void Reboot(Config& config, Limits& limits, Result& config_result,
+        Result& limits_result)
+    {
+        ConfigParticipant config_participant{config_mem_};
+        LimitsParticipant limits_participant{limits_mem_};
+        LogType log{log_mem_};
+        ASSERT_EQ(log.Init(config_participant, limits_participant),
+            RESULT_SUCCESS);
+        config_result = config_participant.Load(config);
+        limits_result = limits_participant.Load(limits);
+    }
+};
+
+TEST_F(TransactionTest, Commit)
+{
+    ConfigParticipant config{config_mem_};
+    LimitsParticipant limits{limits_mem_};
+    LogType log{log_mem_};
+    ASSERT_EQ(log.Init(config, limits), RESULT_SUCCESS);
+
+    Config c{};
+    Limits l{};
+    ASSERT_EQ(config.Load(c), RESULT_FAIL_NO_DATA);
+
+    for (uint32_t i = 1; i <= 50; i++)
+    {
+        ASSERT_EQ(log.Commit(
+            demo::Stage(config, Config{i, uint8_t(i)}),
+            demo::Stage(limits, Limits{uint16_t(i), uint16_t(i * 2)})),
+            RESULT_SUCCESS);
+    }
+
+    Result config_result;
+    Result limits_result;
+    Reboot(c, l, config_result, limits_result);
+    ASSERT_EQ(config_result, RESULT_SUCCESS);
+    ASSERT_EQ(limits_result, RESULT_SUCCESS);
+    ASSERT_EQ(c.rate, 50u);
+    ASSERT_EQ(l.high, 100u);
+}
+
+TEST_F(TransactionTest, CrashBeforeCommitRecord)
+{
+    {
+        ConfigParticipant config{config_mem_};
+        LimitsParticipant limits{limits_mem_};
+        LogType log{log_mem_};
+        ASSERT_EQ(log.Init(config, limits), RESULT_SUCCESS);
+        ASSERT_EQ(log.Commit(
+            demo::Stage(config, Config{1, 1}),
+            demo::Stage(limits, Limits{10, 20})),
+            RESULT_SUCCESS);
+
+        // Both participants are written but the commit record is not
+        uint32_t next = log.committed() + 1;
+        ASSERT_EQ(config.Prepare(next, Config{2, 2}), RESULT_SUCCESS);
+        ASSERT_EQ(limits.Prepare(next, Limits{30, 40}), RESULT_SUCCESS);
+    }
+
+    Config c{};
+    Limits l{};
+    Result config_result;
+    Result limits_result;
+    Reboot(c, l, config_result, limits_result);
+    ASSERT_EQ(config_result, RESULT_SUCCESS);
+    ASSERT_EQ(limits_result, RESULT_SUCCESS);
+    ASSERT_EQ(c.rate, 1u);
+    ASSERT_EQ(l.low, 10u);
+    ASSERT_EQ(l.high, 20u);
+
+    // Recovery is stable across further reboots
+    Reboot(c, l, config_result, limits_result);
+    ASSERT_EQ(c.rate, 1u);
+    ASSERT_EQ(l.low, 10u);
+}
+
+TEST_F(TransactionTest, CrashDuringFirstTransaction)
+{
+    {
+        ConfigParticipant config{config_mem_};
+        LimitsParticipant limits{limits_mem_};
+        LogType log{log_mem_};
+        ASSERT_EQ(log.Init(config, limits), RESULT_SUCCESS);
+
+        // Only one participant was written before the crash
+        ASSERT_EQ(config.Prepare(1, Config{7, 7}), RESULT_SUCCESS);
+    }
+
+    Config c{};
+    Limits l{};
+    Result config_result;
+    Result limits_result;
+    Reboot(c, l, config_result, limits_result);
+    ASSERT_EQ(config_result, RESULT_FAIL_NO_DATA);
+    ASSERT_EQ(limits_result, RESULT_FAIL_NO_DATA);
+
+    // A later transaction skips the aborted number and commits normally
+    ConfigParticipant config{config_mem_};
+    LimitsParticipant limits{limits_mem_};
+    LogType log{log_mem_};
+    ASSERT_EQ(log.Init(config, limits), RESULT_SUCCESS);
+    ASSERT_EQ(log.Commit(
+        demo::Stage(config, Config{8, 8}),
+        demo::Stage(limits, Limits{1, 2})),
+        RESULT_SUCCESS);
+
+    ASSERT_EQ(log.committed(), 2u);
+
+    Reboot(c, l, config_result, limits_result);
+    ASSERT_EQ(config_result, RESULT_SUCCESS);
+    ASSERT_EQ(c.rate, 8u);
+    ASSERT_EQ(l.high, 2u);
+}
+
+// Memory whose writes fail while fail is set. Setting trip makes the next
+// write fail and then sets fail on another memory.
+struct TrippingMemory : Memory<1024, 64, 4>
+{
+    bool fail = false;
+    TrippingMemory* trip = nullptr;
+
+    bool Write(uint32_t location, const void* src, uint32_t length)
+    {
+        if (trip)
+        {
+            trip->fail = true;
+            trip = nullptr;
+            return false;
+        }
+
+        return !fail && Memory::Write(location, src, length);
+    }
+};
+
+TEST(TransactionAbortTest, FailedRollbackBlocksCommits)
+{
+    using Config = TransactionTest::Config;
+    using Limits = TransactionTest::Limits;
+    using ConfigParticipant = demo::Participant<TrippingMemory, Config, 1>;
+    using LimitsParticipant = demo::Participant<TrippingMemory, Limits, 2>;
+    using LogType = demo::TransactionLog<TrippingMemory>;
+
+    TrippingMemory config_mem;
+    TrippingMemory limits_mem;
+    TrippingMemory log_mem;
+    config_mem.Init();
+    limits_mem.Init();
+    log_mem.Init();
+
+    {
+        ConfigParticipant config{config_mem};
+        LimitsParticipant limits{limits_mem};
+        LogType log{log_mem};
+        ASSERT_EQ(log.Init(config, limits), RESULT_SUCCESS);
+        ASSERT_EQ(log.Commit(
+            demo::Stage(config, Config{1, 1}),
+            demo::Stage(limits, Limits{1, 1})),
+            RESULT_SUCCESS);
+
+        // An abort that rolls back cleanly does not reuse its number
+        limits_mem.fail = true;
+        ASSERT_NE(log.Commit(
+            demo::Stage(config, Config{2, 2}),
+            demo::Stage(limits, Limits{2, 2})),
+            RESULT_SUCCESS);
+        limits_mem.fail = false;
+
+        ASSERT_EQ(log.Commit(
+            demo::Stage(config, Config{3, 3}),
+            demo::Stage(limits, Limits{3, 3})),
+            RESULT_SUCCESS);
+        ASSERT_EQ(log.committed(), 3u);
+
+        // Config is prepared, limits fails, and config's rollback fails too
+        limits_mem.trip = &config_mem;
+        ASSERT_NE(log.Commit(
+            demo::Stage(config, Config{4, 4}),
+            demo::Stage(limits, Limits{4, 4})),
+            RESULT_SUCCESS);
+        config_mem.fail = false;
+
+        // Config still holds the aborted value, so nothing may commit
+        ASSERT_NE(log.Commit(demo::Stage(limits, Limits{5, 5})),
+            RESULT_SUCCESS);
+        ASSERT_EQ(log.committed(), 3u);
+    }
+
+    ConfigParticipant config{config_mem};
+    LimitsParticipant limits{limits_mem};
+    LogType log{log_mem};
+    ASSERT_EQ(log.Init(config, limits), RESULT_SUCCESS);
+
+    Config c{};
+    ASSERT_EQ(config.Load(c), RESULT_SUCCESS);
+    ASSERT_EQ(c.rate, 3u);
+
+    // The aborted number stays unused after recovery too
+    ASSERT_EQ(log.Commit(demo::Stage(limits, Limits{6, 6})), RESULT_SUCCESS);
+    ASSERT_EQ(log.committed(), 5u);
+
+    LogType rebooted{log_mem};
+    ASSERT_EQ(rebooted.Init(config, limits), RESULT_SUCCESS);
+    ASSERT_EQ(config.Load(c), RESULT_SUCCESS);
+    ASSERT_EQ(c.rate, 3u);
+    ASSERT_EQ(rebooted.Commit(demo::Stage(config, Config{7, 7})),
+        RESULT_SUCCESS);
+    ASSERT_EQ(rebooted.committed(), 6u);
+}
+
+TEST_F(TransactionTest, RecycledCommittedValue)
+{
+    {
+        ConfigParticipant config{config_mem_};
+        LimitsParticipant limits{limits_mem_};
+        LogType log{log_mem_};
+        ASSERT_EQ(log.Init(config, limits), RESULT_SUCCESS);
+        ASSERT_EQ(log.Commit(demo::Stage(config, Config{1, 1})),
+            RESULT_SUCCESS);
+
+        // Enough uncommitted writes to recycle every committed generation
+        for (uint32_t i = 0; i < 500; i++)
+        {
+            ASSERT_EQ(config.Prepare(2, Config{i, 2}), RESULT_SUCCESS);
+        }
+    }
+
+    ConfigParticipant config{config_mem_};
+    LimitsParticipant limits{limits_mem_};
+    LogType log{log_mem_};
+    ASSERT_NE(log.Init(config, limits), RESULT_SUCCESS);
+    ASSERT_NE(log.Commit(demo::Stage(limits, Limits{1, 1})), RESULT_SUCCESS);
+
+    // The uncommitted value is left in place rather than discarded
+    ConfigParticipant::Record record{};
+    Persist<MemType, ConfigParticipant::Record, 1> raw{config_mem_};
+    ASSERT_EQ(raw.Init(), RESULT_SUCCESS);
+    ASSERT_EQ(raw.Load(record), RESULT_SUCCESS);
+    ASSERT_EQ(record.transaction, 2u);
+    ASSERT_EQ(record.data.rate, 499u);
+}
+
+}
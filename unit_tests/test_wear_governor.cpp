@@ -0,0 +1,267 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "unit_tests/test_memory.h"
+#include "util/wear_governor.h"
+
+namespace persist::test
+{
+
+struct FakeClock
+{
+    using duration = std::chrono::seconds;
+    using rep = duration::rep;
+    using period = duration::period;
+    using time_point = std::chrono::time_point<FakeClock>;
+    static constexpr bool is_steady = true;
+
+    static inline time_point time_;
+
+    static time_point now(void)
+    {
+        return time_;
+    }
+};
+
+using MemType = Memory<1024, 256, 4>;
+using GovernorType = demo::WearGovernor<MemType, uint32_t, 0, FakeClock>;
+
+class WearGovernorTest : public ::testing::Test
+{
+protected:
+    void SetUp(void) override
+    {
+        FakeClock::time_ = {};
+        mem_.Init();
+        ledger_.Init();
+    }
+
+    MemType mem_;
+    MemType ledger_;
+};
+
+TEST_F(WearGovernorTest, UnthrottledWithinBudget)
+{
+    GovernorType governor{mem_, ledger_, {1000000, std::chrono::seconds(1), 0}};
+    ASSERT_EQ(governor.Init(), RESULT_SUCCESS);
+    FakeClock::time_ += std::chrono::seconds(1);
+
+    for (uint32_t i = 0; i < 1000; i++)
+    {
+        ASSERT_EQ(governor.Save(i), RESULT_SUCCESS);
+        ASSERT_FALSE(governor.pending());
+    }
+
+    ASSERT_EQ(governor.stats().written, 1000u);
+    ASSERT_EQ(governor.stats().throttle_events, 0u);
+}
+
+TEST_F(WearGovernorTest, ThrottlesTightLoop)
+{
+    std::vector<bool> events;
+    GovernorType governor{mem_, ledger_, {100, std::chrono::seconds(100), 2}};
+    governor.OnThrottle([&](bool throttled) { events.push_back(throttled); });
+    ASSERT_EQ(governor.Init(), RESULT_SUCCESS);
+
+    for (uint32_t i = 0; i < 10000; i++)
+    {
+        ASSERT_EQ(governor.Save(i), RESULT_SUCCESS);
+    }
+
+    ASSERT_TRUE(governor.throttled());
+    ASSERT_TRUE(governor.pending());
+    ASSERT_LE(governor.memory().max_erase_count(), 2u);
+    ASSERT_GT(governor.stats().coalesced, 0u);
+    ASSERT_EQ(governor.stats().throttle_events, 1u);
+    ASSERT_EQ(events, std::vector<bool>{true});
+
+    uint32_t data = 0;
+    ASSERT_EQ(governor.Load(data), RESULT_SUCCESS);
+    ASSERT_EQ(data, 9999u);
+
+    // Once the budget has grown, Poll writes the newest value
+    FakeClock::time_ += std::chrono::seconds(50);
+    ASSERT_EQ(governor.Poll(), RESULT_SUCCESS);
+    ASSERT_FALSE(governor.pending());
+    ASSERT_FALSE(governor.throttled());
+    ASSERT_EQ(events, (std::vector<bool>{true, false}));
+
+    GovernorType reader{mem_, ledger_, {100, std::chrono::seconds(100), 2}};
+    ASSERT_EQ(reader.Init(), RESULT_SUCCESS);
+    ASSERT_EQ(reader.Load(data), RESULT_SUCCESS);
+    ASSERT_EQ(data, 9999u);
+}
+
+TEST_F(WearGovernorTest, ChargesOnlyErases)
+{
+    // No erases are allowed yet, but erased space can still be filled
+    GovernorType governor{mem_, ledger_, {1, std::chrono::seconds(1000), 0}};
+    ASSERT_EQ(governor.Init(), RESULT_SUCCESS);
+    ASSERT_EQ(governor.Save(1), RESULT_SUCCESS);
+    ASSERT_FALSE(governor.pending());
+    ASSERT_FALSE(governor.throttled());
+
+    for (uint32_t i = 2; !governor.pending(); i++)
+    {
+        ASSERT_EQ(governor.Save(i), RESULT_SUCCESS);
+    }
+
+    ASSERT_TRUE(governor.throttled());
+    ASSERT_EQ(governor.memory().max_erase_count(), 0u);
+}
+
+TEST_F(WearGovernorTest, LedgerSurvivesRestart)
+{
+    constexpr demo::WearBudget kBudget{100, std::chrono::seconds(100), 2};
+
+    {
+        GovernorType governor{mem_, ledger_, kBudget};
+        ASSERT_EQ(governor.Init(), RESULT_SUCCESS);
+
+        for (uint32_t i = 0; i < 1000; i++)
+        {
+            ASSERT_EQ(governor.Save(i), RESULT_SUCCESS);
+        }
+
+        ASSERT_TRUE(governor.throttled());
+        FakeClock::time_ += std::chrono::seconds(10);
+        ASSERT_EQ(governor.Flush(), RESULT_SUCCESS);
+    }
+
+    // The clock restarts, but the wear and service time do not
+    FakeClock::time_ = {};
+    GovernorType governor{mem_, ledger_, kBudget};
+    ASSERT_EQ(governor.Init(), RESULT_SUCCESS);
+    ASSERT_EQ(governor.elapsed(), 10u);
+    ASSERT_EQ(governor.allowance(), 12u);
+    ASSERT_GE(governor.memory().max_erase_count(), 2u);
+
+    for (uint32_t i = 0; i < 1000; i++)
+    {
+        ASSERT_EQ(governor.Save(i), RESULT_SUCCESS);
+    }
+
+    ASSERT_TRUE(governor.throttled());
+    ASSERT_LE(governor.memory().max_erase_count(), 12u);
+}
+
+TEST_F(WearGovernorTest, LedgerBatched)
+{
+    constexpr demo::WearBudget kBudget{1000000, std::chrono::seconds(1), 0};
+    constexpr uint32_t kNumUnits = MemType::kSize / 256;
+    uint32_t counts[kNumUnits];
+    uint32_t erases = 0;
+
+    {
+        GovernorType governor{mem_, ledger_, kBudget, 8};
+        ASSERT_EQ(governor.Init(), RESULT_SUCCESS);
+        FakeClock::time_ += std::chrono::seconds(1);
+
+        for (uint32_t i = 0; i < 2000; i++)
+        {
+            ASSERT_EQ(governor.Save(i), RESULT_SUCCESS);
+        }
+
+        for (uint32_t unit = 0; unit < kNumUnits; unit++)
+        {
+            counts[unit] = governor.memory().erase_count(unit);
+            erases += counts[unit];
+        }
+
+        // At most one ledger save per eight erases
+        ASSERT_GE(erases, 16u);
+        ASSERT_GE(governor.stats().ledger_saves, 1u);
+        ASSERT_LE(governor.stats().ledger_saves * 8, erases);
+    }
+
+    // Without a Flush, a crash loses fewer than eight erases per unit
+    GovernorType governor{mem_, ledger_, kBudget, 8};
+    ASSERT_EQ(governor.Init(), RESULT_SUCCESS);
+
+    for (uint32_t unit = 0; unit < kNumUnits; unit++)
+    {
+        ASSERT_LE(governor.memory().erase_count(unit), counts[unit]);
+        ASSERT_GT(governor.memory().erase_count(unit) + 8, counts[unit]);
+    }
+}
+
+TEST_F(WearGovernorTest, LedgerErasesGoverned)
+{
+    // A small ledger wears faster than the data it records
+    using DataType = Memory<4096, 256, 4>;
+    using LedgerType = Memory<128, 64, 4>;
+    using SmallLedgerGovernor = demo::WearGovernor<DataType, uint32_t, 0,
+        FakeClock, LedgerType>;
+    constexpr demo::WearBudget kBudget{100, std::chrono::seconds(100), 4};
+
+    DataType data;
+    LedgerType ledger;
+    data.Init();
+    ledger.Init();
+    SmallLedgerGovernor governor{data, ledger, kBudget, 1};
+    ASSERT_EQ(governor.Init(), RESULT_SUCCESS);
+
+    for (uint32_t i = 0; i < 10000; i++)
+    {
+        ASSERT_EQ(governor.Save(i), RESULT_SUCCESS);
+    }
+
+    // The ledger, not the data, ran out of budget
+    ASSERT_TRUE(governor.throttled());
+    ASSERT_EQ(governor.ledger_memory().max_erase_count(), 4u);
+    ASSERT_LT(governor.memory().max_erase_count(), 4u);
+
+    // Ledger wear is recorded in the ledger itself
+    ASSERT_EQ(governor.Flush(), RESULT_SUCCESS);
+    SmallLedgerGovernor reader{data, ledger, kBudget, 1};
+    ASSERT_EQ(reader.Init(), RESULT_SUCCESS);
+    ASSERT_GE(reader.ledger_memory().max_erase_count(), 4u);
+}
+
+TEST_F(WearGovernorTest, Flush)
+{
+    // Programmed memory, so the first save has to erase
+    memset(mem_.mem_, 0, MemType::kSize);
+
+    GovernorType governor{mem_, ledger_, {1, std::chrono::seconds(1000), 0}};
+    ASSERT_EQ(governor.Init(), RESULT_SUCCESS);
+    ASSERT_EQ(governor.Save(5), RESULT_SUCCESS);
+    ASSERT_TRUE(governor.pending());
+
+    ASSERT_EQ(governor.Flush(), RESULT_SUCCESS);
+    ASSERT_FALSE(governor.pending());
+
+    GovernorType reader{mem_, ledger_, {1, std::chrono::seconds(1000), 0}};
+    ASSERT_EQ(reader.Init(), RESULT_SUCCESS);
+    uint32_t data = 0;
+    ASSERT_EQ(reader.Load(data), RESULT_SUCCESS);
+    ASSERT_EQ(data, 5u);
+}
+
+}
@@ -0,0 +1,661 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Coroutine interface to Persist for event-loop services (requires C++20).
+// EventLoop is a single-threaded executor; Task<T> is a lazily started
+// coroutine that may be awaited from another Task or spawned on the loop.
+//
+// AsyncPersist suspends the calling coroutine until the loop reaches its
+// operation, so many persisted objects can be in flight on one thread with
+// their Loads and Saves interleaved. Persist itself calls the Memory
+// synchronously, so with an ordinary Memory each individual Init, Load or
+// Save still runs to completion once started.
+//
+// A Memory may instead be awaitable, providing
+//
+//     Task<bool> ReadAsync(void* dst, uint32_t location, uint32_t size);
+//     Task<bool> WriteAsync(uint32_t location, const void* src, uint32_t size);
+//     Task<bool> EraseAsync(uint32_t location, uint32_t size);
+//
+// AsyncPersist<persist::Persist<Memory, T, version>, T> over such a Memory
+// runs Persist against a RAM copy of the medium, which it reads in at Init.
+// Persist's erases and writes are recorded there and then issued to the
+// Memory in order, suspending on each, so the loop keeps running while the
+// medium works. Load is served from the copy. Operations on one object run
+// one at a time. If the medium fails or throws part way through a Save, the
+// copy is read back in before the next operation.
+//
+// An exception thrown inside a Task, such as one from a Memory, is rethrown
+// where the Task is awaited or waited on.
+
+#pragma once
+
+#if __cpp_impl_coroutine
+
+#include <algorithm>
+#include <concepts>
+#include <coroutine>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <list>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "persist/persist.h"
+#include "util/blank_scan.h"
+
+namespace demo
+{
+
+template <typename T>
+class Task;
+
+namespace detail
+{
+
+template <typename T>
+struct PromiseBase
+{
+    std::coroutine_handle<> continuation_;
+    std::exception_ptr exception_;
+
+    std::suspend_always initial_suspend(void) noexcept
+    {
+        return {};
+    }
+
+    struct FinalAwaiter
+    {
+        bool await_ready(void) noexcept
+        {
+            return false;
+        }
+
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(
+            std::coroutine_handle<Promise> handle) noexcept
+        {
+            auto continuation = handle.promise().continuation_;
+            return continuation ? continuation : std::noop_coroutine();
+        }
+
+        void await_resume(void) noexcept {}
+    };
+
+    FinalAwaiter final_suspend(void) noexcept
+    {
+        return {};
+    }
+
+    void unhandled_exception(void)
+    {
+        exception_ = std::current_exception();
+    }
+
+    void Rethrow(void)
+    {
+        if (exception_)
+        {
+            std::rethrow_exception(exception_);
+        }
+    }
+};
+
+template <typename T>
+struct Promise : PromiseBase<T>
+{
+    std::optional<T> value_;
+
+    Task<T> get_return_object(void);
+
+    void return_value(T value)
+    {
+        value_ = std::move(value);
+    }
+
+    T Result(void)
+    {
+        this->Rethrow();
+        return std::move(*value_);
+    }
+};
+
+template <>
+struct Promise<void> : PromiseBase<void>
+{
+    Task<void> get_return_object(void);
+    void return_void(void) {}
+
+    void Result(void)
+    {
+        Rethrow();
+    }
+};
+
+}
+
+template <typename T = void>
+class Task
+{
+public:
+    using promise_type = detail::Promise<T>;
+    using Handle = std::coroutine_handle<promise_type>;
+
+    explicit Task(Handle handle) :
+        handle_(handle)
+    {}
+
+    Task(Task&& other) noexcept :
+        handle_(std::exchange(other.handle_, nullptr))
+    {}
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task()
+    {
+        if (handle_)
+        {
+            handle_.destroy();
+        }
+    }
+
+    bool await_ready(void)
+    {
+        return false;
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller)
+    {
+        handle_.promise().continuation_ = caller;
+        return handle_;
+    }
+
+    T await_resume(void)
+    {
+        return handle_.promise().Result();
+    }
+
+    bool Done(void) const
+    {
+        return handle_.done();
+    }
+
+    Handle handle(void) const
+    {
+        return handle_;
+    }
+
+protected:
+    Handle handle_;
+};
+
+template <typename T>
+Task<T> detail::Promise<T>::get_return_object(void)
+{
+    return Task<T>{std::coroutine_handle<Promise<T>>::from_promise(*this)};
+}
+
+inline Task<void> detail::Promise<void>::get_return_object(void)
+{
+    using Handle = std::coroutine_handle<Promise<void>>;
+    return Task<void>{Handle::from_promise(*this)};
+}
+
+class EventLoop
+{
+public:
+    // Awaiting the result suspends the caller and queues it on the loop.
+    auto Schedule(void)
+    {
+        struct Awaiter
+        {
+            EventLoop& loop;
+
+            bool await_ready(void) noexcept
+            {
+                return false;
+            }
+
+            void await_suspend(std::coroutine_handle<> handle)
+            {
+                loop.ready_.push_back(handle);
+            }
+
+            void await_resume(void) noexcept {}
+        };
+
+        return Awaiter{*this};
+    }
+
+    // Queues a suspended coroutine to be resumed by Run.
+    void Post(std::coroutine_handle<> handle)
+    {
+        ready_.push_back(handle);
+    }
+
+    // Takes ownership of a task and starts it on the next Run.
+    void Spawn(Task<void> task)
+    {
+        ready_.push_back(task.handle());
+        spawned_.push_back(std::move(task));
+    }
+
+    // Resumes queued coroutines until none are left, then rethrows the
+    // first exception that escaped a spawned task.
+    void Run(void)
+    {
+        while (!ready_.empty())
+        {
+            auto handle = ready_.front();
+            ready_.pop_front();
+            handle.resume();
+        }
+
+        std::exception_ptr exception;
+
+        spawned_.remove_if([&](const Task<void>& task)
+        {
+            if (!task.Done())
+            {
+                return false;
+            }
+
+            if (!exception)
+            {
+                exception = task.handle().promise().exception_;
+            }
+
+            return true;
+        });
+
+        if (exception)
+        {
+            std::rethrow_exception(exception);
+        }
+    }
+
+    // Runs the loop until task completes and returns its result. Must not be
+    // called from a coroutine running on this loop.
+    template <typename T>
+    T SyncWait(Task<T> task)
+    {
+        ready_.push_back(task.handle());
+
+        while (!task.Done())
+        {
+            Run();
+        }
+
+        return task.await_resume();
+    }
+
+protected:
+    std::deque<std::coroutine_handle<>> ready_;
+    std::list<Task<void>> spawned_;
+};
+
+template <typename Persist, typename T>
+class AsyncPersist
+{
+public:
+    template <typename... Args>
+    AsyncPersist(EventLoop& loop, Args&&... args) :
+        loop_(loop),
+        persist_{std::forward<Args>(args)...}
+    {}
+
+    Task<persist::Result> InitAsync(void)
+    {
+        co_await loop_.Schedule();
+        co_return persist_.Init();
+    }
+
+    // data must outlive the returned task.
+    Task<persist::Result> LoadAsync(T& data)
+    {
+        co_await loop_.Schedule();
+        co_return persist_.Load(data);
+    }
+
+    // data is copied into the coroutine frame.
+    Task<persist::Result> SaveAsync(T data)
+    {
+        co_await loop_.Schedule();
+        co_return persist_.Save(data);
+    }
+
+    persist::Result Init(void)
+    {
+        return loop_.SyncWait(InitAsync());
+    }
+
+    persist::Result Load(T& data)
+    {
+        return loop_.SyncWait(LoadAsync(data));
+    }
+
+    persist::Result Save(const T& data)
+    {
+        return loop_.SyncWait(SaveAsync(data));
+    }
+
+protected:
+    EventLoop& loop_;
+    Persist persist_;
+};
+
+template <typename Memory>
+concept AsyncMemory = requires(Memory& memory, void* dst, const void* src,
+    uint32_t n)
+{
+    { memory.ReadAsync(dst, n, n) } -> std::same_as<Task<bool>>;
+    { memory.WriteAsync(n, src, n) } -> std::same_as<Task<bool>>;
+    { memory.EraseAsync(n, n) } -> std::same_as<Task<bool>>;
+};
+
+namespace detail
+{
+
+// RAM copy of an awaitable Memory that records every erase and write.
+template <typename Memory>
+class ShadowMemory
+{
+public:
+    static constexpr uint32_t kSize = Memory::kSize;
+    static constexpr uint32_t kEraseGranularity = Memory::kEraseGranularity;
+    static constexpr uint32_t kWriteGranularity = Memory::kWriteGranularity;
+    static constexpr uint8_t kFillByte = Memory::kFillByte;
+
+    struct Op
+    {
+        bool erase;
+        uint32_t location;
+        uint32_t size;
+        std::vector<uint8_t> data;  // Empty for an erase
+    };
+
+    ShadowMemory(void) :
+        mem_(kSize, kFillByte)
+    {}
+
+    bool Read(void* dst, uint32_t location, uint32_t size)
+    {
+        if (!Accessible(location, size))
+        {
+            return false;
+        }
+
+        std::memcpy(dst, &mem_[location], size);
+        return true;
+    }
+
+    bool Writable(uint32_t location, uint32_t size)
+    {
+        return Accessible(location, size) &&
+            !(location % kWriteGranularity) && !(size % kWriteGranularity) &&
+            IsAllFill(&mem_[location], size, kFillByte);
+    }
+
+    bool Write(uint32_t location, const void* src, uint32_t size)
+    {
+        if (!Writable(location, size))
+        {
+            return false;
+        }
+
+        auto bytes = static_cast<const uint8_t*>(src);
+        std::memcpy(&mem_[location], bytes, size);
+        ops_.push_back({false, location, size, {bytes, bytes + size}});
+        return true;
+    }
+
+    bool Erase(uint32_t location, uint32_t size)
+    {
+        if (!Accessible(location, size) || (location % kEraseGranularity) ||
+            (size % kEraseGranularity))
+        {
+            return false;
+        }
+
+        std::fill_n(&mem_[location], size, kFillByte);
+        ops_.push_back({true, location, size, {}});
+        return true;
+    }
+
+    uint8_t* data(void) { return mem_.data(); }
+    std::vector<Op>& ops(void) { return ops_; }
+
+protected:
+    std::vector<uint8_t> mem_;
+    std::vector<Op> ops_;
+
+    static bool Accessible(uint32_t location, uint32_t size)
+    {
+        return location <= kSize && size <= kSize - location;
+    }
+};
+
+}
+
+template <AsyncMemory Memory, typename T, uint8_t datatype_version>
+class AsyncPersist<persist::Persist<Memory, T, datatype_version>, T>
+{
+public:
+    static constexpr uint32_t kReadChunk = 4096;
+
+    AsyncPersist(EventLoop& loop, Memory& memory) :
+        loop_(loop),
+        memory_(memory),
+        persist_{shadow_},
+        synced_(false),
+        busy_(false)
+    {}
+
+    AsyncPersist(const AsyncPersist&) = delete;
+    AsyncPersist& operator=(const AsyncPersist&) = delete;
+
+    Task<persist::Result> InitAsync(void)
+    {
+        auto guard = co_await Acquire();
+        co_return co_await Resync();
+    }
+
+    // data must outlive the returned task.
+    Task<persist::Result> LoadAsync(T& data)
+    {
+        auto guard = co_await Acquire();
+
+        if (!synced_)
+        {
+            persist::Result result = co_await Resync();
+
+            if (result != persist::RESULT_SUCCESS)
+            {
+                co_return result;
+            }
+        }
+
+        co_return persist_.Load(data);
+    }
+
+    // data is copied into the coroutine frame.
+    Task<persist::Result> SaveAsync(T data)
+    {
+        auto guard = co_await Acquire();
+
+        if (!synced_)
+        {
+            persist::Result result = co_await Resync();
+
+            if (result != persist::RESULT_SUCCESS)
+            {
+                co_return result;
+            }
+        }
+
+        shadow_.ops().clear();
+        persist::Result result = persist_.Save(data);
+
+        // Until every recorded operation lands, the copy is ahead of the
+        // medium
+        synced_ = false;
+
+        for (auto& op : shadow_.ops())
+        {
+            bool ok = op.erase ?
+                co_await memory_.EraseAsync(op.location, op.size) :
+                co_await memory_.WriteAsync(op.location, op.data.data(),
+                    op.size);
+
+            if (!ok)
+            {
+                co_return persist::RESULT_FAIL_MEMORY;
+            }
+        }
+
+        shadow_.ops().clear();
+        synced_ = true;
+        co_return result;
+    }
+
+    persist::Result Init(void)
+    {
+        return loop_.SyncWait(InitAsync());
+    }
+
+    persist::Result Load(T& data)
+    {
+        return loop_.SyncWait(LoadAsync(data));
+    }
+
+    persist::Result Save(const T& data)
+    {
+        return loop_.SyncWait(SaveAsync(data));
+    }
+
+protected:
+    using Shadow = detail::ShadowMemory<Memory>;
+
+    // Releases the object to the next waiting operation when destroyed.
+    class Guard
+    {
+    public:
+        explicit Guard(AsyncPersist* owner) :
+            owner_(owner)
+        {}
+
+        Guard(Guard&& other) noexcept :
+            owner_(std::exchange(other.owner_, nullptr))
+        {}
+
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+
+        ~Guard()
+        {
+            if (owner_)
+            {
+                owner_->Release();
+            }
+        }
+
+    protected:
+        AsyncPersist* owner_;
+    };
+
+    EventLoop& loop_;
+    Memory& memory_;
+    Shadow shadow_;
+    persist::Persist<Shadow, T, datatype_version> persist_;
+    bool synced_;   // Whether the copy matches the medium
+    bool busy_;
+    std::deque<std::coroutine_handle<>> waiting_;
+
+    auto Acquire(void)
+    {
+        struct Awaiter
+        {
+            AsyncPersist& owner;
+
+            bool await_ready(void) noexcept
+            {
+                return !std::exchange(owner.busy_, true);
+            }
+
+            void await_suspend(std::coroutine_handle<> handle)
+            {
+                owner.waiting_.push_back(handle);
+            }
+
+            Guard await_resume(void) noexcept
+            {
+                return Guard{&owner};
+            }
+        };
+
+        return Awaiter{*this};
+    }
+
+    void Release(void)
+    {
+        if (waiting_.empty())
+        {
+            busy_ = false;
+            return;
+        }
+
+        // Ownership passes straight to the next operation
+        loop_.Post(waiting_.front());
+        waiting_.pop_front();
+    }
+
+    // Reads the whole medium into the copy and reinitializes Persist on it.
+    Task<persist::Result> Resync(void)
+    {
+        synced_ = false;
+
+        for (uint32_t location = 0; location < Memory::kSize;
+            location += kReadChunk)
+        {
+            uint32_t size = std::min(kReadChunk, Memory::kSize - location);
+
+            if (!co_await memory_.ReadAsync(shadow_.data() + location,
+                location, size))
+            {
+                co_return persist::RESULT_FAIL_MEMORY;
+            }
+        }
+
+        shadow_.ops().clear();
+        persist::Result result = persist_.Init();
+        synced_ = (result == persist::RESULT_SUCCESS);
+        co_return result;
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,249 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Kernels for finding erased space: the first byte in a buffer that differs
+// from a memory's fill byte. On x86 the AVX2 kernel is chosen at run time
+// when the CPU supports it, even if the build only enables SSE2; otherwise
+// the widest vector unit enabled at compile time is used (SSE2 or AArch64
+// NEON), with a word-at-a-time fallback.
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define DEMO_BLANK_SCAN_AVX2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace demo
+{
+
+namespace detail
+{
+
+// Each kernel returns the index of the first byte of data that is not fill,
+// or size if every byte is fill.
+using FindFirstNotFillKernel = uint32_t (*)(const uint8_t* bytes,
+    uint32_t size, uint8_t fill);
+
+inline uint32_t FindFirstNotFillTail(const uint8_t* bytes, uint32_t i,
+    uint32_t size, uint8_t fill)
+{
+    for (; i < size; i++)
+    {
+        if (bytes[i] != fill)
+        {
+            return i;
+        }
+    }
+
+    return size;
+}
+
+inline uint32_t FindFirstNotFillWord(const uint8_t* bytes, uint32_t size,
+    uint8_t fill)
+{
+    uint64_t fill_word = 0x0101010101010101ull * fill;
+    uint32_t i = 0;
+
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        std::memcpy(&word, bytes + i, sizeof(word));
+
+        if (word != fill_word)
+        {
+            break;
+        }
+    }
+
+    return FindFirstNotFillTail(bytes, i, size, fill);
+}
+
+#if defined(__SSE2__)
+inline uint32_t FindFirstNotFillSse2(const uint8_t* bytes, uint32_t size,
+    uint8_t fill)
+{
+    __m128i fill_vector = _mm_set1_epi8(fill);
+    uint32_t i = 0;
+
+    for (; i + 16 <= size; i += 16)
+    {
+        __m128i block = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(bytes + i));
+        uint32_t equal = _mm_movemask_epi8(_mm_cmpeq_epi8(block, fill_vector));
+
+        if (equal != 0xFFFF)
+        {
+            return i + __builtin_ctz(~equal);
+        }
+    }
+
+    return FindFirstNotFillTail(bytes, i, size, fill);
+}
+#endif
+
+#if defined(DEMO_BLANK_SCAN_AVX2)
+__attribute__((target("avx2")))
+inline uint32_t FindFirstNotFillAvx2(const uint8_t* bytes, uint32_t size,
+    uint8_t fill)
+{
+    __m256i fill_vector = _mm256_set1_epi8(fill);
+    uint32_t i = 0;
+
+    for (; i + 32 <= size; i += 32)
+    {
+        __m256i block = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(bytes + i));
+        uint32_t equal = _mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(block, fill_vector));
+
+        if (equal != 0xFFFFFFFF)
+        {
+            return i + __builtin_ctz(~equal);
+        }
+    }
+
+    return FindFirstNotFillTail(bytes, i, size, fill);
+}
+
+inline bool CpuHasAvx2(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+#endif
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+inline uint32_t FindFirstNotFillNeon(const uint8_t* bytes, uint32_t size,
+    uint8_t fill)
+{
+    uint8x16_t fill_vector = vdupq_n_u8(fill);
+    uint32_t i = 0;
+
+    for (; i + 16 <= size; i += 16)
+    {
+        uint8x16_t equal = vceqq_u8(vld1q_u8(bytes + i), fill_vector);
+
+        if (vminvq_u8(equal) != 0xFF)
+        {
+            break;
+        }
+    }
+
+    return FindFirstNotFillTail(bytes, i, size, fill);
+}
+#endif
+
+struct BlankScanKernel
+{
+    const char* name;
+    FindFirstNotFillKernel find;
+};
+
+inline BlankScanKernel SelectBlankScanKernel(void)
+{
+#if defined(DEMO_BLANK_SCAN_AVX2)
+    if (CpuHasAvx2())
+    {
+        return {"avx2", FindFirstNotFillAvx2};
+    }
+#endif
+
+#if defined(__SSE2__)
+    return {"sse2", FindFirstNotFillSse2};
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    return {"neon", FindFirstNotFillNeon};
+#else
+    return {"word", FindFirstNotFillWord};
+#endif
+}
+
+// Chosen once, on first use
+inline const BlankScanKernel& ActiveBlankScanKernel(void)
+{
+    static const BlankScanKernel kernel = SelectBlankScanKernel();
+    return kernel;
+}
+
+}
+
+// Name of the kernel in use, for diagnostics and benchmarks
+inline const char* BlankScanKernelName(void)
+{
+    return detail::ActiveBlankScanKernel().name;
+}
+
+// Returns the index of the first byte of data that is not fill, or size if
+// every byte is fill.
+inline uint32_t FindFirstNotFill(const void* data, uint32_t size, uint8_t fill)
+{
+    return detail::ActiveBlankScanKernel().find(
+        static_cast<const uint8_t*>(data), size, fill);
+}
+
+inline bool IsAllFill(const void* data, uint32_t size, uint8_t fill)
+{
+    return FindFirstNotFill(data, size, fill) == size;
+}
+
+// Finds the first byte in [location, location + size) of a Memory that is
+// not its fill byte, reading the memory in large chunks. Sets found to
+// location + size if the whole range is blank. Returns false if a read
+// fails.
+template <typename Memory>
+bool FindFirstNotFill(Memory& memory, uint32_t location, uint32_t size,
+    uint32_t& found)
+{
+    constexpr uint32_t kChunkSize = 1024;
+    uint8_t buffer[kChunkSize];
+
+    while (size)
+    {
+        uint32_t length = (size < kChunkSize) ? size : kChunkSize;
+
+        if (!memory.Read(buffer, location, length))
+        {
+            return false;
+        }
+
+        uint32_t index = FindFirstNotFill(buffer, length, Memory::kFillByte);
+
+        if (index < length)
+        {
+            found = location + index;
+            return true;
+        }
+
+        location += length;
+        size -= length;
+    }
+
+    found = location;
+    return true;
+}
+
+}
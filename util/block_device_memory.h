@@ -0,0 +1,421 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Memory on a raw block device or file, opened with O_DIRECT so that reads
+// and writes bypass the page cache and reach the device when they return.
+// Transfers go through a pool of aligned bounce buffers, sized to the
+// device's logical block and shared between threads.
+//
+// kWriteGranularity and kEraseGranularity must be multiples of the device's
+// logical block (typically 512 or 4096 bytes), so that Persist only issues
+// whole-sector writes; a device with larger sectors leaves the memory
+// invalid, since a torn read-modify-write of a shared sector could lose both
+// the old and the new generation. Direct calls that do not cover whole
+// sectors still work, by reading back the partial sectors first, but are not
+// atomic. The default geometry suits any logical block up to 4096 bytes,
+// which is also what a regular file is assumed to need when the kernel
+// cannot report its direct I/O alignment.
+//
+// Durability:
+//     DURABILITY_DSYNC       the descriptor is opened with O_DSYNC, so each
+//                            write is durable when it returns, like a FUA
+//                            write
+//     DURABILITY_FDATASYNC   each Write and Erase ends with fdatasync
+//     DURABILITY_NONE        nothing beyond O_DIRECT; call Sync to make
+//                            earlier writes durable
+//
+// A regular file shorter than kSize is extended and filled with kFillByte,
+// so a loopback file can stand in for a device.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "util/blank_scan.h"
+
+namespace demo
+{
+
+enum Durability
+{
+    DURABILITY_DSYNC,
+    DURABILITY_FDATASYNC,
+    DURABILITY_NONE,
+};
+
+template <uint32_t memory_size, uint32_t erase_granularity = 4096,
+    uint32_t write_granularity = 4096>
+class BlockDeviceMemory
+{
+public:
+    static constexpr uint32_t kSize = memory_size;
+    static constexpr uint32_t kEraseGranularity = erase_granularity;
+    static constexpr uint32_t kWriteGranularity = write_granularity;
+    static constexpr uint8_t kFillByte = 0xFF;
+
+    static constexpr uint32_t kBufferAlignment = 4096;
+    static constexpr uint32_t kBufferSize = 64 * 1024;
+
+    static_assert(kSize % kEraseGranularity == 0);
+
+    BlockDeviceMemory(const std::string& path,
+        Durability durability = DURABILITY_DSYNC) :
+        durability_(durability),
+        block_size_(0)
+    {
+        int flags = O_RDWR | O_DIRECT | O_CLOEXEC |
+            ((durability == DURABILITY_DSYNC) ? O_DSYNC : 0);
+        fd_ = open(path.c_str(), flags | O_CREAT, 0644);
+
+        if (fd_ < 0)
+        {
+            return;
+        }
+
+        struct stat st;
+        bool ok = fstat(fd_, &st) == 0 && Probe(st);
+
+        if (ok && S_ISREG(st.st_mode) && st.st_size < off_t(kSize))
+        {
+            // Extend first so that the sector holding the old end of file
+            // can be read back in full
+            ok = ftruncate(fd_, kSize) == 0 &&
+                Fill(st.st_size, kSize - st.st_size);
+        }
+
+        if (!ok)
+        {
+            close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    BlockDeviceMemory(const BlockDeviceMemory&) = delete;
+    BlockDeviceMemory& operator=(const BlockDeviceMemory&) = delete;
+
+    ~BlockDeviceMemory()
+    {
+        for (auto buffer : buffers_)
+        {
+            std::free(buffer);
+        }
+
+        if (fd_ >= 0)
+        {
+            close(fd_);
+        }
+    }
+
+    // False if the device could not be opened with O_DIRECT, is too small,
+    // or has sectors larger than the bounce buffers or the write or erase
+    // granularity.
+    bool valid(void) const
+    {
+        return fd_ >= 0;
+    }
+
+    // The device's logical block size, which every transfer is aligned to.
+    uint32_t block_size(void) const
+    {
+        return block_size_;
+    }
+
+    // Makes every completed write durable.
+    bool Sync(void)
+    {
+        return fdatasync(fd_) == 0;
+    }
+
+    bool Read(void* dst, uint32_t location, uint32_t length)
+    {
+        if (!Contains(location, length))
+        {
+            return false;
+        }
+
+        Buffer buffer{*this};
+        auto out = static_cast<uint8_t*>(dst);
+
+        while (length)
+        {
+            uint32_t start = RoundDown(location);
+            uint32_t offset = location - start;
+            uint32_t chunk = std::min(length, kBufferSize - offset);
+
+            if (!ReadBlocks(buffer.data, start, RoundUp(offset + chunk)))
+            {
+                return false;
+            }
+
+            std::memcpy(out, buffer.data + offset, chunk);
+            out += chunk;
+            location += chunk;
+            length -= chunk;
+        }
+
+        return true;
+    }
+
+    bool Writable(uint32_t location, uint32_t length)
+    {
+        if (!Contains(location, length) ||
+            (location % kWriteGranularity) || (length % kWriteGranularity))
+        {
+            return false;
+        }
+
+        Buffer buffer{*this};
+
+        while (length)
+        {
+            uint32_t start = RoundDown(location);
+            uint32_t offset = location - start;
+            uint32_t chunk = std::min(length, kBufferSize - offset);
+
+            if (!ReadBlocks(buffer.data, start, RoundUp(offset + chunk)) ||
+                !IsAllFill(buffer.data + offset, chunk, kFillByte))
+            {
+                return false;
+            }
+
+            location += chunk;
+            length -= chunk;
+        }
+
+        return true;
+    }
+
+    bool Write(uint32_t location, const void* src, uint32_t length)
+    {
+        auto in = static_cast<const uint8_t*>(src);
+
+        return Contains(location, length) &&
+            Modify(location, length, [&](uint8_t* dst, uint32_t offset,
+                uint32_t chunk)
+            {
+                std::memcpy(dst, in + offset, chunk);
+            }) &&
+            Durable();
+    }
+
+    bool Erase(uint32_t location, uint32_t length)
+    {
+        return Contains(location, length) &&
+            !(location % kEraseGranularity) && !(length % kEraseGranularity) &&
+            Fill(location, length) &&
+            Durable();
+    }
+
+protected:
+    int fd_;
+    Durability durability_;
+    uint32_t block_size_;
+
+    std::mutex pool_mutex_;
+    std::vector<uint8_t*> buffers_;
+    std::vector<uint8_t*> free_;
+
+    // Borrows an aligned buffer from the pool for the duration of a call.
+    struct Buffer
+    {
+        BlockDeviceMemory& memory;
+        uint8_t* data;
+
+        Buffer(BlockDeviceMemory& owner) :
+            memory(owner),
+            data(owner.Acquire())
+        {}
+
+        ~Buffer()
+        {
+            memory.Release(data);
+        }
+    };
+
+    uint8_t* Acquire(void)
+    {
+        std::lock_guard lock{pool_mutex_};
+
+        if (free_.empty())
+        {
+            void* buffer = nullptr;
+
+            if (posix_memalign(&buffer, kBufferAlignment, kBufferSize) != 0)
+            {
+                return nullptr;
+            }
+
+            buffers_.push_back(static_cast<uint8_t*>(buffer));
+            return buffers_.back();
+        }
+
+        uint8_t* buffer = free_.back();
+        free_.pop_back();
+        return buffer;
+    }
+
+    void Release(uint8_t* buffer)
+    {
+        if (buffer != nullptr)
+        {
+            std::lock_guard lock{pool_mutex_};
+            free_.push_back(buffer);
+        }
+    }
+
+    // Finds the logical block size and checks the device is large enough.
+    bool Probe(const struct stat& st)
+    {
+        if (S_ISBLK(st.st_mode))
+        {
+            int sector = 0;
+            uint64_t bytes = 0;
+
+            if (ioctl(fd_, BLKSSZGET, &sector) != 0 ||
+                ioctl(fd_, BLKGETSIZE64, &bytes) != 0 || bytes < kSize)
+            {
+                return false;
+            }
+
+            block_size_ = sector;
+        }
+        else
+        {
+            block_size_ = kBufferAlignment;
+
+#ifdef STATX_DIOALIGN
+            struct statx stx;
+
+            if (statx(fd_, "", AT_EMPTY_PATH, STATX_DIOALIGN, &stx) == 0 &&
+                (stx.stx_mask & STATX_DIOALIGN) && stx.stx_dio_offset_align)
+            {
+                block_size_ = stx.stx_dio_offset_align;
+            }
+#endif
+        }
+
+        return block_size_ && block_size_ <= kBufferAlignment &&
+            !(kBufferAlignment % block_size_) &&
+            !(kWriteGranularity % block_size_) &&
+            !(kEraseGranularity % block_size_);
+    }
+
+    static bool Contains(uint32_t location, uint32_t length)
+    {
+        return location <= kSize && length <= kSize - location;
+    }
+
+    uint32_t RoundDown(uint64_t location) const
+    {
+        return location - location % block_size_;
+    }
+
+    uint32_t RoundUp(uint32_t length) const
+    {
+        return (length + block_size_ - 1) / block_size_ * block_size_;
+    }
+
+    bool ReadBlocks(uint8_t* buffer, uint32_t location, uint32_t length)
+    {
+        return buffer != nullptr &&
+            pread(fd_, buffer, length, location) == ssize_t(length);
+    }
+
+    bool WriteBlocks(const uint8_t* buffer, uint32_t location, uint32_t length)
+    {
+        return buffer != nullptr &&
+            pwrite(fd_, buffer, length, location) == ssize_t(length);
+    }
+
+    // Applies fn to [location, location + length) a buffer at a time,
+    // reading back any partially covered sectors first.
+    template <typename Fn>
+    bool Modify(uint32_t location, uint32_t length, Fn fn)
+    {
+        Buffer buffer{*this};
+        uint32_t done = 0;
+
+        if (buffer.data == nullptr)
+        {
+            return false;
+        }
+
+        while (done < length)
+        {
+            uint32_t start = RoundDown(location + done);
+            uint32_t offset = location + done - start;
+            uint32_t chunk = std::min(length - done, kBufferSize - offset);
+            uint32_t span = RoundUp(offset + chunk);
+
+            if (offset && !ReadBlocks(buffer.data, start, block_size_))
+            {
+                return false;
+            }
+
+            if ((offset + chunk) % block_size_ &&
+                !ReadBlocks(buffer.data + span - block_size_,
+                    start + span - block_size_, block_size_))
+            {
+                return false;
+            }
+
+            fn(buffer.data + offset, done, chunk);
+
+            if (!WriteBlocks(buffer.data, start, span))
+            {
+                return false;
+            }
+
+            done += chunk;
+        }
+
+        return true;
+    }
+
+    bool Fill(uint32_t location, uint32_t length)
+    {
+        return Modify(location, length, [](uint8_t* dst, uint32_t,
+            uint32_t chunk)
+        {
+            std::memset(dst, kFillByte, chunk);
+        });
+    }
+
+    bool Durable(void)
+    {
+        return durability_ != DURABILITY_FDATASYNC || Sync();
+    }
+};
+
+}
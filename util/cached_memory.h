@@ -0,0 +1,300 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Read cache in front of a slow Memory. Persist's Init, Load and especially
+// LoadLegacy re-read the same blocks many times; CachedMemory keeps an LRU
+// of num_lines erase-unit-sized buffers so that repeated reads are served
+// from RAM.
+//
+// Writes and erases go straight through to the memory and update any cached
+// copy of the affected units; if the memory reports a failure, the affected
+// units are dropped instead, since their contents are no longer known.
+// Writable is answered from the cache when every unit it covers is cached,
+// using the same blank and alignment test as FileMemory; otherwise it is
+// forwarded. Call Invalidate if anything else modifies the memory.
+//
+// Like the memories it wraps, CachedMemory is not thread-safe.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include "util/blank_scan.h"
+
+namespace demo
+{
+
+template <typename Memory, uint32_t num_lines>
+class CachedMemory
+{
+public:
+    static constexpr uint32_t kSize = Memory::kSize;
+    static constexpr uint32_t kEraseGranularity = Memory::kEraseGranularity;
+    static constexpr uint32_t kWriteGranularity = Memory::kWriteGranularity;
+    static constexpr uint8_t kFillByte = Memory::kFillByte;
+    static constexpr uint32_t kLineSize = kEraseGranularity;
+    static constexpr uint32_t kNumLines = num_lines;
+
+    static_assert(kNumLines > 0);
+    static_assert(kSize % kLineSize == 0);
+
+    struct Stats
+    {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+    };
+
+    CachedMemory(Memory& memory) :
+        memory_(memory),
+        stats_{},
+        tick_(0)
+    {
+        Invalidate();
+    }
+
+    // Drops every cached unit.
+    void Invalidate(void)
+    {
+        for (auto& line : lines_)
+        {
+            line.valid = false;
+        }
+    }
+
+    const Stats& stats(void) const
+    {
+        return stats_;
+    }
+
+    bool Read(void* dst, uint32_t location, uint32_t length)
+    {
+        if (!Contains(location, length))
+        {
+            return memory_.Read(dst, location, length);
+        }
+
+        auto out = static_cast<uint8_t*>(dst);
+
+        while (length)
+        {
+            uint32_t offset = location % kLineSize;
+            uint32_t chunk = std::min(length, kLineSize - offset);
+            Line* line = Fetch(location / kLineSize);
+
+            if (line == nullptr)
+            {
+                return false;
+            }
+
+            std::memcpy(out, line->data + offset, chunk);
+            out += chunk;
+            location += chunk;
+            length -= chunk;
+        }
+
+        return true;
+    }
+
+    bool Writable(uint32_t location, uint32_t length)
+    {
+        if (!Contains(location, length))
+        {
+            return memory_.Writable(location, length);
+        }
+
+        uint32_t first = location / kLineSize;
+        uint32_t last = (location + length + kLineSize - 1) / kLineSize;
+
+        for (uint32_t unit = first; unit < last; unit++)
+        {
+            if (Find(unit) == nullptr)
+            {
+                return memory_.Writable(location, length);
+            }
+        }
+
+        if ((location % kWriteGranularity) || (length % kWriteGranularity))
+        {
+            return false;
+        }
+
+        while (length)
+        {
+            uint32_t offset = location % kLineSize;
+            uint32_t chunk = std::min(length, kLineSize - offset);
+            Line* line = Find(location / kLineSize);
+
+            if (!IsAllFill(line->data + offset, chunk, kFillByte))
+            {
+                return false;
+            }
+
+            location += chunk;
+            length -= chunk;
+        }
+
+        return true;
+    }
+
+    bool Write(uint32_t location, const void* src, uint32_t length)
+    {
+        bool result = memory_.Write(location, src, length);
+        auto in = static_cast<const uint8_t*>(src);
+
+        Update(location, length, [&](uint8_t* dst, uint32_t offset,
+            uint32_t chunk)
+        {
+            std::memcpy(dst, in + offset, chunk);
+        }, result);
+
+        return result;
+    }
+
+    bool Erase(uint32_t location, uint32_t length)
+    {
+        bool result = memory_.Erase(location, length);
+
+        Update(location, length, [&](uint8_t* dst, uint32_t, uint32_t chunk)
+        {
+            std::memset(dst, kFillByte, chunk);
+        }, result);
+
+        return result;
+    }
+
+protected:
+    struct Line
+    {
+        uint32_t unit;
+        bool valid;
+        uint64_t used;
+        uint8_t data[kLineSize];
+    };
+
+    Memory& memory_;
+    Line lines_[kNumLines];
+    Stats stats_;
+    uint64_t tick_;
+
+    static bool Contains(uint32_t location, uint32_t length)
+    {
+        return location <= kSize && length <= kSize - location;
+    }
+
+    Line* Find(uint32_t unit)
+    {
+        for (auto& line : lines_)
+        {
+            if (line.valid && line.unit == unit)
+            {
+                return &line;
+            }
+        }
+
+        return nullptr;
+    }
+
+    // Returns the cached unit, reading it from memory on a miss.
+    Line* Fetch(uint32_t unit)
+    {
+        Line* line = Find(unit);
+
+        if (line != nullptr)
+        {
+            stats_.hits++;
+            line->used = ++tick_;
+            return line;
+        }
+
+        stats_.misses++;
+        line = &lines_[0];
+
+        for (auto& each : lines_)
+        {
+            if (!each.valid)
+            {
+                line = &each;
+                break;
+            }
+
+            if (each.used < line->used)
+            {
+                line = &each;
+            }
+        }
+
+        if (line->valid)
+        {
+            stats_.evictions++;
+        }
+
+        line->valid = memory_.Read(line->data, unit * kLineSize, kLineSize);
+
+        if (!line->valid)
+        {
+            return nullptr;
+        }
+
+        line->unit = unit;
+        line->used = ++tick_;
+        return line;
+    }
+
+    // Applies a successful change to the cached copies of the affected
+    // units, or drops them if the change failed.
+    template <typename Fn>
+    void Update(uint32_t location, uint32_t length, Fn apply, bool result)
+    {
+        if (!Contains(location, length))
+        {
+            return;
+        }
+
+        uint32_t offset = 0;
+
+        while (offset < length)
+        {
+            uint32_t line_offset = (location + offset) % kLineSize;
+            uint32_t chunk = std::min(length - offset, kLineSize - line_offset);
+            Line* line = Find((location + offset) / kLineSize);
+
+            if (line != nullptr)
+            {
+                if (result)
+                {
+                    apply(line->data + line_offset, offset, chunk);
+                }
+                else
+                {
+                    line->valid = false;
+                }
+            }
+
+            offset += chunk;
+        }
+    }
+};
+
+}
@@ -0,0 +1,222 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Wrapper around a Persist-like type that drops redundant saves without
+// touching the memory. It remembers the last committed payload in RAM, by
+// default as a fingerprint (its length, CRC-16 and a 64-bit hash); with
+// use_hash false it keeps an exact copy instead, at the cost of sizeof(T)
+// bytes, and compares with memcmp. A Save whose payload matches returns
+// success immediately, so callers that save on every tick cost O(payload)
+// CPU and no memory reads or writes when nothing has changed.
+//
+// The fingerprint is only refreshed by this wrapper, so it assumes it is the
+// only writer to the underlying memory.
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+#include "persist/persist.h"
+#include "util/probed_persist.h"
+
+namespace demo
+{
+
+namespace detail
+{
+
+// Word-at-a-time multiply-xorshift hash. Not cryptographic; it only backs up
+// the CRC so that two different payloads are very unlikely to collide.
+inline uint64_t Hash64(const void* data, uint32_t length)
+{
+    constexpr uint64_t kMul = 0x9E3779B97F4A7C15ull;
+    auto bytes = static_cast<const uint8_t*>(data);
+    uint64_t hash = length * kMul;
+
+    auto mix = [&](uint64_t word)
+    {
+        hash ^= word * kMul;
+        hash = ((hash << 31) | (hash >> 33)) * kMul;
+    };
+
+    for (; length >= 8; bytes += 8, length -= 8)
+    {
+        uint64_t word;
+        std::memcpy(&word, bytes, 8);
+        mix(word);
+    }
+
+    if (length)
+    {
+        uint64_t word = 0;
+        std::memcpy(&word, bytes, length);
+        mix(word);
+    }
+
+    hash ^= hash >> 29;
+    return hash * kMul;
+}
+
+}
+
+template <typename Persist, typename T, bool use_hash = true>
+class ElidingPersist
+{
+public:
+    static_assert(std::is_trivially_copyable_v<T>);
+
+    struct Stats
+    {
+        uint32_t saves;
+        uint32_t elided;
+    };
+
+    template <typename... Args>
+    ElidingPersist(Args&&... args) :
+        persist_{std::forward<Args>(args)...},
+        stats_{},
+        known_(false)
+    {
+        crc_.Init();
+    }
+
+    persist::Result Init(void)
+    {
+        known_ = false;
+        persist::Result result = persist_.Init();
+
+        if (result == persist::RESULT_SUCCESS)
+        {
+            T data;
+
+            if (persist_.Load(data) == persist::RESULT_SUCCESS)
+            {
+                last_ = Summarize(data);
+                known_ = true;
+            }
+        }
+
+        return result;
+    }
+
+    persist::Result Load(T& data)
+    {
+        return persist_.Load(data);
+    }
+
+    template <typename... Legacy>
+    persist::Result LoadLegacy(T& data)
+    {
+        // Loading a legacy version may migrate it, so forget the fingerprint
+        // rather than guess what is now stored.
+        known_ = false;
+        return persist_.template LoadLegacy<Legacy...>(data);
+    }
+
+    persist::Result Save(const T& data)
+    {
+        stats_.saves++;
+        Summary summary = Summarize(data);
+
+        if (known_ && Same(summary, last_))
+        {
+            stats_.elided++;
+            return persist::RESULT_SUCCESS;
+        }
+
+        persist::Result result = persist_.Save(data);
+
+        if (result == persist::RESULT_SUCCESS)
+        {
+            last_ = summary;
+            known_ = true;
+        }
+        else
+        {
+            known_ = false;
+        }
+
+        return result;
+    }
+
+    const Stats& stats(void) const
+    {
+        return stats_;
+    }
+
+protected:
+    struct Print
+    {
+        uint32_t length;
+        uint16_t crc;
+        uint64_t hash;
+
+        bool operator==(const Print& other) const
+        {
+            return length == other.length && crc == other.crc &&
+                hash == other.hash;
+        }
+    };
+
+    // What Save compares against: a fingerprint or the payload itself
+    using Summary = std::conditional_t<use_hash, Print, T>;
+
+    Persist persist_;
+    ProbedCrc16 crc_;
+    Stats stats_;
+    Summary last_;
+    bool known_;
+
+    Summary Summarize(const T& data)
+    {
+        if constexpr (use_hash)
+        {
+            Print print;
+            print.length = sizeof(T);
+            crc_.Seed(0);
+            print.crc = crc_.Process(&data, sizeof(T));
+            print.hash = detail::Hash64(&data, sizeof(T));
+            return print;
+        }
+        else
+        {
+            return data;
+        }
+    }
+
+    static bool Same(const Summary& a, const Summary& b)
+    {
+        if constexpr (use_hash)
+        {
+            return a == b;
+        }
+        else
+        {
+            return std::memcmp(&a, &b, sizeof(T)) == 0;
+        }
+    }
+};
+
+}
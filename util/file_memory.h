@@ -22,52 +22,69 @@
 
 #pragma once
 
+#include <cassert>
 #include <cstdint>
-#include <cstdio>
 #include <cstring>
-#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "util/blank_scan.h"
+#include "util/probes.h"
+#include "util/scatter_gather.h"
 
 namespace demo
 {
 
-class FileMemory
+// All accesses use positional I/O on a single descriptor, so one FileMemory
+// may be shared between threads without the accesses disturbing each other.
+// Callers must still serialize overlapping writes themselves.
+template <uint32_t memory_size, uint32_t erase_granularity,
+    uint32_t write_granularity>
+class BasicFileMemory
 {
 public:
-    static constexpr uint32_t kSize = 256;
-    static constexpr uint32_t kEraseGranularity = 64;
-    static constexpr uint32_t kWriteGranularity = 16;
+    static constexpr uint32_t kSize = memory_size;
+    static constexpr uint32_t kEraseGranularity = erase_granularity;
+    static constexpr uint32_t kWriteGranularity = write_granularity;
     static constexpr uint8_t kFillByte = 0xFF;
 
-    FileMemory(const std::string file_path)
+    BasicFileMemory(const std::string file_path)
     {
-        file_ = fopen(file_path.c_str(), "ab");
-        assert(file_ != nullptr);
-        file_ = freopen(file_path.c_str(), "r+b", file_);
-        assert(file_ != nullptr);
+        fd_ = open(file_path.c_str(), O_RDWR | O_CREAT, 0644);
+        assert(fd_ >= 0);
 
-        fseek(file_, 0, SEEK_END);
-        uint32_t size = ftell(file_);
+        off_t end = lseek(fd_, 0, SEEK_END);
+        assert(end >= 0);
 
-        while (size++ < kSize)
+        if (end < kSize)
         {
             // Pad file to kSize
-            fputc(kFillByte, file_);
+            bool padded = Fill(end, kSize - end);
+            assert(padded);
+            (void)padded;
         }
     }
 
-    ~FileMemory()
+    BasicFileMemory(const BasicFileMemory&) = delete;
+    BasicFileMemory& operator=(const BasicFileMemory&) = delete;
+
+    ~BasicFileMemory()
     {
-        if (file_ != nullptr)
+        if (fd_ >= 0)
         {
-            fclose(file_);
+            close(fd_);
         }
     }
 
     bool Read(void* dst, uint32_t location, uint32_t size)
     {
-        fseek(file_, location, SEEK_SET);
-        uint32_t num = fread(dst, 1, size, file_);
-        return num == size;
+        DEMO_PROBE2(file_read_entry, location, size);
+        bool result = pread(fd_, dst, size, location) == ssize_t(size);
+        DEMO_PROBE3(file_read_return, location, size, result);
+        return result;
     }
 
     bool Writable(uint32_t location, uint32_t size)
@@ -77,25 +94,78 @@ public:
             return false;
         }
 
-        fseek(file_, location, SEEK_SET);
+        DEMO_PROBE2(file_writable_entry, location, size);
+        uint32_t found;
+        bool result = FindFirstNotFill(*this, location, size, found) &&
+            found == location + size;
+        DEMO_PROBE3(file_writable_return, location, size, result);
+        return result;
+    }
 
-        for (uint32_t i = 0; i < size; i++)
+    bool Write(uint32_t location, const void* src, uint32_t size)
+    {
+        DEMO_PROBE2(file_write_entry, location, size);
+        bool result = pwrite(fd_, src, size, location) == ssize_t(size);
+        DEMO_PROBE3(file_write_return, location, size, result);
+        return result;
+    }
+
+    bool ReadV(const Segment* dst, uint32_t count, uint32_t location)
+    {
+        iovec iov[kMaxSegments];
+
+        while (count)
         {
-            if (fgetc(file_) != kFillByte)
+            uint32_t num = (count < kMaxSegments) ? count : kMaxSegments;
+            uint32_t size = 0;
+
+            for (uint32_t i = 0; i < num; i++)
+            {
+                iov[i].iov_base = dst[i].data;
+                iov[i].iov_len = dst[i].size;
+                size += dst[i].size;
+            }
+
+            if (preadv(fd_, iov, num, location) != ssize_t(size))
             {
                 return false;
             }
+
+            dst += num;
+            count -= num;
+            location += size;
         }
 
         return true;
     }
 
-    bool Write(uint32_t location, const void* src, uint32_t size)
+    bool WriteV(uint32_t location, const ConstSegment* src, uint32_t count)
     {
-        fseek(file_, location, SEEK_SET);
-        uint32_t num = fwrite(src, 1, size, file_);
-        fflush(file_);
-        return num == size;
+        iovec iov[kMaxSegments];
+
+        while (count)
+        {
+            uint32_t num = (count < kMaxSegments) ? count : kMaxSegments;
+            uint32_t size = 0;
+
+            for (uint32_t i = 0; i < num; i++)
+            {
+                iov[i].iov_base = const_cast<void*>(src[i].data);
+                iov[i].iov_len = src[i].size;
+                size += src[i].size;
+            }
+
+            if (pwritev(fd_, iov, num, location) != ssize_t(size))
+            {
+                return false;
+            }
+
+            src += num;
+            count -= num;
+            location += size;
+        }
+
+        return true;
     }
 
     bool Erase(uint32_t location, uint32_t size)
@@ -105,22 +175,50 @@ public:
             return false;
         }
 
-        fseek(file_, location, SEEK_SET);
+        DEMO_PROBE2(file_erase_entry, location, size);
+        bool result = Fill(location, size);
+        DEMO_PROBE3(file_erase_return, location, size, result);
+        return result;
+    }
+
+    // Makes every completed write durable. Writes themselves only reach the
+    // page cache.
+    bool Sync(void)
+    {
+        DEMO_PROBE0(file_sync_entry);
+        bool result = fdatasync(fd_) == 0;
+        DEMO_PROBE1(file_sync_return, result);
+        return result;
+    }
 
-        for (uint32_t i = 0; i < size; i++)
+protected:
+    static constexpr uint32_t kMaxSegments = 8;
+    static constexpr uint32_t kChunkSize = 1024;
+
+    int fd_;
+
+    bool Fill(uint32_t location, uint32_t size)
+    {
+        uint8_t fill[kChunkSize];
+        std::memset(fill, kFillByte, kChunkSize);
+
+        while (size)
         {
-            if (fputc(kFillByte, file_) != kFillByte)
+            uint32_t length = (size < kChunkSize) ? size : kChunkSize;
+
+            if (!Write(location, fill, length))
             {
                 return false;
             }
+
+            location += length;
+            size -= length;
         }
 
-        fflush(file_);
         return true;
     }
-
-protected:
-    FILE* file_;
 };
 
+using FileMemory = BasicFileMemory<256, 64, 16>;
+
 }
@@ -0,0 +1,208 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Group commit for Persist instances that share one durable medium, such as
+// several partitions of one image file. Instead of syncing after every
+// Save, each GroupCommitPersist issues its writes and then joins the open
+// batch in a GroupCommit. One waiting thread becomes the leader: it waits up
+// to the batching window for more saves to join, closes the batch, runs a
+// single sync, and wakes every member with the result. Saves that arrive
+// during a sync form the next batch, so throughput grows with concurrency
+// instead of being capped at one sync per save.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include "persist/persist.h"
+
+namespace demo
+{
+
+class GroupCommit
+{
+public:
+    struct Stats
+    {
+        uint64_t commits;
+        uint64_t batches;
+        uint64_t failed_batches;
+        uint32_t max_batch;
+    };
+
+    // sync makes every write completed so far durable, e.g. by calling
+    // FileMemory::Sync. The leader holds a batch open for up to window, or
+    // until max_batch saves have joined.
+    GroupCommit(std::function<bool()> sync,
+        std::chrono::microseconds window = std::chrono::microseconds(0),
+        uint32_t max_batch = UINT32_MAX) :
+        sync_(std::move(sync)),
+        window_(window),
+        max_batch_(max_batch),
+        open_(std::make_shared<Batch>()),
+        syncing_(false),
+        stats_{}
+    {}
+
+    // Blocks until writes completed before the call are durable. Returns
+    // false if the sync covering them failed.
+    bool Commit(void)
+    {
+        std::unique_lock lock{mutex_};
+        std::shared_ptr<Batch> batch = open_;
+        batch->size++;
+        stats_.commits++;
+
+        if (batch->size >= max_batch_)
+        {
+            changed_.notify_all();
+        }
+
+        for (;;)
+        {
+            if (batch->done)
+            {
+                return batch->ok;
+            }
+
+            if (syncing_)
+            {
+                changed_.wait(lock);
+                continue;
+            }
+
+            // Lead this batch
+            syncing_ = true;
+
+            if (window_.count())
+            {
+                changed_.wait_for(lock, window_, [&]()
+                {
+                    return batch->size >= max_batch_;
+                });
+            }
+
+            open_ = std::make_shared<Batch>();
+            lock.unlock();
+            bool ok = sync_();
+            lock.lock();
+
+            batch->ok = ok;
+            batch->done = true;
+            syncing_ = false;
+            stats_.batches++;
+            stats_.failed_batches += !ok;
+            stats_.max_batch = std::max(stats_.max_batch, batch->size);
+            changed_.notify_all();
+        }
+    }
+
+    Stats stats(void)
+    {
+        std::lock_guard lock{mutex_};
+        return stats_;
+    }
+
+protected:
+    struct Batch
+    {
+        uint32_t size = 0;
+        bool done = false;
+        bool ok = false;
+    };
+
+    std::function<bool()> sync_;
+    std::chrono::microseconds window_;
+    uint32_t max_batch_;
+
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::shared_ptr<Batch> open_;
+    bool syncing_;
+    Stats stats_;
+};
+
+// Persist whose Save returns only once the write is durable, syncing
+// through a GroupCommit shared with other instances on the same medium.
+// Calls on one instance are serialized; different instances may save
+// concurrently if their Memories allow it. A Save whose sync fails returns
+// RESULT_FAIL_MEMORY, though the value may already be loadable.
+template <typename Persist, typename T>
+class GroupCommitPersist
+{
+public:
+    template <typename... Args>
+    GroupCommitPersist(GroupCommit& group, Args&&... args) :
+        group_(group),
+        persist_{std::forward<Args>(args)...}
+    {}
+
+    persist::Result Init(void)
+    {
+        std::lock_guard lock{mutex_};
+        return persist_.Init();
+    }
+
+    persist::Result Load(T& data)
+    {
+        std::lock_guard lock{mutex_};
+        return persist_.Load(data);
+    }
+
+    template <typename... Legacy>
+    persist::Result LoadLegacy(T& data)
+    {
+        std::lock_guard lock{mutex_};
+        return persist_.template LoadLegacy<Legacy...>(data);
+    }
+
+    persist::Result Save(const T& data)
+    {
+        persist::Result result;
+
+        {
+            std::lock_guard lock{mutex_};
+            result = persist_.Save(data);
+        }
+
+        if (result == persist::RESULT_SUCCESS && !group_.Commit())
+        {
+            result = persist::RESULT_FAIL_MEMORY;
+        }
+
+        return result;
+    }
+
+protected:
+    GroupCommit& group_;
+    std::mutex mutex_;
+    Persist persist_;
+};
+
+}
@@ -0,0 +1,258 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Read-back of older generations of a persisted value. Persist writes each
+// Save to a new block, so older generations stay on the medium until their
+// erase unit is recycled. PersistHistory finds them without knowledge of the
+// block format. Init reads the medium once into a RAM snapshot, then mounts
+// Persist on the snapshot, records the range that Load reads for the newest
+// generation, blanks that range in the snapshot and mounts again to find the
+// next newest, until no valid block remains or depth generations are found.
+// Only the first pass touches the medium; the rest run against RAM, but
+// each costs a full Persist::Init, which is why the depth is bounded.
+//
+// This relies on Persist::Load reading only the block it returns. The
+// history is a snapshot taken by Init; call Init again after further Saves.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "persist/persist.h"
+#include "util/blank_scan.h"
+
+namespace demo
+{
+
+// Read-only copy of a Memory in RAM, taken with one pass over the medium.
+// Blank erases a range of the copy only. Between Capture and Captured, it
+// records the range covered by reads.
+template <typename Memory>
+class SnapshotMemory
+{
+public:
+    static constexpr uint32_t kSize = Memory::kSize;
+    static constexpr uint32_t kEraseGranularity = Memory::kEraseGranularity;
+    static constexpr uint32_t kWriteGranularity = Memory::kWriteGranularity;
+    static constexpr uint8_t kFillByte = Memory::kFillByte;
+
+    SnapshotMemory(void) :
+        data_(kSize, kFillByte)
+    {}
+
+    bool Load(Memory& memory)
+    {
+        constexpr uint32_t kChunk = 65536;
+
+        for (uint32_t location = 0; location < kSize; location += kChunk)
+        {
+            uint32_t length = std::min(kChunk, kSize - location);
+
+            if (!memory.Read(data_.data() + location, location, length))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    void Blank(uint32_t location, uint32_t size)
+    {
+        std::memset(data_.data() + location, kFillByte, size);
+    }
+
+    void Capture(void)
+    {
+        captured_ = Range{kSize, 0};
+    }
+
+    bool Captured(uint32_t& location, uint32_t& size) const
+    {
+        if (captured_.begin >= captured_.end)
+        {
+            return false;
+        }
+
+        location = captured_.begin;
+        size = captured_.end - captured_.begin;
+        return true;
+    }
+
+    bool Read(void* dst, uint32_t location, uint32_t length)
+    {
+        if (!Contains(location, length))
+        {
+            return false;
+        }
+
+        std::memcpy(dst, data_.data() + location, length);
+        captured_.begin = std::min(captured_.begin, location);
+        captured_.end = std::max(captured_.end, location + length);
+        return true;
+    }
+
+    bool Writable(uint32_t location, uint32_t length)
+    {
+        return Contains(location, length) &&
+            !(location % kWriteGranularity) &&
+            !(length % kWriteGranularity) &&
+            IsAllFill(data_.data() + location, length, kFillByte);
+    }
+
+    bool Write(uint32_t, const void*, uint32_t)
+    {
+        return false;
+    }
+
+    bool Erase(uint32_t, uint32_t)
+    {
+        return false;
+    }
+
+protected:
+    struct Range
+    {
+        uint32_t begin;
+        uint32_t end;
+    };
+
+    std::vector<uint8_t> data_;
+    Range captured_{kSize, 0};
+
+    static bool Contains(uint32_t location, uint32_t length)
+    {
+        return location <= kSize && length <= kSize - location;
+    }
+};
+
+template <typename Memory, typename T, uint8_t datatype_version>
+class PersistHistory
+{
+public:
+    struct Generation
+    {
+        T data;
+
+        // Range of the memory holding this generation
+        uint32_t location;
+        uint32_t size;
+    };
+
+    using const_iterator = typename std::vector<Generation>::const_iterator;
+
+    // Generations found by Init unless the constructor asks for more
+    static constexpr uint32_t kDefaultDepth = 8;
+
+    // Init finds at most depth generations. Each one costs a Persist::Init
+    // over the snapshot, so the CPU time of Init grows with depth.
+    PersistHistory(Memory& memory, uint32_t depth = kDefaultDepth) :
+        memory_(memory),
+        depth_(depth)
+    {}
+
+    // Scans the memory for up to depth valid generations, newest first.
+    persist::Result Init(void)
+    {
+        generations_.clear();
+
+        SnapshotMemory<Memory> snapshot;
+
+        if (!snapshot.Load(memory_))
+        {
+            return persist::RESULT_FAIL_NO_DATA;
+        }
+
+        while (generations_.size() < depth_)
+        {
+            persist::Persist<SnapshotMemory<Memory>, T, datatype_version> p{
+                snapshot};
+            persist::Result result = p.Init();
+
+            if (result != persist::RESULT_SUCCESS)
+            {
+                return result;
+            }
+
+            Generation generation;
+            snapshot.Capture();
+
+            if (p.Load(generation.data) != persist::RESULT_SUCCESS ||
+                !snapshot.Captured(generation.location, generation.size))
+            {
+                break;
+            }
+
+            snapshot.Blank(generation.location, generation.size);
+            generations_.push_back(generation);
+        }
+
+        return persist::RESULT_SUCCESS;
+    }
+
+    // Generation 0 is the newest.
+    persist::Result LoadGeneration(uint32_t n, T& data) const
+    {
+        if (n >= generations_.size())
+        {
+            return persist::RESULT_FAIL_NO_DATA;
+        }
+
+        data = generations_[n].data;
+        return persist::RESULT_SUCCESS;
+    }
+
+    uint32_t size(void) const
+    {
+        return generations_.size();
+    }
+
+    uint32_t depth(void) const
+    {
+        return depth_;
+    }
+
+    const Generation& operator[](uint32_t n) const
+    {
+        return generations_[n];
+    }
+
+    const_iterator begin(void) const
+    {
+        return generations_.begin();
+    }
+
+    const_iterator end(void) const
+    {
+        return generations_.end();
+    }
+
+protected:
+    Memory& memory_;
+    uint32_t depth_;
+    std::vector<Generation> generations_;
+};
+
+}
@@ -0,0 +1,74 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Builds ready-to-flash Persist images for a batch of units in parallel.
+// Each unit's image is produced by running Persist itself against a
+// SpanMemory over that unit's slot of a caller-provided buffer, so headers,
+// checksums and block placement always match what a device would write.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "persist/persist.h"
+#include "util/parallel_for.h"
+
+namespace demo
+{
+
+// Writes one image per element of values into images, which must hold
+// count * Memory::kSize bytes. Memory must be constructible from a pointer
+// to its buffer and provide Format(), as SpanMemory does. Returns the number
+// of images that could not be built; if built is not null, built[i] tells
+// whether image i is usable. A num_threads of zero selects the number of
+// hardware threads.
+template <typename Memory, typename T, uint8_t datatype_version>
+uint32_t BuildImages(const T* values, uint32_t count, uint8_t* images,
+    uint32_t num_threads = 0, bool* built = nullptr)
+{
+    std::atomic<uint32_t> failures{0};
+
+    ParallelFor(count, num_threads, [&](uint32_t i)
+    {
+        Memory memory{images + uint64_t(i) * Memory::kSize};
+        memory.Format();
+
+        persist::Persist<Memory, T, datatype_version> persist{memory};
+        bool ok = persist.Init() == persist::RESULT_SUCCESS &&
+            persist.Save(values[i]) == persist::RESULT_SUCCESS;
+
+        if (!ok)
+        {
+            failures++;
+        }
+
+        if (built != nullptr)
+        {
+            built[i] = ok;
+        }
+    });
+
+    return failures;
+}
+
+}
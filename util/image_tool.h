@@ -0,0 +1,468 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Commands of persist-tool, which inspects and maintains Persist image
+// files offline. A Profile names the memory geometry, payload size and
+// datatype version of a kind of image, since Persist needs all three to
+// recognize its blocks. Each command runs on one memory-mapped image.
+
+#pragma once
+
+#include <cctype>
+#include <cerrno>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "persist/persist.h"
+#include "util/blank_scan.h"
+#include "util/history.h"
+
+namespace demo
+{
+
+template <uint32_t size>
+struct Payload
+{
+    uint8_t bytes[size];
+};
+
+class MappedImage
+{
+public:
+    MappedImage(const char* path, uint32_t size, bool writable) :
+        data_(nullptr),
+        size_(size),
+        writable_(writable)
+    {
+        int fd = open(path, writable ? O_RDWR : O_RDONLY);
+
+        if (fd < 0)
+        {
+            error_ = "cannot open";
+            return;
+        }
+
+        struct stat st;
+
+        if (fstat(fd, &st) != 0 || st.st_size != off_t(size))
+        {
+            error_ = "size is not " + std::to_string(size) + " bytes";
+            close(fd);
+            return;
+        }
+
+        // Read-only commands map privately, so nothing reaches the file
+        void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+            writable ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+        close(fd);
+
+        if (data == MAP_FAILED)
+        {
+            error_ = "cannot map";
+            return;
+        }
+
+        data_ = static_cast<uint8_t*>(data);
+    }
+
+    MappedImage(const MappedImage&) = delete;
+    MappedImage& operator=(const MappedImage&) = delete;
+
+    ~MappedImage()
+    {
+        if (data_ != nullptr)
+        {
+            if (writable_)
+            {
+                msync(data_, size_, MS_SYNC);
+            }
+
+            munmap(data_, size_);
+        }
+    }
+
+    uint8_t* data(void) const
+    {
+        return data_;
+    }
+
+    const std::string& error(void) const
+    {
+        return error_;
+    }
+
+protected:
+    uint8_t* data_;
+    uint32_t size_;
+    bool writable_;
+    std::string error_;
+};
+
+// Atomically replaces the file at path with size bytes of data: writes a
+// uniquely named temporary file beside it, syncs it and renames it over the
+// original, so a crash leaves either the old image or the new one.
+inline bool ReplaceImage(const char* link_path, const uint8_t* data,
+    uint32_t size, std::string& error)
+{
+    // Replace the file a symlink points at rather than the link itself
+    char* real_path = realpath(link_path, nullptr);
+    struct stat st;
+
+    if (real_path == nullptr || stat(real_path, &st) != 0)
+    {
+        free(real_path);
+        error = "cannot stat";
+        return false;
+    }
+
+    std::string path = real_path;
+    free(real_path);
+    std::string temp_path = path + ".XXXXXX";
+    int fd = mkstemp(temp_path.data());
+
+    if (fd < 0)
+    {
+        error = "cannot create a temporary file beside the image";
+        return false;
+    }
+
+    bool ok = fchmod(fd, st.st_mode & 07777) == 0;
+
+    for (uint32_t done = 0; ok && done < size; )
+    {
+        ssize_t n = write(fd, data + done, size - done);
+        ok = n > 0;
+        done += ok ? n : 0;
+    }
+
+    ok = ok && fsync(fd) == 0;
+    ok = (close(fd) == 0) && ok;
+    ok = ok && rename(temp_path.c_str(), path.c_str()) == 0;
+
+    if (!ok)
+    {
+        unlink(temp_path.c_str());
+        error = "cannot replace image";
+        return false;
+    }
+
+    // Make the rename itself durable
+    std::string dir = path.substr(0, path.rfind('/') + 1);
+    int dir_fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+
+    if (dir_fd >= 0)
+    {
+        fsync(dir_fd);
+        close(dir_fd);
+    }
+
+    return true;
+}
+
+struct Profile
+{
+    using Command = bool (*)(uint8_t* image, std::string& report);
+
+    const char* name;
+    const char* description;
+    uint32_t image_size;
+    Command dump;
+    Command verify;
+    Command wear;
+    Command compact;
+    Command format;
+};
+
+template <typename Memory, uint32_t payload_size, uint8_t datatype_version>
+struct ProfileCommands
+{
+    using Data = Payload<payload_size>;
+    using PersistType = persist::Persist<Memory, Data, datatype_version>;
+    using HistoryType = PersistHistory<Memory, Data, datatype_version>;
+
+    // Generations listed; each one costs a scan of the image in RAM
+    static constexpr uint32_t kDepth = 64;
+
+    static void Append(std::string& report, const char* format, ...)
+        __attribute__((format(printf, 2, 3)))
+    {
+        char line[256];
+        va_list args;
+        va_start(args, format);
+        vsnprintf(line, sizeof(line), format, args);
+        va_end(args);
+        report += line;
+    }
+
+    static bool Dump(uint8_t* image, std::string& report)
+    {
+        Memory memory{image};
+        HistoryType history{memory, kDepth};
+
+        if (history.Init() != persist::RESULT_SUCCESS)
+        {
+            Append(report, "  scan failed\n");
+            return false;
+        }
+
+        if (history.size() == 0)
+        {
+            Append(report, "  no valid data\n");
+            return false;
+        }
+
+        for (uint32_t n = 0; n < history.size(); n++)
+        {
+            auto& generation = history[n];
+            Append(report, "  generation %u: offset 0x%04x, %u bytes:",
+                n, generation.location, generation.size);
+
+            for (auto byte : generation.data.bytes)
+            {
+                Append(report, " %02x", byte);
+            }
+
+            Append(report, "\n");
+        }
+
+        if (history.size() == kDepth)
+        {
+            Append(report, "  older generations not listed\n");
+        }
+
+        return true;
+    }
+
+    static bool Verify(uint8_t* image, std::string& report)
+    {
+        Memory memory{image};
+        PersistType persist{memory};
+        Data data;
+
+        if (persist.Init() != persist::RESULT_SUCCESS ||
+            persist.Load(data) != persist::RESULT_SUCCESS)
+        {
+            Append(report, "  FAIL: no valid data\n");
+            return false;
+        }
+
+        HistoryType history{memory, kDepth};
+        history.Init();
+        Append(report, "  OK: %s%u valid generation%s\n",
+            (history.size() == kDepth) ? "at least " : "", history.size(),
+            (history.size() == 1) ? "" : "s");
+        return true;
+    }
+
+    static bool Wear(uint8_t* image, std::string& report)
+    {
+        constexpr uint32_t kUnit = Memory::kEraseGranularity;
+        uint32_t blank = 0;
+        uint32_t partial = 0;
+        uint32_t full = 0;
+        uint32_t programmed = 0;
+
+        for (uint32_t location = 0; location < Memory::kSize;
+            location += kUnit)
+        {
+            uint32_t length = (Memory::kSize - location < kUnit) ?
+                (Memory::kSize - location) : kUnit;
+            uint8_t* unit = image + location;
+            uint32_t used = 0;
+
+            for (uint32_t i = 0; i < length; )
+            {
+                uint32_t skip = FindFirstNotFill(unit + i, length - i,
+                    Memory::kFillByte);
+                i += skip;
+
+                if (i < length)
+                {
+                    used++;
+                    i++;
+                }
+            }
+
+            programmed += used;
+            (used == 0 ? blank : (used == length ? full : partial))++;
+        }
+
+        Append(report, "  erase units: %u blank, %u partial, %u full; "
+            "%u of %u bytes programmed\n",
+            blank, partial, full, programmed, Memory::kSize);
+        return true;
+    }
+
+    // Rewrites image in place; the caller passes a private copy and only
+    // replaces the file if this succeeds.
+    static bool Compact(uint8_t* image, std::string& report)
+    {
+        Memory memory{image};
+        PersistType persist{memory};
+        Data data;
+
+        if (persist.Init() != persist::RESULT_SUCCESS ||
+            persist.Load(data) != persist::RESULT_SUCCESS)
+        {
+            Append(report, "  FAIL: no valid data to keep\n");
+            return false;
+        }
+
+        memory.Format();
+        PersistType fresh{memory};
+
+        if (fresh.Init() != persist::RESULT_SUCCESS ||
+            fresh.Save(data) != persist::RESULT_SUCCESS)
+        {
+            Append(report, "  FAIL: could not rewrite newest generation\n");
+            return false;
+        }
+
+        // Mount the result from scratch before it replaces the original
+        PersistType check{memory};
+        Data stored;
+
+        if (check.Init() != persist::RESULT_SUCCESS ||
+            check.Load(stored) != persist::RESULT_SUCCESS ||
+            memcmp(&stored, &data, sizeof(Data)) != 0)
+        {
+            Append(report, "  FAIL: compacted image does not verify\n");
+            return false;
+        }
+
+        Append(report, "  compacted\n");
+        return true;
+    }
+
+    static bool Format(uint8_t* image, std::string& report)
+    {
+        Memory{image}.Format();
+        Append(report, "  formatted\n");
+        return true;
+    }
+
+    static Profile Make(const char* name, const char* description)
+    {
+        return Profile{name, description, Memory::kSize,
+            Dump, Verify, Wear, Compact, Format};
+    }
+};
+
+enum ImageAccess
+{
+    ACCESS_READ,        // Mapped privately; nothing reaches the file
+    ACCESS_WRITE,       // Mapped shared and changed in place
+    ACCESS_REPLACE,     // Changed in a private copy that replaces the file
+};
+
+struct ImageCommand
+{
+    const char* name;
+    Profile::Command Profile::*command;
+    ImageAccess access;
+};
+
+inline const ImageCommand kImageCommands[] = {
+    {"dump", &Profile::dump, ACCESS_READ},
+    {"verify", &Profile::verify, ACCESS_READ},
+    {"wear", &Profile::wear, ACCESS_READ},
+    {"compact", &Profile::compact, ACCESS_REPLACE},
+    {"format", &Profile::format, ACCESS_WRITE},
+};
+
+inline const ImageCommand* FindImageCommand(const char* name)
+{
+    for (auto& command : kImageCommands)
+    {
+        if (!strcmp(command.name, name))
+        {
+            return &command;
+        }
+    }
+
+    return nullptr;
+}
+
+// Runs command on the image file at path, appending to report. Returns
+// false if the image cannot be opened or the command fails on it.
+inline bool RunImageCommand(const Profile& profile,
+    const ImageCommand& command, const char* path, std::string& report)
+{
+    MappedImage image{path, profile.image_size,
+        command.access == ACCESS_WRITE};
+
+    if (image.data() == nullptr)
+    {
+        report += "  " + image.error() + "\n";
+        return false;
+    }
+
+    if (!(profile.*command.command)(image.data(), report))
+    {
+        return false;
+    }
+
+    if (command.access == ACCESS_REPLACE)
+    {
+        std::string error;
+
+        if (!ReplaceImage(path, image.data(), profile.image_size, error))
+        {
+            report += "  " + error + "\n";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Parses a positive decimal count, such as a number of threads.
+inline bool ParseCount(const char* text, uint32_t& count)
+{
+    if (!isdigit(static_cast<unsigned char>(text[0])))
+    {
+        return false;
+    }
+
+    char* end;
+    errno = 0;
+    unsigned long value = strtoul(text, &end, 10);
+
+    if (*end != '\0' || errno != 0 || value == 0 || value > UINT32_MAX)
+    {
+        return false;
+    }
+
+    count = value;
+    return true;
+}
+
+}
@@ -0,0 +1,329 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Compile-time block layout for record formats on a Memory geometry.
+//
+// A block holds a fixed-size header and payload and starts on a write
+// granule. BlockLayout considers two ways of placing them:
+//
+//     packed    header and payload back to back, the whole block rounded
+//               up to the write granularity
+//     split     payload first, then the header in its own granule, so the
+//               header can be programmed last as a commit mark
+//
+// and two ways of placing blocks in the memory:
+//
+//     aligned   blocks stay within an erase unit, after an optional unit
+//               header rounded up to the write granularity
+//     straddle  blocks are packed end to end across unit boundaries
+//
+// A format passes the placements it supports. BlockLayout picks the
+// candidate that holds the most blocks, which is the one that saves the most
+// generations per erase. On a tie it prefers split, then aligned.
+//
+// Address arithmetic uses shifts and masks when the divisor is a power of
+// two; other divisors are compile-time constants, which the compiler turns
+// into multiplications.
+
+#pragma once
+
+#include <cstdint>
+
+namespace demo
+{
+
+namespace layout
+{
+
+constexpr bool IsPow2(uint32_t x)
+{
+    return x && !(x & (x - 1));
+}
+
+constexpr uint32_t Log2(uint32_t x)
+{
+    uint32_t log = 0;
+
+    while (x >>= 1)
+    {
+        log++;
+    }
+
+    return log;
+}
+
+template <uint32_t divisor>
+constexpr uint32_t Div(uint32_t x)
+{
+    static_assert(divisor > 0);
+
+    if constexpr (IsPow2(divisor))
+    {
+        return x >> Log2(divisor);
+    }
+    else
+    {
+        return x / divisor;
+    }
+}
+
+template <uint32_t divisor>
+constexpr uint32_t Mod(uint32_t x)
+{
+    static_assert(divisor > 0);
+
+    if constexpr (IsPow2(divisor))
+    {
+        return x & (divisor - 1);
+    }
+    else
+    {
+        return x % divisor;
+    }
+}
+
+template <uint32_t granule>
+constexpr uint32_t RoundUp(uint32_t x)
+{
+    return x + Mod<granule>(granule - Mod<granule>(x));
+}
+
+template <uint32_t granule>
+constexpr uint32_t RoundDown(uint32_t x)
+{
+    return x - Mod<granule>(x);
+}
+
+}
+
+enum LayoutPlacement : uint8_t
+{
+    LAYOUT_PACKED = 1,
+    LAYOUT_SPLIT = 2,
+    LAYOUT_ALIGNED = 4,
+    LAYOUT_STRADDLE = 8,
+    LAYOUT_ANY = 15,
+};
+
+struct LayoutReport
+{
+    uint32_t block_size;
+    uint32_t header_offset;
+    uint32_t payload_offset;
+    uint32_t padding;           // Bytes per block that are neither header
+                                // nor payload
+    bool split;
+    bool straddle;
+    uint32_t blocks_per_unit;   // 0 unless blocks are aligned and smaller
+                                // than an erase unit
+    uint32_t capacity;          // Blocks in the whole memory
+    double write_amplification; // Bytes programmed per payload byte
+    double erases_per_save;     // Erase units erased per block, long run
+};
+
+template <typename Memory, uint32_t header_size, uint32_t payload_size,
+    uint8_t placements = LAYOUT_ANY, uint32_t unit_header_size = 0>
+class BlockLayout
+{
+public:
+    static constexpr uint32_t kSize = Memory::kSize;
+    static constexpr uint32_t kEraseGranularity = Memory::kEraseGranularity;
+    static constexpr uint32_t kWriteGranularity = Memory::kWriteGranularity;
+    static constexpr uint32_t kNumUnits = kSize / kEraseGranularity;
+    // Where blocks start within an aligned unit
+    static constexpr uint32_t kUnitDataOffset =
+        layout::RoundUp<kWriteGranularity>(unit_header_size);
+    // Largest packed payload that fits an aligned unit, whatever
+    // payload_size is
+    static constexpr uint32_t kMaxPayload =
+        (kEraseGranularity > kUnitDataOffset + header_size) ?
+        kEraseGranularity - kUnitDataOffset - header_size : 0;
+
+    static_assert(kSize % kEraseGranularity == 0);
+    static_assert(kEraseGranularity % kWriteGranularity == 0 ||
+        kWriteGranularity % kEraseGranularity == 0);
+    static_assert(header_size > 0 && payload_size > 0);
+    static_assert(placements & (LAYOUT_PACKED | LAYOUT_SPLIT));
+    static_assert(placements & (LAYOUT_ALIGNED | LAYOUT_STRADDLE));
+    static_assert(!unit_header_size || !(placements & LAYOUT_STRADDLE),
+        "Straddling blocks would overlap unit headers");
+
+protected:
+    struct Candidate
+    {
+        bool split;
+        bool straddle;
+        uint32_t block_size;
+        uint32_t capacity;
+    };
+
+    static constexpr uint32_t BlockSize(bool split)
+    {
+        return split ?
+            layout::RoundUp<kWriteGranularity>(payload_size) +
+                layout::RoundUp<kWriteGranularity>(header_size) :
+            layout::RoundUp<kWriteGranularity>(header_size + payload_size);
+    }
+
+    static constexpr uint32_t Capacity(bool split, bool straddle)
+    {
+        uint32_t block = BlockSize(split);
+
+        if (straddle)
+        {
+            return kSize / block;
+        }
+
+        if (kUnitDataOffset + block <= kEraseGranularity)
+        {
+            return kNumUnits * ((kEraseGranularity - kUnitDataOffset) / block);
+        }
+
+        if (kUnitDataOffset)
+        {
+            return 0;
+        }
+
+        // Each block starts on a unit and occupies whole units
+        uint32_t units = (block + kEraseGranularity - 1) / kEraseGranularity;
+        return kNumUnits / units;
+    }
+
+    static constexpr Candidate Choose(void)
+    {
+        Candidate best{};
+        bool found = false;
+
+        for (bool straddle : {false, true})
+        {
+            if (!(placements & (straddle ? LAYOUT_STRADDLE : LAYOUT_ALIGNED)))
+            {
+                continue;
+            }
+
+            for (bool split : {true, false})
+            {
+                if (!(placements & (split ? LAYOUT_SPLIT : LAYOUT_PACKED)))
+                {
+                    continue;
+                }
+
+                Candidate each{split, straddle, BlockSize(split),
+                    Capacity(split, straddle)};
+
+                bool better = !found || each.capacity > best.capacity ||
+                    (each.capacity == best.capacity &&
+                        each.straddle == best.straddle &&
+                        each.split && !best.split);
+
+                if (better)
+                {
+                    best = each;
+                    found = true;
+                }
+            }
+        }
+
+        return best;
+    }
+
+    static constexpr Candidate kChoice = Choose();
+
+public:
+    static constexpr uint32_t kBlockSize = kChoice.block_size;
+    static constexpr bool kSplit = kChoice.split;
+    static constexpr bool kStraddle = kChoice.straddle;
+    static constexpr uint32_t kCapacity = kChoice.capacity;
+    static constexpr uint32_t kHeaderOffset = kSplit ?
+        layout::RoundUp<kWriteGranularity>(payload_size) : 0;
+    static constexpr uint32_t kPayloadOffset = kSplit ? 0 : header_size;
+    static constexpr uint32_t kBlocksPerUnit = (kStraddle ||
+        kUnitDataOffset + kBlockSize > kEraseGranularity) ? 0 :
+        (kEraseGranularity - kUnitDataOffset) / kBlockSize;
+    static constexpr uint32_t kUnitsPerBlock =
+        (kBlockSize + kEraseGranularity - 1) / kEraseGranularity;
+
+    static_assert(kCapacity > 0, "Memory cannot hold a single block");
+
+    static constexpr LayoutReport kLayout{
+        kBlockSize,
+        kHeaderOffset,
+        kPayloadOffset,
+        kBlockSize - header_size - payload_size,
+        kSplit,
+        kStraddle,
+        kBlocksPerUnit,
+        kCapacity,
+        (double(kBlockSize) + (kBlocksPerUnit ?
+            double(kUnitDataOffset) / kBlocksPerUnit : 0.0)) / payload_size,
+        kStraddle ? double(kBlockSize) / kEraseGranularity :
+            kBlocksPerUnit ? 1.0 / kBlocksPerUnit : double(kUnitsPerBlock),
+    };
+
+    // Location of block index, for index < kCapacity.
+    static constexpr uint32_t BlockLocation(uint32_t index)
+    {
+        if constexpr (kStraddle)
+        {
+            return index * kBlockSize;
+        }
+        else if constexpr (kBlocksPerUnit)
+        {
+            return layout::Div<kBlocksPerUnit>(index) * kEraseGranularity +
+                kUnitDataOffset + layout::Mod<kBlocksPerUnit>(index) *
+                kBlockSize;
+        }
+        else
+        {
+            return index * kUnitsPerBlock * kEraseGranularity;
+        }
+    }
+
+    // Index of the block containing location, which must be within a
+    // block.
+    static constexpr uint32_t BlockIndex(uint32_t location)
+    {
+        if constexpr (kStraddle)
+        {
+            return layout::Div<kBlockSize>(location);
+        }
+        else if constexpr (kBlocksPerUnit)
+        {
+            return layout::Div<kEraseGranularity>(location) * kBlocksPerUnit +
+                layout::Div<kBlockSize>(
+                    layout::Mod<kEraseGranularity>(location) -
+                    kUnitDataOffset);
+        }
+        else
+        {
+            return layout::Div<kUnitsPerBlock * kEraseGranularity>(location);
+        }
+    }
+
+    // First erase unit touched by block index.
+    static constexpr uint32_t UnitOf(uint32_t index)
+    {
+        return layout::Div<kEraseGranularity>(BlockLocation(index));
+    }
+};
+
+}
@@ -0,0 +1,104 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Lock policies for LockedPersist. Each policy provides lock/unlock for
+// exclusive access and lock_shared/unlock_shared for readers. Only
+// SharedLock actually lets readers proceed concurrently; the others treat
+// shared access as exclusive.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+
+namespace demo
+{
+
+// For single-threaded use. Costs nothing.
+struct NullLock
+{
+    void lock(void) {}
+    void unlock(void) {}
+    void lock_shared(void) {}
+    void unlock_shared(void) {}
+};
+
+struct MutexLock
+{
+    std::mutex mutex_;
+
+    void lock(void) { mutex_.lock(); }
+    void unlock(void) { mutex_.unlock(); }
+    void lock_shared(void) { mutex_.lock(); }
+    void unlock_shared(void) { mutex_.unlock(); }
+};
+
+// Busy-waits instead of sleeping. Suited to short critical sections on
+// memories with low latency, such as RAM or memory-mapped flash.
+class SpinLock
+{
+public:
+    void lock(void)
+    {
+        while (locked_.exchange(true, std::memory_order_acquire))
+        {
+            uint32_t spins = 0;
+
+            while (locked_.load(std::memory_order_relaxed))
+            {
+                if (++spins >= kSpinsBeforeYield)
+                {
+                    std::this_thread::yield();
+                    spins = 0;
+                }
+            }
+        }
+    }
+
+    void unlock(void)
+    {
+        locked_.store(false, std::memory_order_release);
+    }
+
+    void lock_shared(void) { lock(); }
+    void unlock_shared(void) { unlock(); }
+
+protected:
+    static constexpr uint32_t kSpinsBeforeYield = 64;
+
+    std::atomic<bool> locked_{false};
+};
+
+struct SharedLock
+{
+    std::shared_mutex mutex_;
+
+    void lock(void) { mutex_.lock(); }
+    void unlock(void) { mutex_.unlock(); }
+    void lock_shared(void) { mutex_.lock_shared(); }
+    void unlock_shared(void) { mutex_.unlock_shared(); }
+};
+
+}
@@ -0,0 +1,126 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Thread-safe wrapper around a Persist-like type. Persist itself keeps
+// mutable state (the current block, sequence number and checksum engine),
+// so every call that reaches it holds the lock exclusively. Load is served
+// from a copy of the most recently loaded or saved value under a shared
+// lock, which lets readers run concurrently with the SharedLock policy; it
+// never touches the medium. LoadStored reads the medium through Persist.
+//
+// The wrapper assumes it is the only writer to the underlying memory.
+
+#pragma once
+
+#include <mutex>
+#include <shared_mutex>
+#include <utility>
+
+#include "persist/persist.h"
+#include "util/lock_policy.h"
+
+namespace demo
+{
+
+template <typename Persist, typename T, typename Lock = MutexLock>
+class LockedPersist
+{
+public:
+    template <typename... Args>
+    LockedPersist(Args&&... args) :
+        persist_{std::forward<Args>(args)...},
+        valid_(false)
+    {}
+
+    persist::Result Init(void)
+    {
+        std::unique_lock lock{lock_};
+        persist::Result result = persist_.Init();
+
+        if (result == persist::RESULT_SUCCESS)
+        {
+            valid_ = (persist_.Load(value_) == persist::RESULT_SUCCESS);
+        }
+
+        return result;
+    }
+
+    persist::Result Load(T& data)
+    {
+        std::shared_lock lock{lock_};
+
+        if (!valid_)
+        {
+            return persist::RESULT_FAIL_NO_DATA;
+        }
+
+        data = value_;
+        return persist::RESULT_SUCCESS;
+    }
+
+    // Reads the newest value from the medium and refreshes the cached copy.
+    persist::Result LoadStored(T& data)
+    {
+        std::unique_lock lock{lock_};
+        return Refresh(persist_.Load(data), data);
+    }
+
+    template <typename... Legacy>
+    persist::Result LoadLegacy(T& data)
+    {
+        std::unique_lock lock{lock_};
+        return Refresh(persist_.template LoadLegacy<Legacy...>(data), data);
+    }
+
+    persist::Result Save(const T& data)
+    {
+        std::unique_lock lock{lock_};
+        persist::Result result = persist_.Save(data);
+
+        if (result == persist::RESULT_SUCCESS)
+        {
+            value_ = data;
+            valid_ = true;
+        }
+
+        return result;
+    }
+
+protected:
+    Persist persist_;
+    Lock lock_;
+    T value_;
+    bool valid_;
+
+    persist::Result Refresh(persist::Result result, const T& data)
+    {
+        if (result == persist::RESULT_SUCCESS)
+        {
+            value_ = data;
+            valid_ = true;
+        }
+
+        return result;
+    }
+};
+
+}
@@ -0,0 +1,640 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Persist mirrored across two memories, e.g. two files on different disks
+// or two flash chips. Each save writes a generation-tagged record to both
+// banks. Load asks both banks at once and returns as soon as either produces
+// the newest generation, so one slow or failing bank does not stall reads.
+// A bank has at most one read outstanding; Loads that arrive while it is
+// busy wait on that read rather than queueing another, so a hung bank does
+// not accumulate jobs.
+// Init mounts both banks, and if one is behind, it is brought up to date in
+// the background.
+//
+// Each bank has its own worker thread, which is the only thread that
+// touches that bank's Persist. Init and Save return once one bank has
+// succeeded and the other has either answered too or missed a deadline, so
+// a hung bank delays them by at most that long. Save succeeds if at least
+// one bank accepted the write. A bank that failed or missed the deadline is
+// resynced in the background once it answers; until then it is not synced.
+// If a late bank turns out to hold a newer generation than Init mounted, its
+// value is adopted unless a Save has superseded it.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "persist/persist.h"
+
+namespace demo
+{
+
+namespace detail
+{
+
+// Runs jobs one at a time, in order, on a dedicated thread.
+class SerialWorker
+{
+public:
+    SerialWorker(void) :
+        busy_(false),
+        stop_(false),
+        thread_([this]() { Run(); })
+    {}
+
+    SerialWorker(const SerialWorker&) = delete;
+    SerialWorker& operator=(const SerialWorker&) = delete;
+
+    ~SerialWorker()
+    {
+        {
+            std::lock_guard lock{mutex_};
+            stop_ = true;
+        }
+
+        not_empty_.notify_all();
+        thread_.join();
+    }
+
+    void Post(std::function<void()> job)
+    {
+        {
+            std::lock_guard lock{mutex_};
+            jobs_.push_back(std::move(job));
+        }
+
+        not_empty_.notify_one();
+    }
+
+    // Waits until every job posted so far has finished.
+    void Drain(void)
+    {
+        std::unique_lock lock{mutex_};
+        idle_.wait(lock, [this]() { return jobs_.empty() && !busy_; });
+    }
+
+protected:
+    std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable idle_;
+    std::deque<std::function<void()>> jobs_;
+    bool busy_;
+    bool stop_;
+    std::thread thread_;
+
+    void Run(void)
+    {
+        std::unique_lock lock{mutex_};
+
+        for (;;)
+        {
+            not_empty_.wait(lock, [this]() { return stop_ || !jobs_.empty(); });
+
+            if (jobs_.empty())
+            {
+                return;
+            }
+
+            std::function<void()> job = std::move(jobs_.front());
+            jobs_.pop_front();
+            busy_ = true;
+            lock.unlock();
+            job();
+            lock.lock();
+            busy_ = false;
+
+            if (jobs_.empty())
+            {
+                idle_.notify_all();
+            }
+        }
+    }
+};
+
+}
+
+template <typename MemoryA, typename MemoryB, typename T,
+    uint8_t datatype_version>
+class MirroredPersist
+{
+public:
+    static constexpr uint32_t kNumBanks = 2;
+
+    struct Stats
+    {
+        uint64_t loads;
+        uint64_t reads[kNumBanks];      // Reads issued to each bank
+        uint64_t wins[kNumBanks];       // Loads answered by each bank
+        uint64_t save_failures[kNumBanks];
+        uint64_t resyncs;
+    };
+
+    // How long Init and Save wait for the second bank once the first has
+    // succeeded
+    static constexpr std::chrono::milliseconds kDefaultDeadline{100};
+
+    MirroredPersist(MemoryA& memory_a, MemoryB& memory_b,
+        std::chrono::milliseconds deadline = kDefaultDeadline) :
+        persist_a_{memory_a},
+        persist_b_{memory_b},
+        deadline_(deadline),
+        generation_(0),
+        valid_(false),
+        saved_(false),
+        stats_{},
+        bank_generation_{},
+        bank_valid_{},
+        reading_{},
+        writing_{},
+        resyncing_{}
+    {}
+
+    persist::Result Init(void)
+    {
+        std::lock_guard save_lock{save_mutex_};
+        auto round = std::make_shared<Round>();
+
+        ForEachBank([this, round](auto& persist, uint32_t bank)
+        {
+            Record record;
+            bool ok = persist.Init() == persist::RESULT_SUCCESS &&
+                persist.Load(record) == persist::RESULT_SUCCESS;
+
+            std::lock_guard lock{mutex_};
+            round->Answer(bank, ok, record);
+
+            if (round->committed)
+            {
+                Mounted(bank, ok, record);
+            }
+
+            settled_.notify_all();
+        });
+
+        std::unique_lock lock{mutex_};
+        Await(*round, lock);
+        valid_ = false;
+        saved_ = false;
+
+        for (uint32_t bank = 0; bank < kNumBanks; bank++)
+        {
+            bank_valid_[bank] = false;
+            bank_generation_[bank] = 0;
+        }
+
+        for (uint32_t bank = 0; bank < kNumBanks; bank++)
+        {
+            if (round->answered[bank])
+            {
+                Mounted(bank, round->ok[bank], round->records[bank]);
+            }
+        }
+
+        round->committed = true;
+        return persist::RESULT_SUCCESS;
+    }
+
+    // Returns the newest generation from whichever bank produces it first.
+    // If neither bank holds the newest generation, returns the newest one
+    // either bank holds.
+    persist::Result Load(T& data)
+    {
+        auto race = std::make_shared<Race>();
+
+        {
+            std::lock_guard lock{mutex_};
+            stats_.loads++;
+
+            if (!valid_)
+            {
+                return persist::RESULT_FAIL_NO_DATA;
+            }
+
+            race->target = generation_;
+
+            for (uint32_t bank = 0; bank < kNumBanks; bank++)
+            {
+                Read(bank, race);
+            }
+        }
+
+        std::unique_lock lock{race->mutex};
+        race->finished.wait(lock, [&]()
+        {
+            return race->done || !race->pending;
+        });
+
+        if (!race->found)
+        {
+            return persist::RESULT_FAIL_NO_DATA;
+        }
+
+        data = race->best.data;
+        uint32_t bank = race->bank;
+        lock.unlock();
+
+        std::lock_guard stats_lock{mutex_};
+        stats_.wins[bank]++;
+        return persist::RESULT_SUCCESS;
+    }
+
+    // Returns RESULT_FAIL_MEMORY if neither bank accepted the write.
+    persist::Result Save(const T& data)
+    {
+        std::lock_guard save_lock{save_mutex_};
+        auto round = std::make_shared<Round>();
+        Record record;
+
+        {
+            std::lock_guard lock{mutex_};
+            record = Record{generation_ + 1, data};
+
+            // A bank still busy with an earlier write is not handed another;
+            // it is resynced once that write finishes
+            for (uint32_t bank = 0; bank < kNumBanks; bank++)
+            {
+                if (writing_[bank])
+                {
+                    round->Answer(bank, false, record);
+                    round->skipped[bank] = true;
+                }
+                else
+                {
+                    writing_[bank] = true;
+                }
+            }
+        }
+
+        for (uint32_t bank = 0; bank < kNumBanks; bank++)
+        {
+            if (round->skipped[bank])
+            {
+                continue;
+            }
+
+            Post(bank, [this, round, record, bank](auto& persist)
+            {
+                bool ok = persist.Save(record) == persist::RESULT_SUCCESS;
+
+                std::lock_guard lock{mutex_};
+                writing_[bank] = false;
+                round->Answer(bank, ok, record);
+
+                if (round->committed)
+                {
+                    Saved(bank, ok, record.generation);
+                }
+
+                settled_.notify_all();
+            });
+        }
+
+        std::unique_lock lock{mutex_};
+        Await(*round, lock);
+
+        if (!round->Succeeded())
+        {
+            // The banks that did answer failed; those that did not are
+            // left to report into a round nobody waits for
+            for (uint32_t bank = 0; bank < kNumBanks; bank++)
+            {
+                if (round->answered[bank] && !round->skipped[bank])
+                {
+                    stats_.save_failures[bank]++;
+                }
+            }
+
+            return persist::RESULT_FAIL_MEMORY;
+        }
+
+        generation_ = record.generation;
+        latest_ = data;
+        valid_ = true;
+        saved_ = true;
+        round->committed = true;
+
+        for (uint32_t bank = 0; bank < kNumBanks; bank++)
+        {
+            if (round->skipped[bank])
+            {
+                Resync(bank);
+            }
+            else if (round->answered[bank])
+            {
+                Saved(bank, round->ok[bank], record.generation);
+            }
+        }
+
+        return persist::RESULT_SUCCESS;
+    }
+
+    // Waits for background resyncs and outstanding reads to finish.
+    void Drain(void)
+    {
+        worker_a_.Drain();
+        worker_b_.Drain();
+    }
+
+    // True if the bank holds the newest generation.
+    bool synced(uint32_t bank)
+    {
+        std::lock_guard lock{mutex_};
+        return bank_valid_[bank] && bank_generation_[bank] == generation_;
+    }
+
+    Stats stats(void)
+    {
+        std::lock_guard lock{mutex_};
+        return stats_;
+    }
+
+protected:
+    struct Record
+    {
+        uint32_t generation;
+        T data;
+    };
+
+    // One Init or Save across both banks. Guarded by mutex_.
+    struct Round
+    {
+        bool answered[kNumBanks] = {};
+        bool ok[kNumBanks] = {};
+        bool skipped[kNumBanks] = {};
+        Record records[kNumBanks];
+        // Once set, late answers are applied by the worker itself
+        bool committed = false;
+
+        void Answer(uint32_t bank, bool result, const Record& record)
+        {
+            answered[bank] = true;
+            ok[bank] = result;
+            records[bank] = record;
+        }
+
+        bool Succeeded(void) const
+        {
+            return std::any_of(ok, ok + kNumBanks, [](bool b) { return b; });
+        }
+
+        bool Finished(void) const
+        {
+            return std::all_of(answered, answered + kNumBanks,
+                [](bool b) { return b; });
+        }
+    };
+
+    struct Race
+    {
+        std::mutex mutex;
+        std::condition_variable finished;
+        uint32_t target = 0;
+        uint32_t pending = kNumBanks;
+        bool found = false;
+        bool done = false;
+        uint32_t bank = 0;
+        Record best;
+
+        // Takes one bank's answer.
+        void Offer(bool ok, const Record& record, uint32_t from)
+        {
+            std::lock_guard lock{mutex};
+
+            if (ok && !done && (!found || record.generation > best.generation))
+            {
+                best = record;
+                bank = from;
+                found = true;
+                done = (record.generation == target);
+            }
+
+            pending--;
+            finished.notify_all();
+        }
+    };
+
+    persist::Persist<MemoryA, Record, datatype_version> persist_a_;
+    persist::Persist<MemoryB, Record, datatype_version> persist_b_;
+
+    const std::chrono::milliseconds deadline_;
+
+    // Serializes Init and Save, which assign generations
+    std::mutex save_mutex_;
+
+    // Guards everything below
+    std::mutex mutex_;
+    std::condition_variable settled_;
+    uint32_t generation_;
+    T latest_;
+    bool valid_;
+    // Whether a Save has succeeded since Init
+    bool saved_;
+    Stats stats_;
+    uint32_t bank_generation_[kNumBanks];
+    bool bank_valid_[kNumBanks];
+    // Whether each bank has a read outstanding, and the Loads waiting on it
+    bool reading_[kNumBanks];
+    std::vector<std::weak_ptr<Race>> readers_[kNumBanks];
+    // Whether each bank has a Save outstanding
+    bool writing_[kNumBanks];
+    // Whether each bank has a resync queued and not yet started
+    bool resyncing_[kNumBanks];
+
+    // Declared last so the workers stop before the state they use goes away
+    detail::SerialWorker worker_a_;
+    detail::SerialWorker worker_b_;
+
+    template <typename Fn>
+    void ForEachBank(Fn fn)
+    {
+        worker_a_.Post([this, fn]() mutable { fn(persist_a_, 0); });
+        worker_b_.Post([this, fn]() mutable { fn(persist_b_, 1); });
+    }
+
+    // Waits until a bank succeeds or both have answered, then up to the
+    // deadline for the other bank.
+    void Await(const Round& round, std::unique_lock<std::mutex>& lock)
+    {
+        settled_.wait(lock, [&]()
+        {
+            return round.Succeeded() || round.Finished();
+        });
+
+        settled_.wait_for(lock, deadline_, [&]() { return round.Finished(); });
+    }
+
+    // Takes a bank's answer to Init. Called with mutex_ held.
+    void Mounted(uint32_t bank, bool ok, const Record& record)
+    {
+        bank_valid_[bank] = ok;
+        bank_generation_[bank] = ok ? record.generation : 0;
+
+        if (ok && (!valid_ || record.generation > generation_))
+        {
+            // A value saved since Init is newer whatever its generation,
+            // but generations must still only grow
+            if (!saved_)
+            {
+                latest_ = record.data;
+                valid_ = true;
+            }
+
+            generation_ = record.generation;
+        }
+
+        if (valid_)
+        {
+            for (uint32_t each = 0; each < kNumBanks; each++)
+            {
+                if (!bank_valid_[each] || bank_generation_[each] < generation_)
+                {
+                    Resync(each);
+                }
+            }
+        }
+    }
+
+    // Takes a bank's answer to Save. Called with mutex_ held.
+    void Saved(uint32_t bank, bool ok, uint32_t generation)
+    {
+        if (ok)
+        {
+            bank_valid_[bank] = true;
+            bank_generation_[bank] = generation;
+        }
+        else
+        {
+            stats_.save_failures[bank]++;
+        }
+
+        if (!ok || generation < generation_)
+        {
+            Resync(bank);
+        }
+    }
+
+    template <typename Job>
+    void Post(uint32_t bank, Job job)
+    {
+        if (bank == 0)
+        {
+            worker_a_.Post([this, job]() mutable { job(persist_a_); });
+        }
+        else
+        {
+            worker_b_.Post([this, job]() mutable { job(persist_b_); });
+        }
+    }
+
+    // Hands race the answer of the bank's next read, issuing one unless a
+    // read is already outstanding. Called with mutex_ held.
+    void Read(uint32_t bank, const std::shared_ptr<Race>& race)
+    {
+        // Loads that have returned no longer need an answer
+        auto& readers = readers_[bank];
+        readers.erase(std::remove_if(readers.begin(), readers.end(),
+            [](auto& reader) { return reader.expired(); }), readers.end());
+        readers.push_back(race);
+
+        if (reading_[bank])
+        {
+            return;
+        }
+
+        reading_[bank] = true;
+        stats_.reads[bank]++;
+
+        Post(bank, [this, bank](auto& persist)
+        {
+            Record record;
+            bool ok = persist.Load(record) == persist::RESULT_SUCCESS;
+            std::vector<std::weak_ptr<Race>> waiting;
+
+            {
+                std::lock_guard lock{mutex_};
+                waiting.swap(readers_[bank]);
+                reading_[bank] = false;
+            }
+
+            for (auto& reader : waiting)
+            {
+                if (auto race = reader.lock())
+                {
+                    race->Offer(ok, record, bank);
+                }
+            }
+        });
+    }
+
+    // Queues a write of the newest value to a bank that is behind, unless
+    // one is already queued. Called with mutex_ held.
+    void Resync(uint32_t bank)
+    {
+        if (resyncing_[bank])
+        {
+            return;
+        }
+
+        resyncing_[bank] = true;
+
+        auto job = [this, bank](auto& persist)
+        {
+            Record record;
+
+            {
+                std::lock_guard lock{mutex_};
+                resyncing_[bank] = false;
+
+                if (bank_valid_[bank] && bank_generation_[bank] == generation_)
+                {
+                    return;
+                }
+
+                record = Record{generation_, latest_};
+            }
+
+            bool ok = persist.Save(record) == persist::RESULT_SUCCESS;
+
+            std::lock_guard lock{mutex_};
+            stats_.resyncs++;
+
+            if (ok)
+            {
+                bank_valid_[bank] = true;
+                bank_generation_[bank] = record.generation;
+            }
+        };
+
+        Post(bank, job);
+    }
+};
+
+}
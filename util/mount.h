@@ -0,0 +1,212 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Startup helpers for services that mount many Persist instances.
+//
+// LazyPersist defers the Init scan until the first Load or Save, so that
+// instances which are never touched cost nothing at startup. MountAll and
+// MountRange run the Init scans of independent instances in parallel, so
+// startup is bounded by the largest partition rather than the sum of all of
+// them. Instances mounted in parallel must not share mutable state, though
+// they may share a Memory that is safe for concurrent access to disjoint
+// ranges, such as FileMemory.
+
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "persist/persist.h"
+#include "util/parallel_for.h"
+
+namespace demo
+{
+
+template <typename Persist, typename = void>
+struct HasMount : std::false_type {};
+
+template <typename Persist>
+struct HasMount<Persist,
+    std::void_t<decltype(std::declval<Persist&>().Mount())>> :
+    std::true_type {};
+
+// Not thread-safe; wrap in LockedPersist to share between threads.
+template <typename Persist, typename T>
+class LazyPersist
+{
+public:
+    template <typename... Args>
+    LazyPersist(Args&&... args) :
+        persist_{std::forward<Args>(args)...},
+        mounted_(false),
+        result_(persist::RESULT_SUCCESS)
+    {}
+
+    // Defers the scan until the instance is first used.
+    persist::Result Init(void)
+    {
+        mounted_ = false;
+        return persist::RESULT_SUCCESS;
+    }
+
+    // Performs the deferred scan now, if it has not happened yet.
+    persist::Result Mount(void)
+    {
+        if (!mounted_)
+        {
+            result_ = persist_.Init();
+            mounted_ = true;
+        }
+
+        return result_;
+    }
+
+    bool mounted(void) const
+    {
+        return mounted_;
+    }
+
+    persist::Result Load(T& data)
+    {
+        persist::Result result = Mount();
+        return (result == persist::RESULT_SUCCESS) ?
+            persist_.Load(data) : result;
+    }
+
+    template <typename... Legacy>
+    persist::Result LoadLegacy(T& data)
+    {
+        persist::Result result = Mount();
+        return (result == persist::RESULT_SUCCESS) ?
+            persist_.template LoadLegacy<Legacy...>(data) : result;
+    }
+
+    persist::Result Save(const T& data)
+    {
+        persist::Result result = Mount();
+        return (result == persist::RESULT_SUCCESS) ?
+            persist_.Save(data) : result;
+    }
+
+protected:
+    Persist persist_;
+    bool mounted_;
+    persist::Result result_;
+};
+
+namespace detail
+{
+
+template <typename Persist>
+persist::Result MountOne(Persist& persist)
+{
+    if constexpr (HasMount<Persist>::value)
+    {
+        return persist.Mount();
+    }
+    else
+    {
+        return persist.Init();
+    }
+}
+
+}
+
+// Mounts every instance in [first, last), which may hold Persist-like
+// objects or pointers to them. Returns RESULT_SUCCESS if all mounts succeed,
+// or else the result of the first failing instance in iteration order.
+template <typename Iterator>
+persist::Result MountRange(Iterator first, Iterator last,
+    uint32_t num_threads = 0)
+{
+    // One pass over the range, so that forward iterators cost O(n)
+    std::vector<Iterator> positions;
+
+    for (; first != last; ++first)
+    {
+        positions.push_back(first);
+    }
+
+    uint32_t count = positions.size();
+    std::vector<persist::Result> results(count, persist::RESULT_SUCCESS);
+
+    ParallelFor(count, num_threads, [&](uint32_t i)
+    {
+        auto& element = *positions[i];
+
+        if constexpr (std::is_pointer_v<std::decay_t<decltype(element)>>)
+        {
+            results[i] = detail::MountOne(*element);
+        }
+        else
+        {
+            results[i] = detail::MountOne(element);
+        }
+    });
+
+    for (auto result : results)
+    {
+        if (result != persist::RESULT_SUCCESS)
+        {
+            return result;
+        }
+    }
+
+    return persist::RESULT_SUCCESS;
+}
+
+template <typename... Persists>
+persist::Result MountAll(Persists&... persists)
+{
+    static_assert(sizeof...(Persists) > 0, "Nothing to mount");
+
+    using Mounter = persist::Result (*)(void*);
+    void* objects[] = {&persists...};
+    Mounter mounters[] = {
+        [](void* object)
+        {
+            return detail::MountOne(*static_cast<Persists*>(object));
+        }...
+    };
+
+    constexpr uint32_t kCount = sizeof...(Persists);
+    persist::Result results[kCount];
+
+    ParallelFor(kCount, 0, [&](uint32_t i)
+    {
+        results[i] = mounters[i](objects[i]);
+    });
+
+    for (auto result : results)
+    {
+        if (result != persist::RESULT_SUCCESS)
+        {
+            return result;
+        }
+    }
+
+    return persist::RESULT_SUCCESS;
+}
+
+}
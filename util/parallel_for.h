@@ -0,0 +1,214 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace demo
+{
+
+// Calls function(i) for every i in [0, count) on up to num_threads threads.
+// A num_threads of zero selects the number of hardware threads.
+template <typename Function>
+void ParallelFor(uint32_t count, uint32_t num_threads, Function function)
+{
+    if (num_threads == 0)
+    {
+        num_threads = std::thread::hardware_concurrency();
+    }
+
+    if (num_threads > count)
+    {
+        num_threads = count;
+    }
+
+    std::atomic<uint32_t> next{0};
+    auto worker = [&]()
+    {
+        for (uint32_t i = next++; i < count; i = next++)
+        {
+            function(i);
+        }
+    };
+
+    std::vector<std::thread> threads;
+
+    // The calling thread works too
+    for (uint32_t i = 1; i < num_threads; i++)
+    {
+        threads.emplace_back(worker);
+    }
+
+    worker();
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+// A fixed set of threads for ParallelFor loops, for callers that would
+// otherwise start threads on every call. The calling thread works too, so a
+// pool of n threads runs n + 1 iterations at once. One loop runs at a time;
+// a caller that finds the pool busy runs its loop alone.
+class WorkerPool
+{
+public:
+    explicit WorkerPool(uint32_t num_threads) :
+        job_(nullptr),
+        generation_(0),
+        active_(0),
+        stop_(false)
+    {
+        for (uint32_t i = 0; i < num_threads; i++)
+        {
+            threads_.emplace_back([this]() { Run(); });
+        }
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    ~WorkerPool()
+    {
+        {
+            std::lock_guard lock{mutex_};
+            stop_ = true;
+        }
+
+        start_.notify_all();
+
+        for (auto& thread : threads_)
+        {
+            thread.join();
+        }
+    }
+
+    // Calls function(i) for every i in [0, count).
+    template <typename Function>
+    void ParallelFor(uint32_t count, Function function)
+    {
+        std::unique_lock busy{busy_mutex_, std::try_to_lock};
+
+        if (!busy.owns_lock() || threads_.empty() || count < 2)
+        {
+            for (uint32_t i = 0; i < count; i++)
+            {
+                function(i);
+            }
+
+            return;
+        }
+
+        Job job;
+        job.call = &Call<Function>;
+        job.function = &function;
+        job.count = count;
+        job.next = 0;
+
+        {
+            std::lock_guard lock{mutex_};
+            job_ = &job;
+            generation_++;
+            active_ = threads_.size();
+        }
+
+        start_.notify_all();
+        Work(job);
+
+        std::unique_lock lock{mutex_};
+        done_.wait(lock, [this]() { return active_ == 0; });
+        job_ = nullptr;
+    }
+
+protected:
+    struct Job
+    {
+        void (*call)(void* function, uint32_t i);
+        void* function;
+        uint32_t count;
+        std::atomic<uint32_t> next;
+    };
+
+    // Held by the loop in progress
+    std::mutex busy_mutex_;
+
+    // Guards everything below
+    std::mutex mutex_;
+    std::condition_variable start_;
+    std::condition_variable done_;
+    Job* job_;
+    uint64_t generation_;
+    // Threads still working on the current job
+    uint32_t active_;
+    bool stop_;
+    std::vector<std::thread> threads_;
+
+    template <typename Function>
+    static void Call(void* function, uint32_t i)
+    {
+        (*static_cast<Function*>(function))(i);
+    }
+
+    static void Work(Job& job)
+    {
+        for (uint32_t i = job.next++; i < job.count; i = job.next++)
+        {
+            job.call(job.function, i);
+        }
+    }
+
+    void Run(void)
+    {
+        std::unique_lock lock{mutex_};
+        uint64_t seen = 0;
+
+        for (;;)
+        {
+            start_.wait(lock, [&]() { return stop_ || generation_ != seen; });
+
+            if (stop_)
+            {
+                return;
+            }
+
+            seen = generation_;
+            Job* job = job_;
+            lock.unlock();
+            Work(*job);
+            lock.lock();
+
+            if (--active_ == 0)
+            {
+                done_.notify_all();
+            }
+        }
+    }
+};
+
+}
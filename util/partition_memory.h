@@ -0,0 +1,129 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Presents the range [offset, offset + size) of a Memory as a Memory of its
+// own, so that several Persist instances or other users can share one
+// device. The range must be aligned to the erase granularity so that erasing
+// one partition never disturbs another.
+
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <type_traits>
+
+#include "util/scatter_gather.h"
+
+namespace demo
+{
+
+template <typename Memory, uint32_t size>
+class PartitionMemory
+{
+public:
+    static constexpr uint32_t kSize = size;
+    static constexpr uint32_t kEraseGranularity = Memory::kEraseGranularity;
+    static constexpr uint32_t kWriteGranularity = Memory::kWriteGranularity;
+    static constexpr uint8_t kFillByte = Memory::kFillByte;
+
+    static_assert(kSize <= Memory::kSize);
+
+    PartitionMemory(Memory& memory, uint32_t offset) :
+        memory_(memory),
+        offset_(offset)
+    {
+        assert(offset % kEraseGranularity == 0);
+        assert(offset + kSize <= Memory::kSize);
+        assert((offset + kSize) % kEraseGranularity == 0 ||
+            offset + kSize == Memory::kSize);
+    }
+
+    uint32_t offset(void) const
+    {
+        return offset_;
+    }
+
+    bool Read(void* dst, uint32_t location, uint32_t length)
+    {
+        return Contains(location, length) &&
+            memory_.Read(dst, offset_ + location, length);
+    }
+
+    bool Writable(uint32_t location, uint32_t length)
+    {
+        return Contains(location, length) &&
+            memory_.Writable(offset_ + location, length);
+    }
+
+    bool Write(uint32_t location, const void* src, uint32_t length)
+    {
+        return Contains(location, length) &&
+            memory_.Write(offset_ + location, src, length);
+    }
+
+    bool Erase(uint32_t location, uint32_t length)
+    {
+        return Contains(location, length) &&
+            memory_.Erase(offset_ + location, length);
+    }
+
+    template <typename M = Memory,
+        typename = std::enable_if_t<HasReadV<M>::value>>
+    bool ReadV(const Segment* dst, uint32_t count, uint32_t location)
+    {
+        uint32_t length = 0;
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            length += dst[i].size;
+        }
+
+        return Contains(location, length) &&
+            memory_.ReadV(dst, count, offset_ + location);
+    }
+
+    template <typename M = Memory,
+        typename = std::enable_if_t<HasWriteV<M>::value>>
+    bool WriteV(uint32_t location, const ConstSegment* src, uint32_t count)
+    {
+        uint32_t length = 0;
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            length += src[i].size;
+        }
+
+        return Contains(location, length) &&
+            memory_.WriteV(offset_ + location, src, count);
+    }
+
+protected:
+    Memory& memory_;
+    uint32_t offset_;
+
+    static bool Contains(uint32_t location, uint32_t length)
+    {
+        return location <= kSize && length <= kSize - location;
+    }
+};
+
+}
@@ -0,0 +1,215 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Monotonic counter that increments without erasing. Increments are recorded
+// in a tally region by clearing one bit each (thermometer encoding), which
+// NOR-style memories allow without an erase. When the tally fills up, its
+// count is folded into a checksummed base value stored with Persist, and
+// counting continues in a second, pre-erased tally region.
+//
+// Memory layout:
+//     [0, tally_size)                 tally region 0
+//     [tally_size, 2 * tally_size)    tally region 1
+//     [2 * tally_size, kSize)         Persist region for the base value
+//
+// The Memory must start out erased and must permit programming a write
+// granule that already holds data, as long as bits are only cleared.
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include "persist/persist.h"
+#include "util/layout.h"
+#include "util/partition_memory.h"
+
+namespace demo
+{
+
+template <typename Memory, uint32_t tally_size>
+class PersistCounter
+{
+public:
+    static constexpr uint32_t kTallySize = tally_size;
+    static constexpr uint32_t kTallyBits = kTallySize * 8;
+    static constexpr uint32_t kBaseOffset = 2 * kTallySize;
+
+    static_assert(Memory::kFillByte == 0xFF,
+        "Increments clear bits, so the erased state must be all ones");
+    static_assert(kTallySize % Memory::kEraseGranularity == 0);
+    static_assert(kTallySize % Memory::kWriteGranularity == 0);
+    static_assert(kBaseOffset < Memory::kSize);
+
+    PersistCounter(Memory& memory) :
+        memory_(memory),
+        base_memory_(memory, kBaseOffset),
+        persist_{base_memory_},
+        base_{0, 0},
+        tally_(0)
+    {}
+
+    persist::Result Init(void)
+    {
+        persist::Result result = persist_.Init();
+
+        if (result != persist::RESULT_SUCCESS)
+        {
+            return result;
+        }
+
+        if (persist_.Load(base_) != persist::RESULT_SUCCESS)
+        {
+            base_ = Base{0, 0};
+        }
+
+        if (!CountTally(base_.active, tally_))
+        {
+            return persist::RESULT_FAIL_NO_DATA;
+        }
+
+        return persist::RESULT_SUCCESS;
+    }
+
+    uint32_t Value(void) const
+    {
+        return base_.value + tally_;
+    }
+
+    bool Increment(void)
+    {
+        if (tally_ == kTallyBits && !Fold())
+        {
+            return false;
+        }
+
+        uint32_t byte = tally_ / 8;
+        uint32_t granule = layout::RoundDown<Memory::kWriteGranularity>(byte);
+
+        // Bytes before the current one are fully cleared and bytes after it
+        // are still erased
+        uint8_t buffer[Memory::kWriteGranularity];
+
+        for (uint32_t i = 0; i < Memory::kWriteGranularity; i++)
+        {
+            uint32_t index = granule + i;
+
+            if (index < byte)
+            {
+                buffer[i] = 0x00;
+            }
+            else if (index == byte)
+            {
+                buffer[i] = 0xFF << (tally_ % 8 + 1);
+            }
+            else
+            {
+                buffer[i] = 0xFF;
+            }
+        }
+
+        if (!memory_.Write(TallyOffset(base_.active) + granule, buffer,
+            Memory::kWriteGranularity))
+        {
+            return false;
+        }
+
+        tally_++;
+        return true;
+    }
+
+    // Folds the tally into the base value. Happens automatically when the
+    // tally is full, but may be called earlier at a convenient time.
+    bool Fold(void)
+    {
+        uint8_t next = base_.active ^ 1;
+        uint32_t location = TallyOffset(next);
+
+        // The other tally has not been used since the previous fold, so it is
+        // either already blank or holds stale increments
+        if (!memory_.Writable(location, kTallySize) &&
+            !memory_.Erase(location, kTallySize))
+        {
+            return false;
+        }
+
+        Base base{base_.value + tally_, next};
+
+        if (persist_.Save(base) != persist::RESULT_SUCCESS)
+        {
+            return false;
+        }
+
+        base_ = base;
+        tally_ = 0;
+        return true;
+    }
+
+protected:
+    struct Base
+    {
+        uint32_t value;
+        uint8_t active;
+    };
+
+    using BaseMemory = PartitionMemory<Memory, Memory::kSize - kBaseOffset>;
+
+    Memory& memory_;
+    BaseMemory base_memory_;
+    persist::Persist<BaseMemory, Base, 0> persist_;
+    Base base_;
+    uint32_t tally_;
+
+    static uint32_t TallyOffset(uint8_t index)
+    {
+        return index ? kTallySize : 0;
+    }
+
+    bool CountTally(uint8_t index, uint32_t& count)
+    {
+        uint8_t buffer[kChunkSize];
+        uint32_t location = TallyOffset(index);
+        count = 0;
+
+        for (uint32_t i = 0; i < kTallySize; i += kChunkSize)
+        {
+            uint32_t length = (kTallySize - i < kChunkSize) ?
+                (kTallySize - i) : kChunkSize;
+
+            if (!memory_.Read(buffer, location + i, length))
+            {
+                return false;
+            }
+
+            for (uint32_t j = 0; j < length; j++)
+            {
+                count += __builtin_popcount(uint8_t(~buffer[j]));
+            }
+        }
+
+        return true;
+    }
+
+    static constexpr uint32_t kChunkSize = 64;
+};
+
+}
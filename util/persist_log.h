@@ -0,0 +1,596 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Append-only log of checksummed records, for event and audit trails that
+// Persist, which keeps only the latest value, handles poorly.
+//
+// The memory is a ring of units, each one or more erase units long. A unit
+// starts with a header holding a magic number and a sequence number that
+// grows by one for every unit opened, followed by frames:
+//
+//     unit    [magic:4][sequence:4][crc:2][fill to write granule]
+//             frame frame ... [fill]
+//     frame   [length:2][crc:2] entry entry ... [fill to write granule]
+//     entry   [size:2][payload:size]
+//
+// A frame is one batch of appends, written with a single Write starting on
+// a write granule; its CRC-16 covers the length and every entry, so a frame
+// torn by power loss is ignored. Append writes one frame per call and
+// AppendBatch packs many entries into each frame. When the newest unit is
+// full, the next unit in the ring is opened. If it still holds the oldest
+// records, they are reclaimed by erasing it, so erases rotate evenly over
+// the whole memory.
+//
+// Init scans the memory once and indexes every entry, after which the log
+// can be walked forward or backward without scanning again.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iterator>
+#include <type_traits>
+#include <vector>
+
+#include "persist/inc/crc16.h"
+#include "util/layout.h"
+#include "util/scatter_gather.h"
+
+namespace demo
+{
+
+template <typename Memory, uint32_t unit_size = Memory::kEraseGranularity>
+class BasicPersistLog
+{
+public:
+    static constexpr uint32_t kUnitSize = unit_size;
+    static constexpr uint32_t kNumUnits = Memory::kSize / kUnitSize;
+    static constexpr uint32_t kGranule = Memory::kWriteGranularity;
+    static constexpr uint32_t kMagic = 0x474F4C50; // "PLOG"
+    static constexpr uint32_t kUnitHeaderSize = 10;
+    static constexpr uint32_t kFrameHeaderSize = 4;
+    static constexpr uint32_t kEntryHeaderSize = 2;
+
+    // The ring as BlockLayout sees it: a unit is erased as a whole
+    struct UnitGeometry
+    {
+        static constexpr uint32_t kSize = Memory::kSize;
+        static constexpr uint32_t kEraseGranularity = kUnitSize;
+        static constexpr uint32_t kWriteGranularity = kGranule;
+    };
+
+    // Appending entries of entry_size one at a time, one frame each
+    template <uint32_t entry_size>
+    using AppendLayout = BlockLayout<UnitGeometry,
+        kFrameHeaderSize + kEntryHeaderSize, entry_size,
+        LAYOUT_PACKED | LAYOUT_ALIGNED, kUnitHeaderSize>;
+    template <uint32_t entry_size>
+    static constexpr LayoutReport kLayout = AppendLayout<entry_size>::kLayout;
+
+    static constexpr uint32_t kDataOffset = AppendLayout<1>::kUnitDataOffset;
+    // Largest payload a single entry can carry
+    static constexpr uint32_t kMaxEntrySize = std::min<uint32_t>(
+        AppendLayout<1>::kMaxPayload, 0xFFFE - kEntryHeaderSize);
+    static constexpr uint32_t kMaxFrameLength =
+        kMaxEntrySize + kEntryHeaderSize;
+
+    static_assert(kUnitSize % Memory::kEraseGranularity == 0);
+    static_assert(kUnitSize % kGranule == 0);
+    static_assert(Memory::kSize % kUnitSize == 0);
+    static_assert(kNumUnits >= 2, "The ring needs at least two units");
+    static_assert(kMaxEntrySize > 0, "Units are too small to hold an entry");
+
+    struct Entry
+    {
+        uint32_t location;  // Of the payload
+        uint16_t size;
+    };
+
+    BasicPersistLog(Memory& memory) :
+        memory_(memory),
+        position_(kUnitSize),
+        sequence_(0)
+    {
+        crc_.Init();
+    }
+
+    // Scans the memory and indexes every valid entry. Returns false if the
+    // memory cannot be read.
+    bool Init(void)
+    {
+        units_.clear();
+        entries_.clear();
+        position_ = kUnitSize;
+        sequence_ = 0;
+
+        for (uint32_t unit = 0; unit < kNumUnits; unit++)
+        {
+            uint32_t sequence;
+
+            if (ReadUnitHeader(unit, sequence))
+            {
+                units_.push_back(Unit{unit, sequence, 0});
+            }
+        }
+
+        std::sort(units_.begin(), units_.end(), [](auto& a, auto& b)
+        {
+            return a.sequence < b.sequence;
+        });
+
+        for (auto& unit : units_)
+        {
+            uint32_t end;
+
+            if (!ScanUnit(unit, end))
+            {
+                return false;
+            }
+
+            // Anything after the last valid frame of the newest unit must
+            // be blank, or appends move on to a fresh unit
+            if (&unit == &units_.back())
+            {
+                uint32_t base = unit.index * kUnitSize;
+                bool blank = (end == kUnitSize) ||
+                    memory_.Writable(base + end, kUnitSize - end);
+                position_ = blank ? end : kUnitSize;
+                sequence_ = unit.sequence;
+            }
+        }
+
+        return true;
+    }
+
+    // Appends one entry with a single write.
+    bool Append(const void* data, uint32_t size)
+    {
+        ConstSegment entry{data, size};
+        return AppendBatch(&entry, 1);
+    }
+
+    // Appends entries in order, packing as many as fit into each frame.
+    bool AppendBatch(const ConstSegment* entries, uint32_t count)
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            if (entries[i].size == 0 || entries[i].size > kMaxEntrySize)
+            {
+                return false;
+            }
+        }
+
+        while (count)
+        {
+            if (position_ + kFrameHeaderSize + kEntryHeaderSize +
+                entries[0].size > kUnitSize && !OpenNextUnit())
+            {
+                return false;
+            }
+
+            // Fill the frame up to the space left in the unit
+            uint32_t space = std::min(kUnitSize - position_ - kFrameHeaderSize,
+                kMaxFrameLength);
+            uint32_t length = 0;
+            uint32_t num = 0;
+
+            while (num < count &&
+                length + kEntryHeaderSize + entries[num].size <= space)
+            {
+                length += kEntryHeaderSize + entries[num].size;
+                num++;
+            }
+
+            if (!WriteFrame(entries, num, length))
+            {
+                return false;
+            }
+
+            entries += num;
+            count -= num;
+        }
+
+        return true;
+    }
+
+    // Erases the oldest unit and forgets its entries.
+    bool ReclaimOldest(void)
+    {
+        if (units_.empty())
+        {
+            return false;
+        }
+
+        Unit oldest = units_.front();
+
+        if (!memory_.Erase(oldest.index * kUnitSize, kUnitSize))
+        {
+            return false;
+        }
+
+        Forget(oldest);
+
+        if (units_.empty())
+        {
+            position_ = kUnitSize;
+        }
+
+        return true;
+    }
+
+    uint32_t size(void) const
+    {
+        return entries_.size();
+    }
+
+    bool empty(void) const
+    {
+        return entries_.empty();
+    }
+
+    const Entry& entry(uint32_t index) const
+    {
+        return entries_[index];
+    }
+
+    // Reads the payload of an entry; dst must hold entry.size bytes.
+    bool Read(const Entry& entry, void* dst) const
+    {
+        return memory_.Read(dst, entry.location, entry.size);
+    }
+
+protected:
+    struct Unit
+    {
+        uint32_t index;
+        uint32_t sequence;
+        uint32_t entries;
+    };
+
+    Memory& memory_;
+    persist::Crc16 crc_;
+    std::deque<Unit> units_;        // Oldest first
+    std::deque<Entry> entries_;     // Oldest first
+    std::vector<uint8_t> buffer_;
+    uint32_t position_;             // Next free offset in the newest unit
+    uint32_t sequence_;             // Of the newest unit
+
+    uint16_t Checksum(const uint8_t* data, uint32_t length)
+    {
+        crc_.Seed(0xFFFF);
+        return crc_.Process(data, length);
+    }
+
+    bool ReadUnitHeader(uint32_t unit, uint32_t& sequence)
+    {
+        uint8_t header[kUnitHeaderSize];
+        uint32_t magic;
+        uint16_t crc;
+
+        if (!memory_.Read(header, unit * kUnitSize, kUnitHeaderSize))
+        {
+            return false;
+        }
+
+        std::memcpy(&magic, header, 4);
+        std::memcpy(&sequence, header + 4, 4);
+        std::memcpy(&crc, header + 8, 2);
+        return magic == kMagic && crc == Checksum(header, 8);
+    }
+
+    // Indexes the valid frames of a unit. end is set to the offset after
+    // the last valid frame.
+    bool ScanUnit(Unit& unit, uint32_t& end)
+    {
+        uint32_t base = unit.index * kUnitSize;
+        end = kDataOffset;
+
+        while (end + kFrameHeaderSize + kEntryHeaderSize < kUnitSize)
+        {
+            uint8_t header[kFrameHeaderSize];
+            uint16_t length;
+            uint16_t crc;
+
+            if (!memory_.Read(header, base + end, kFrameHeaderSize))
+            {
+                return false;
+            }
+
+            std::memcpy(&length, header, 2);
+            std::memcpy(&crc, header + 2, 2);
+
+            if (length < kEntryHeaderSize + 1 || length > kMaxFrameLength)
+            {
+                break;
+            }
+
+            buffer_.resize(kFrameHeaderSize + length);
+            std::memcpy(buffer_.data(), header, kFrameHeaderSize);
+
+            if (!memory_.Read(buffer_.data() + kFrameHeaderSize,
+                base + end + kFrameHeaderSize, length))
+            {
+                return false;
+            }
+
+            std::memset(buffer_.data() + 2, 0, 2);
+
+            if (crc != Checksum(buffer_.data(), buffer_.size()))
+            {
+                break;
+            }
+
+            uint32_t offset = kFrameHeaderSize;
+
+            while (offset < kFrameHeaderSize + length)
+            {
+                uint16_t size;
+                std::memcpy(&size, buffer_.data() + offset, 2);
+                entries_.push_back(Entry{base + end + offset +
+                    kEntryHeaderSize, size});
+                unit.entries++;
+                offset += kEntryHeaderSize + size;
+            }
+
+            end = layout::RoundUp<kGranule>(end + kFrameHeaderSize + length);
+        }
+
+        end = std::min(end, kUnitSize);
+        return true;
+    }
+
+    bool WriteFrame(const ConstSegment* entries, uint32_t count,
+        uint32_t length)
+    {
+        uint32_t total = layout::RoundUp<kGranule>(kFrameHeaderSize + length);
+        buffer_.assign(total, Memory::kFillByte);
+        uint8_t* out = buffer_.data();
+        uint16_t frame_length = length;
+        std::memcpy(out, &frame_length, 2);
+        std::memset(out + 2, 0, 2);
+
+        uint32_t offset = kFrameHeaderSize;
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            uint16_t size = entries[i].size;
+            std::memcpy(out + offset, &size, 2);
+            std::memcpy(out + offset + 2, entries[i].data, size);
+            offset += kEntryHeaderSize + size;
+        }
+
+        uint16_t crc = Checksum(out, kFrameHeaderSize + length);
+        std::memcpy(out + 2, &crc, 2);
+
+        uint32_t base = units_.back().index * kUnitSize;
+
+        if (!memory_.Write(base + position_, out, total))
+        {
+            // The frame may be partly written; start afresh in a new unit
+            position_ = kUnitSize;
+            return false;
+        }
+
+        offset = kFrameHeaderSize;
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            entries_.push_back(Entry{base + position_ + offset +
+                kEntryHeaderSize, uint16_t(entries[i].size)});
+            offset += kEntryHeaderSize + entries[i].size;
+        }
+
+        units_.back().entries += count;
+        position_ += total;
+        return true;
+    }
+
+    bool OpenNextUnit(void)
+    {
+        uint32_t next = units_.empty() ? 0 :
+            (units_.back().index + 1) % kNumUnits;
+
+        // Reclaim the oldest unit when the ring has wrapped around to it
+        for (auto& unit : units_)
+        {
+            if (unit.index == next)
+            {
+                Forget(unit);
+                break;
+            }
+        }
+
+        uint32_t base = next * kUnitSize;
+
+        if (!memory_.Writable(base, kUnitSize) &&
+            !memory_.Erase(base, kUnitSize))
+        {
+            return false;
+        }
+
+        uint8_t header[kDataOffset];
+        uint32_t magic = kMagic;
+        uint32_t sequence = sequence_ + 1;
+        std::memset(header, Memory::kFillByte, kDataOffset);
+        std::memcpy(header, &magic, 4);
+        std::memcpy(header + 4, &sequence, 4);
+        uint16_t crc = Checksum(header, 8);
+        std::memcpy(header + 8, &crc, 2);
+
+        if (!memory_.Write(base, header, kDataOffset))
+        {
+            return false;
+        }
+
+        units_.push_back(Unit{next, sequence, 0});
+        sequence_ = sequence;
+        position_ = kDataOffset;
+        return true;
+    }
+
+    // Drops the entries of a unit, which must be the oldest.
+    void Forget(const Unit& unit)
+    {
+        entries_.erase(entries_.begin(), entries_.begin() + unit.entries);
+        units_.pop_front();
+    }
+};
+
+template <typename Memory, typename Record,
+    uint32_t unit_size = Memory::kEraseGranularity>
+class PersistLog : public BasicPersistLog<Memory, unit_size>
+{
+public:
+    using Base = BasicPersistLog<Memory, unit_size>;
+
+    static_assert(std::is_trivially_copyable_v<Record>);
+    static_assert(sizeof(Record) <= Base::kMaxEntrySize);
+
+    class const_iterator
+    {
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = Record;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Record*;
+        using reference = Record;
+
+        const_iterator(void) = default;
+
+        const_iterator(const PersistLog* log, uint32_t index) :
+            log_(log),
+            index_(index)
+        {}
+
+        // Reads the record from memory; an unreadable record reads as
+        // value-initialized.
+        Record operator*(void) const
+        {
+            Record record{};
+            log_->Read(log_->entry(index_), &record);
+            return record;
+        }
+
+        const_iterator& operator++(void)
+        {
+            index_++;
+            return *this;
+        }
+
+        const_iterator operator++(int)
+        {
+            const_iterator previous = *this;
+            index_++;
+            return previous;
+        }
+
+        const_iterator& operator--(void)
+        {
+            index_--;
+            return *this;
+        }
+
+        const_iterator operator--(int)
+        {
+            const_iterator previous = *this;
+            index_--;
+            return previous;
+        }
+
+        bool operator==(const const_iterator& other) const
+        {
+            return index_ == other.index_;
+        }
+
+        bool operator!=(const const_iterator& other) const
+        {
+            return index_ != other.index_;
+        }
+
+    protected:
+        const PersistLog* log_ = nullptr;
+        uint32_t index_ = 0;
+    };
+
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    using Base::Base;
+    using Base::Append;
+
+    bool Append(const Record& record)
+    {
+        return Base::Append(&record, sizeof(Record));
+    }
+
+    bool Append(const Record* records, uint32_t count)
+    {
+        ConstSegment segments[kSegments];
+
+        while (count)
+        {
+            uint32_t num = std::min(count, kSegments);
+
+            for (uint32_t i = 0; i < num; i++)
+            {
+                segments[i] = ConstSegment{&records[i], sizeof(Record)};
+            }
+
+            if (!Base::AppendBatch(segments, num))
+            {
+                return false;
+            }
+
+            records += num;
+            count -= num;
+        }
+
+        return true;
+    }
+
+    const_iterator begin(void) const
+    {
+        return const_iterator{this, 0};
+    }
+
+    const_iterator end(void) const
+    {
+        return const_iterator{this, Base::size()};
+    }
+
+    const_reverse_iterator rbegin(void) const
+    {
+        return const_reverse_iterator{end()};
+    }
+
+    const_reverse_iterator rend(void) const
+    {
+        return const_reverse_iterator{begin()};
+    }
+
+protected:
+    static constexpr uint32_t kSegments = 64;
+};
+
+}
@@ -0,0 +1,184 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// USDT probes around Persist, its Memory and Crc16, which live outside this
+// tree. ProbedPersist wraps a Persist-like type and fires persist_<op>_entry
+// and persist_<op>_return for Init, Load, LoadLegacy and Save. The arguments
+// are the number of saves made through the wrapper and the payload size,
+// plus the result code on return. Persist's own sequence numbers are not
+// visible from outside; the block offsets it touches are, through the
+// memory_<op> probes of a ProbedMemory placed under it (FileMemory fires
+// equivalent file_<op> probes itself).
+//
+// ProbedCrc16 fires crc_process_entry and crc_process_return with the byte
+// count for CRC work done through it, such as ElidingPersist's fingerprints.
+// Persist computes its block CRCs with its own persist::Crc16, which cannot
+// be probed from here; that time shows up inside a Persist call, between its
+// memory probes.
+//
+// See util/probes.h for how to enable the probes.
+
+#pragma once
+
+#include <cstdint>
+#include <utility>
+
+#include "persist/inc/crc16.h"
+#include "persist/persist.h"
+#include "util/probes.h"
+
+namespace demo
+{
+
+// Wraps rather than derives from Crc16, so it cannot be passed where a
+// Crc16 is expected and silently lose its probes.
+class ProbedCrc16
+{
+public:
+    void Init(void)
+    {
+        crc_.Init();
+    }
+
+    void Seed(uint16_t seed)
+    {
+        crc_.Seed(seed);
+    }
+
+    uint16_t Process(const void* data, uint32_t length)
+    {
+        DEMO_PROBE1(crc_process_entry, length);
+        uint16_t crc = crc_.Process(data, length);
+        DEMO_PROBE2(crc_process_return, length, crc);
+        return crc;
+    }
+
+protected:
+    persist::Crc16 crc_;
+};
+
+template <typename Memory>
+class ProbedMemory
+{
+public:
+    static constexpr uint32_t kSize = Memory::kSize;
+    static constexpr uint32_t kEraseGranularity = Memory::kEraseGranularity;
+    static constexpr uint32_t kWriteGranularity = Memory::kWriteGranularity;
+    static constexpr uint8_t kFillByte = Memory::kFillByte;
+
+    ProbedMemory(Memory& memory) :
+        memory_(memory)
+    {}
+
+    bool Read(void* dst, uint32_t location, uint32_t length)
+    {
+        DEMO_PROBE2(memory_read_entry, location, length);
+        bool result = memory_.Read(dst, location, length);
+        DEMO_PROBE3(memory_read_return, location, length, result);
+        return result;
+    }
+
+    bool Writable(uint32_t location, uint32_t length)
+    {
+        DEMO_PROBE2(memory_writable_entry, location, length);
+        bool result = memory_.Writable(location, length);
+        DEMO_PROBE3(memory_writable_return, location, length, result);
+        return result;
+    }
+
+    bool Write(uint32_t location, const void* src, uint32_t length)
+    {
+        DEMO_PROBE2(memory_write_entry, location, length);
+        bool result = memory_.Write(location, src, length);
+        DEMO_PROBE3(memory_write_return, location, length, result);
+        return result;
+    }
+
+    bool Erase(uint32_t location, uint32_t length)
+    {
+        DEMO_PROBE2(memory_erase_entry, location, length);
+        bool result = memory_.Erase(location, length);
+        DEMO_PROBE3(memory_erase_return, location, length, result);
+        return result;
+    }
+
+protected:
+    Memory& memory_;
+};
+
+template <typename Persist, typename T>
+class ProbedPersist
+{
+public:
+    template <typename... Args>
+    ProbedPersist(Args&&... args) :
+        persist_{std::forward<Args>(args)...},
+        saves_(0)
+    {}
+
+    persist::Result Init(void)
+    {
+        DEMO_PROBE2(persist_init_entry, saves_, sizeof(T));
+        persist::Result result = persist_.Init();
+        DEMO_PROBE3(persist_init_return, saves_, sizeof(T), int(result));
+        return result;
+    }
+
+    persist::Result Load(T& data)
+    {
+        DEMO_PROBE2(persist_load_entry, saves_, sizeof(T));
+        persist::Result result = persist_.Load(data);
+        DEMO_PROBE3(persist_load_return, saves_, sizeof(T), int(result));
+        return result;
+    }
+
+    template <typename... Legacy>
+    persist::Result LoadLegacy(T& data)
+    {
+        DEMO_PROBE2(persist_load_legacy_entry, saves_, sizeof(T));
+        persist::Result result = persist_.template LoadLegacy<Legacy...>(data);
+        DEMO_PROBE3(persist_load_legacy_return, saves_, sizeof(T),
+            int(result));
+        return result;
+    }
+
+    persist::Result Save(const T& data)
+    {
+        DEMO_PROBE2(persist_save_entry, saves_, sizeof(T));
+        persist::Result result = persist_.Save(data);
+        saves_ += (result == persist::RESULT_SUCCESS);
+        DEMO_PROBE3(persist_save_return, saves_, sizeof(T), int(result));
+        return result;
+    }
+
+    // Successful saves made through this wrapper.
+    uint32_t saves(void) const
+    {
+        return saves_;
+    }
+
+protected:
+    Persist persist_;
+    uint32_t saves_;
+};
+
+}
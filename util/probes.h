@@ -0,0 +1,57 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Static tracepoints (USDT probes) for eBPF and SystemTap. Probes are
+// compiled in only when PERSIST_DEMO_USDT is defined, e.g. by building with
+// "make USDT=1", and <sys/sdt.h> is available. Otherwise the macros expand
+// to nothing and their arguments are not evaluated, so they cost nothing.
+//
+// Every probe belongs to the persist_demo provider. Operations have an
+// <op>_entry probe and an <op>_return probe whose last argument is the
+// result. For example, with bpftrace:
+//
+//     bpftrace -e 'usdt:./build/artifact/test:persist_demo:file_write_return
+//         { @bytes = hist(arg1); }'
+
+#pragma once
+
+#if defined(PERSIST_DEMO_USDT) && __has_include(<sys/sdt.h>)
+
+#include <sys/sdt.h>
+
+#define DEMO_PROBE0(name) DTRACE_PROBE(persist_demo, name)
+#define DEMO_PROBE1(name, a) DTRACE_PROBE1(persist_demo, name, a)
+#define DEMO_PROBE2(name, a, b) DTRACE_PROBE2(persist_demo, name, a, b)
+#define DEMO_PROBE3(name, a, b, c) DTRACE_PROBE3(persist_demo, name, a, b, c)
+
+#else
+
+#if defined(PERSIST_DEMO_USDT)
+#warning "PERSIST_DEMO_USDT is set but <sys/sdt.h> is missing; probes disabled"
+#endif
+
+#define DEMO_PROBE0(name) ((void)0)
+#define DEMO_PROBE1(name, a) ((void)0)
+#define DEMO_PROBE2(name, a, b) ((void)0)
+#define DEMO_PROBE3(name, a, b, c) ((void)0)
+
+#endif
@@ -0,0 +1,119 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Optional scatter-gather extension to the Memory concept. A Memory may
+// provide these in addition to Read and Write:
+//
+//     bool ReadV(const Segment* dst, uint32_t count, uint32_t location);
+//     bool WriteV(uint32_t location, const ConstSegment* src, uint32_t count);
+//
+// Each transfers one contiguous range of the memory starting at location,
+// split across count buffers in order. The free functions ReadV and WriteV
+// below detect the methods at compile time and fall back to one Read or Write
+// per segment when a Memory does not provide them.
+
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+namespace demo
+{
+
+struct Segment
+{
+    void* data;
+    uint32_t size;
+};
+
+struct ConstSegment
+{
+    const void* data;
+    uint32_t size;
+};
+
+template <typename Memory, typename = void>
+struct HasReadV : std::false_type {};
+
+template <typename Memory>
+struct HasReadV<Memory, std::void_t<decltype(std::declval<Memory&>().ReadV(
+    std::declval<const Segment*>(), uint32_t{}, uint32_t{}))>> :
+    std::true_type {};
+
+template <typename Memory, typename = void>
+struct HasWriteV : std::false_type {};
+
+template <typename Memory>
+struct HasWriteV<Memory, std::void_t<decltype(std::declval<Memory&>().WriteV(
+    uint32_t{}, std::declval<const ConstSegment*>(), uint32_t{}))>> :
+    std::true_type {};
+
+template <typename Memory>
+bool ReadV(Memory& memory, const Segment* dst, uint32_t count,
+    uint32_t location)
+{
+    if constexpr (HasReadV<Memory>::value)
+    {
+        return memory.ReadV(dst, count, location);
+    }
+    else
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            if (!memory.Read(dst[i].data, location, dst[i].size))
+            {
+                return false;
+            }
+
+            location += dst[i].size;
+        }
+
+        return true;
+    }
+}
+
+template <typename Memory>
+bool WriteV(Memory& memory, uint32_t location, const ConstSegment* src,
+    uint32_t count)
+{
+    if constexpr (HasWriteV<Memory>::value)
+    {
+        return memory.WriteV(location, src, count);
+    }
+    else
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            if (!memory.Write(location, src[i].data, src[i].size))
+            {
+                return false;
+            }
+
+            location += src[i].size;
+        }
+
+        return true;
+    }
+}
+
+}
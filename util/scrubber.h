@@ -0,0 +1,471 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Persist with incremental background verification. Bit rot in idle regions
+// of the memory otherwise goes unnoticed until Init or Load happens to walk
+// it, and a full verify pass in one go would stall the caller.
+//
+// Each Scrub(budget) call reads the next budget bytes of the memory into a
+// RAM shadow, so that every byte is read from the medium once per pass and
+// read errors are found. Foreground writes and erases are mirrored into the
+// shadow, so at the end of a pass it matches the medium. The pass then
+// mounts a second Persist on a snapshot of the shadow, which costs no I/O,
+// and checks that it loads the current generation. If it does not, or the
+// pass hit read errors, the current generation is written again to a fresh
+// block.
+//
+// Scrub can be called from the foreground at convenient times, or run from
+// an idle-priority thread with StartScrubThread. Scrub never holds the lock
+// that Save takes while it reads the medium or verifies the snapshot, only
+// while it copies to or from RAM, so a starved idle thread cannot block the
+// foreground for long. A chunk read while a foreground write was under way
+// may mix old and new bytes, so it is discarded and read again; writes are
+// numbered to tell. Load only takes a lock that Scrub never holds, and
+// answers from RAM. The shadow and the snapshot cost kSize bytes of RAM
+// each.
+//
+// The stored record carries a rewrite counter next to the data, so that a
+// rewrite of unchanged data is not skipped as a redundant Save. Since it is
+// not a plain T, datatype_version must differ from any version the same
+// memory held a plain T under; LoadLegacy reads such older data, and the
+// next Save or scrub pass rewrites it in the current format.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <sched.h>
+
+#include "persist/persist.h"
+#include "util/history.h"
+#include "util/span_memory.h"
+
+namespace demo
+{
+
+namespace detail
+{
+
+// Forwards to the memory and keeps a shadow in step with every write and
+// erase, numbering them so that readers of the medium can tell whether one
+// happened meanwhile.
+template <typename Memory>
+class ShadowedMemory
+{
+public:
+    static constexpr uint32_t kSize = Memory::kSize;
+    static constexpr uint32_t kEraseGranularity = Memory::kEraseGranularity;
+    static constexpr uint32_t kWriteGranularity = Memory::kWriteGranularity;
+    static constexpr uint8_t kFillByte = Memory::kFillByte;
+
+    ShadowedMemory(Memory& memory, uint8_t* shadow) :
+        memory_(memory),
+        shadow_(shadow),
+        writes_(0)
+    {}
+
+    Memory& medium(void)
+    {
+        return memory_;
+    }
+
+    // Writes and erases attempted so far.
+    uint64_t writes(void) const
+    {
+        return writes_;
+    }
+
+    bool Read(void* dst, uint32_t location, uint32_t length)
+    {
+        return memory_.Read(dst, location, length);
+    }
+
+    bool Writable(uint32_t location, uint32_t length)
+    {
+        return memory_.Writable(location, length);
+    }
+
+    bool Write(uint32_t location, const void* src, uint32_t length)
+    {
+        writes_++;
+        bool result = memory_.Write(location, src, length);
+
+        if (result && location <= kSize && length <= kSize - location)
+        {
+            std::memcpy(shadow_ + location, src, length);
+        }
+
+        return result;
+    }
+
+    bool Erase(uint32_t location, uint32_t length)
+    {
+        writes_++;
+        bool result = memory_.Erase(location, length);
+
+        if (result && location <= kSize && length <= kSize - location)
+        {
+            std::memset(shadow_ + location, kFillByte, length);
+        }
+
+        return result;
+    }
+
+protected:
+    Memory& memory_;
+    uint8_t* shadow_;
+    uint64_t writes_;
+};
+
+}
+
+template <typename Memory, typename T, uint8_t datatype_version>
+class ScrubbedPersist
+{
+public:
+    static constexpr uint32_t kSize = Memory::kSize;
+    // Scrub reads the medium at most this much at a time
+    static constexpr uint32_t kChunkSize = std::min<uint32_t>(kSize, 4096);
+
+    using ShadowedMemory = detail::ShadowedMemory<Memory>;
+
+    // A Persist that stored older data on the same memory, for LoadLegacy.
+    template <typename U, uint8_t version>
+    using Legacy = persist::Persist<ShadowedMemory, U, version>;
+
+    struct Stats
+    {
+        uint64_t bytes_scrubbed;
+        uint64_t passes;
+        uint64_t read_errors;
+        uint64_t degraded;          // Passes that found a problem
+        uint64_t rewrites;
+        uint64_t rewrite_failures;
+        uint64_t collisions;        // Chunks read again after a write
+    };
+
+    ScrubbedPersist(Memory& memory) :
+        shadow_(new uint8_t[kSize]),
+        memory_{memory, shadow_.get()},
+        persist_{memory_},
+        valid_(false),
+        stats_{},
+        cursor_(0),
+        pass_errors_(false),
+        stop_(false)
+    {
+        std::memset(shadow_.get(), Memory::kFillByte, kSize);
+    }
+
+    ~ScrubbedPersist()
+    {
+        StopScrubThread();
+    }
+
+    persist::Result Init(void)
+    {
+        std::lock_guard scrub_lock{scrub_mutex_};
+        std::lock_guard lock{mutex_};
+        cursor_ = 0;
+        pass_errors_ = false;
+        persist::Result result = persist_.Init();
+
+        if (result == persist::RESULT_SUCCESS)
+        {
+            Record record;
+            bool valid = persist_.Load(record) == persist::RESULT_SUCCESS;
+            Adopt(record, valid);
+        }
+
+        return result;
+    }
+
+    persist::Result Load(T& data)
+    {
+        std::lock_guard lock{value_mutex_};
+
+        if (!valid_)
+        {
+            return persist::RESULT_FAIL_NO_DATA;
+        }
+
+        data = current_.data;
+        return persist::RESULT_SUCCESS;
+    }
+
+    // Like Load, but if no record of datatype_version was found, tries the
+    // Legacy persists in order. Data they yield becomes the current value.
+    template <typename... Legacy>
+    persist::Result LoadLegacy(T& data)
+    {
+        {
+            std::lock_guard lock{mutex_};
+            Record record;
+
+            if (!valid_ && persist_.template LoadLegacy<Legacy...>(record) ==
+                persist::RESULT_SUCCESS)
+            {
+                Adopt(record, true);
+            }
+        }
+
+        return Load(data);
+    }
+
+    persist::Result Save(const T& data)
+    {
+        std::lock_guard lock{mutex_};
+        Record record{data, valid_ ? current_.rewrites : 0};
+        persist::Result result = persist_.Save(record);
+
+        if (result == persist::RESULT_SUCCESS)
+        {
+            Adopt(record, true);
+        }
+
+        return result;
+    }
+
+    // Reads up to budget bytes of the memory and, at the end of a pass,
+    // verifies the current generation. Returns true if a pass completed.
+    bool Scrub(uint32_t budget)
+    {
+        std::lock_guard scrub_lock{scrub_mutex_};
+        uint32_t end = cursor_ + std::min(std::max(budget, 1u),
+            kSize - cursor_);
+
+        while (cursor_ < end)
+        {
+            uint32_t length = std::min(kChunkSize, end - cursor_);
+            uint64_t writes;
+
+            {
+                std::lock_guard lock{mutex_};
+                writes = memory_.writes();
+            }
+
+            bool ok = memory_.medium().Read(chunk_, cursor_, length);
+            std::lock_guard lock{mutex_};
+
+            if (memory_.writes() != writes)
+            {
+                // Try again on the next call, so that a stream of writes
+                // cannot keep this one spinning
+                stats_.collisions++;
+                return false;
+            }
+
+            if (ok)
+            {
+                std::memcpy(shadow_.get() + cursor_, chunk_, length);
+            }
+            else
+            {
+                stats_.read_errors++;
+                pass_errors_ = true;
+            }
+
+            stats_.bytes_scrubbed += length;
+            cursor_ += length;
+        }
+
+        if (cursor_ < kSize)
+        {
+            return false;
+        }
+
+        cursor_ = 0;
+        Record expected;
+        bool valid;
+        uint64_t writes;
+
+        {
+            std::lock_guard lock{mutex_};
+            stats_.passes++;
+            ShadowView view{shadow_.get()};
+            snapshot_.Load(view);
+            expected = current_;
+            valid = valid_;
+            writes = memory_.writes();
+        }
+
+        bool verified = Verify(expected, valid);
+        std::lock_guard lock{mutex_};
+
+        // A write since the snapshot has superseded what was verified; the
+        // next pass checks it
+        if ((pass_errors_ || !verified) && memory_.writes() == writes &&
+            valid_)
+        {
+            stats_.degraded++;
+            Rewrite();
+        }
+
+        pass_errors_ = false;
+        return true;
+    }
+
+    // Scrubs budget bytes every interval on a thread at idle priority.
+    void StartScrubThread(uint32_t budget, std::chrono::milliseconds interval)
+    {
+        StopScrubThread();
+        stop_ = false;
+        thread_ = std::thread([this, budget, interval]()
+        {
+            sched_param param{};
+            sched_setscheduler(0, SCHED_IDLE, &param);
+
+            std::unique_lock lock{thread_mutex_};
+
+            while (!stop_)
+            {
+                lock.unlock();
+                Scrub(budget);
+                lock.lock();
+                stopped_.wait_for(lock, interval, [this]() { return stop_; });
+            }
+        });
+    }
+
+    void StopScrubThread(void)
+    {
+        {
+            std::lock_guard lock{thread_mutex_};
+            stop_ = true;
+        }
+
+        stopped_.notify_all();
+
+        if (thread_.joinable())
+        {
+            thread_.join();
+        }
+    }
+
+    Stats stats(void)
+    {
+        std::lock_guard lock{mutex_};
+        return stats_;
+    }
+
+protected:
+    struct Record
+    {
+        T data;
+        uint32_t rewrites;
+
+        Record(void) = default;
+
+        Record(const T& data, uint32_t rewrites) :
+            data(data),
+            rewrites(rewrites)
+        {}
+
+        // Converts data stored by a Legacy persist
+        template <typename U>
+        explicit Record(const U& legacy) :
+            data(legacy),
+            rewrites(0)
+        {}
+    };
+
+    using ShadowView = SpanMemory<Memory::kSize, Memory::kEraseGranularity,
+        Memory::kWriteGranularity>;
+    using Snapshot = SnapshotMemory<ShadowView>;
+
+    std::unique_ptr<uint8_t[]> shadow_;
+    ShadowedMemory memory_;
+    persist::Persist<ShadowedMemory, Record, datatype_version> persist_;
+
+    // Guards the shadow and everything above and below it, except the
+    // members Scrub alone uses. Held only for RAM copies and for the
+    // foreground's own I/O.
+    std::mutex mutex_;
+    Record current_;
+    bool valid_;
+    Stats stats_;
+
+    // Guards current_ and valid_ too, for Load; they change with both held
+    std::mutex value_mutex_;
+
+    // Serializes Scrub and guards the members below
+    std::mutex scrub_mutex_;
+    uint32_t cursor_;
+    bool pass_errors_;
+    uint8_t chunk_[kChunkSize];
+    Snapshot snapshot_;
+
+    std::mutex thread_mutex_;
+    std::condition_variable stopped_;
+    bool stop_;
+    std::thread thread_;
+
+    // Makes record the current value. Called with mutex_ held.
+    void Adopt(const Record& record, bool valid)
+    {
+        std::lock_guard lock{value_mutex_};
+        current_ = record;
+        valid_ = valid;
+    }
+
+    // True if the snapshot yields the expected generation.
+    bool Verify(const Record& expected, bool valid)
+    {
+        persist::Persist<Snapshot, Record, datatype_version> verify{
+            snapshot_};
+        Record record;
+
+        if (verify.Init() != persist::RESULT_SUCCESS ||
+            verify.Load(record) != persist::RESULT_SUCCESS)
+        {
+            return !valid;
+        }
+
+        return valid && record.rewrites == expected.rewrites &&
+            std::memcmp(&record.data, &expected.data, sizeof(T)) == 0;
+    }
+
+    // Called with mutex_ held.
+    void Rewrite(void)
+    {
+        Record record{current_.data, current_.rewrites + 1};
+        stats_.rewrites++;
+
+        if (persist_.Save(record) == persist::RESULT_SUCCESS)
+        {
+            Adopt(record, true);
+        }
+        else
+        {
+            stats_.rewrite_failures++;
+        }
+    }
+};
+
+}
@@ -0,0 +1,570 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Serialization customization point for persisting types that are not
+// trivially copyable, such as those holding std::string or std::vector.
+// Specialize Serializer<T> with three hooks:
+//
+//     static uint32_t Size(const T& value);
+//     static void Write(SerialWriter& out, const T& value);
+//     static void Read(SerialReader& in, T& value);
+//
+// Trivially copyable types, std::string, and std::vector of any serializable
+// type are handled here.
+//
+// SerializedPersist keeps the latest value of such a type. Persist stores
+// only fixed-size records, so it uses its own ring of variable-length
+// records, each starting on a write granule:
+//
+//     [magic:2][version:1][fill:1][sequence:4][size:4] payload [crc:2] [fill]
+//
+// Save streams the encoding straight to the medium one chunk of write
+// granules at a time, checksumming as it goes, so no copy of the whole
+// encoded object is ever made. The trailing CRC is written last and covers
+// the header and payload, so a torn record is ignored. Init finds the newest
+// record in a single scan.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "persist/inc/crc16.h"
+#include "persist/persist.h"
+#include "util/layout.h"
+#include "util/scatter_gather.h"
+
+namespace demo
+{
+
+template <typename T, typename = void>
+struct Serializer;
+
+class SerialWriter
+{
+public:
+    // Receives the buffer each time it fills; returns false on failure
+    using Sink = std::function<bool(const uint8_t* data, uint32_t size)>;
+
+    // Encodes into dst and fails once it is full.
+    explicit SerialWriter(Segment dst) :
+        SerialWriter(dst, nullptr)
+    {}
+
+    // Hands the buffer to sink whenever it fills and more bytes arrive, so
+    // an encoding of any length streams through a small buffer. The bytes
+    // still buffered at the end are left to the caller via pending().
+    SerialWriter(Segment buffer, Sink sink) :
+        buffer_(buffer),
+        sink_(std::move(sink)),
+        fill_(0),
+        position_(0),
+        ok_(true)
+    {}
+
+    void Bytes(const void* src, uint32_t size)
+    {
+        auto bytes = static_cast<const uint8_t*>(src);
+
+        while (ok_ && size)
+        {
+            if (fill_ == buffer_.size)
+            {
+                if (!sink_ || !sink_(static_cast<uint8_t*>(buffer_.data),
+                    fill_))
+                {
+                    ok_ = false;
+                    return;
+                }
+
+                fill_ = 0;
+            }
+
+            uint32_t length = std::min(size, buffer_.size - fill_);
+            std::memcpy(static_cast<uint8_t*>(buffer_.data) + fill_, bytes,
+                length);
+            fill_ += length;
+            position_ += length;
+            bytes += length;
+            size -= length;
+        }
+    }
+
+    template <typename T>
+    void operator()(const T& value)
+    {
+        Serializer<T>::Write(*this, value);
+    }
+
+    ConstSegment pending(void) const { return {buffer_.data, fill_}; }
+    uint32_t position(void) const { return position_; }
+    bool ok(void) const { return ok_; }
+
+protected:
+    Segment buffer_;
+    Sink sink_;
+    uint32_t fill_;
+    uint32_t position_;
+    bool ok_;
+};
+
+class SerialReader
+{
+public:
+    explicit SerialReader(ConstSegment src) :
+        src_(src),
+        position_(0),
+        ok_(true)
+    {}
+
+    void Bytes(void* dst, uint32_t size)
+    {
+        if (!ok_ || size > src_.size - position_)
+        {
+            ok_ = false;
+            return;
+        }
+
+        auto src = static_cast<const uint8_t*>(src_.data) + position_;
+        std::memcpy(dst, src, size);
+        position_ += size;
+    }
+
+    template <typename T>
+    void operator()(T& value)
+    {
+        Serializer<T>::Read(*this, value);
+    }
+
+    uint32_t remaining(void) const { return src_.size - position_; }
+    bool ok(void) const { return ok_; }
+    void Fail(void) { ok_ = false; }
+
+protected:
+    ConstSegment src_;
+    uint32_t position_;
+    bool ok_;
+};
+
+template <typename T>
+struct Serializer<T, std::enable_if_t<std::is_trivially_copyable_v<T>>>
+{
+    static uint32_t Size(const T&)
+    {
+        return sizeof(T);
+    }
+
+    static void Write(SerialWriter& out, const T& value)
+    {
+        out.Bytes(&value, sizeof(T));
+    }
+
+    static void Read(SerialReader& in, T& value)
+    {
+        in.Bytes(&value, sizeof(T));
+    }
+};
+
+template <>
+struct Serializer<std::string>
+{
+    static uint32_t Size(const std::string& value)
+    {
+        return sizeof(uint32_t) + value.size();
+    }
+
+    static void Write(SerialWriter& out, const std::string& value)
+    {
+        out(uint32_t(value.size()));
+        out.Bytes(value.data(), value.size());
+    }
+
+    static void Read(SerialReader& in, std::string& value)
+    {
+        uint32_t size = 0;
+        in(size);
+
+        if (size > in.remaining())
+        {
+            in.Fail();
+            return;
+        }
+
+        value.resize(size);
+        in.Bytes(value.data(), size);
+    }
+};
+
+template <typename T>
+struct Serializer<std::vector<T>>
+{
+    static uint32_t Size(const std::vector<T>& value)
+    {
+        uint32_t size = sizeof(uint32_t);
+
+        for (auto& element : value)
+        {
+            size += Serializer<T>::Size(element);
+        }
+
+        return size;
+    }
+
+    static void Write(SerialWriter& out, const std::vector<T>& value)
+    {
+        out(uint32_t(value.size()));
+
+        for (auto& element : value)
+        {
+            out(element);
+        }
+    }
+
+    static void Read(SerialReader& in, std::vector<T>& value)
+    {
+        uint32_t count = 0;
+        in(count);
+
+        // Every element occupies at least one byte, which bounds the count
+        // read from a record that passed its checksum but is still bogus
+        if (count > in.remaining())
+        {
+            in.Fail();
+            return;
+        }
+
+        value.resize(count);
+
+        for (auto& element : value)
+        {
+            in(element);
+        }
+    }
+};
+
+
+template <typename Memory, typename T, uint8_t datatype_version,
+    uint32_t capacity>
+class SerializedPersist
+{
+public:
+    static constexpr uint32_t kCapacity = capacity;
+    static constexpr uint32_t kHeaderSize = 12;
+    static constexpr uint32_t kTrailerSize = 2;
+    static constexpr uint16_t kMagic = 0x5053; // "SP"
+    static constexpr uint32_t kGranule = Memory::kWriteGranularity;
+    static constexpr uint32_t kUnit = Memory::kEraseGranularity;
+    static constexpr uint32_t kChunk = layout::RoundUp<kGranule>(256);
+
+    // Records are packed end to end, so a full-capacity record is a packed
+    // block that may straddle erase units
+    using Layout = BlockLayout<Memory, kHeaderSize + kTrailerSize, kCapacity,
+        LAYOUT_PACKED | LAYOUT_STRADDLE>;
+    static constexpr uint32_t kMaxRecord = Layout::kBlockSize;
+    // Wear when every value is of full capacity
+    static constexpr LayoutReport kLayout = Layout::kLayout;
+
+    // Leaves room to erase ahead of the newest record without touching it
+    static_assert(Layout::kNumUnits >= 4 * Layout::kUnitsPerBlock,
+        "Memory is too small for records of this capacity");
+
+    SerializedPersist(Memory& memory) :
+        memory_(memory),
+        valid_(false),
+        location_(0),
+        size_(0),
+        sequence_(0),
+        next_(0)
+    {
+        crc_.Init();
+    }
+
+    persist::Result Init(void)
+    {
+        valid_ = false;
+        next_ = 0;
+
+        for (uint32_t location = 0;
+            location + kHeaderSize + kTrailerSize <= Memory::kSize;)
+        {
+            uint32_t sequence;
+            uint32_t size;
+
+            if (!Verify(location, sequence, size))
+            {
+                location += kGranule;
+                continue;
+            }
+
+            if (!valid_ || int32_t(sequence - sequence_) > 0)
+            {
+                valid_ = true;
+                location_ = location;
+                size_ = size;
+                sequence_ = sequence;
+            }
+
+            location += RecordSize(size);
+        }
+
+        if (valid_)
+        {
+            next_ = location_ + RecordSize(size_);
+        }
+
+        return persist::RESULT_SUCCESS;
+    }
+
+    // Leaves data untouched unless a complete record is decoded.
+    persist::Result Load(T& data)
+    {
+        uint32_t sequence;
+        uint32_t size;
+
+        if (!valid_ || !Verify(location_, sequence, size) ||
+            sequence != sequence_)
+        {
+            return persist::RESULT_FAIL_NO_DATA;
+        }
+
+        std::vector<uint8_t> payload(size);
+
+        if (!memory_.Read(payload.data(), location_ + kHeaderSize, size))
+        {
+            return persist::RESULT_FAIL_NO_DATA;
+        }
+
+        T decoded;
+        SerialReader in{{payload.data(), size}};
+        in(decoded);
+
+        if (!in.ok() || in.remaining())
+        {
+            return persist::RESULT_FAIL_NO_DATA;
+        }
+
+        data = std::move(decoded);
+        return persist::RESULT_SUCCESS;
+    }
+
+    // Whether the encoding of data fits in a record.
+    static bool Fits(const T& data)
+    {
+        return Serializer<T>::Size(data) <= kCapacity;
+    }
+
+    // Saving a value whose encoding matches the newest record writes
+    // nothing. A value that does not Fit is refused with
+    // RESULT_FAIL_MEMORY, as is any erase or write the medium refuses.
+    persist::Result Save(const T& data)
+    {
+        uint32_t size = Serializer<T>::Size(data);
+
+        if (size > kCapacity)
+        {
+            return persist::RESULT_FAIL_MEMORY;
+        }
+
+        if (valid_ && size == size_ && Matches(data))
+        {
+            return persist::RESULT_SUCCESS;
+        }
+
+        uint32_t length = RecordSize(size);
+        uint32_t location = next_;
+
+        if (location + length > Memory::kSize)
+        {
+            location = 0;
+        }
+
+        if (!memory_.Writable(location, length))
+        {
+            // The unit holding location may hold the newest record too, so
+            // start afresh on the next one
+            location = layout::RoundUp<kUnit>(location);
+
+            if (location + length > Memory::kSize)
+            {
+                location = 0;
+            }
+
+            uint32_t end = std::min(layout::RoundUp<kUnit>(location + length),
+                Memory::kSize);
+
+            if (!memory_.Erase(location, end - location))
+            {
+                return persist::RESULT_FAIL_MEMORY;
+            }
+        }
+
+        uint8_t header[kHeaderSize];
+        uint16_t magic = kMagic;
+        uint32_t sequence = valid_ ? sequence_ + 1 : 0;
+        std::memcpy(header, &magic, 2);
+        header[2] = datatype_version;
+        header[3] = Memory::kFillByte;
+        std::memcpy(header + 4, &sequence, 4);
+        std::memcpy(header + 8, &size, 4);
+
+        uint32_t written = 0;
+        crc_.Seed(0xFFFF);
+
+        SerialWriter out{{chunk_, kChunk},
+            [&](const uint8_t* chunk, uint32_t length)
+            {
+                crc_.Process(chunk, length);
+
+                if (!memory_.Write(location + written, chunk, length))
+                {
+                    return false;
+                }
+
+                written += length;
+                return true;
+            }};
+
+        out.Bytes(header, kHeaderSize);
+        out(data);
+
+        ConstSegment tail = out.pending();
+        uint16_t crc = crc_.Process(tail.data, tail.size);
+        out.Bytes(&crc, kTrailerSize);
+
+        // The newest record is untouched, so it stays loadable
+        if (!out.ok())
+        {
+            next_ = location + length;
+            return persist::RESULT_FAIL_MEMORY;
+        }
+
+        // Pad the last chunk out to a whole write granule
+        tail = out.pending();
+        uint32_t padded = layout::RoundUp<kGranule>(tail.size);
+        std::memset(chunk_ + tail.size, Memory::kFillByte, padded - tail.size);
+
+        if (!memory_.Write(location + written, chunk_, padded))
+        {
+            next_ = location + length;
+            return persist::RESULT_FAIL_MEMORY;
+        }
+
+        valid_ = true;
+        location_ = location;
+        size_ = size;
+        sequence_ = sequence;
+        next_ = location + length;
+        return persist::RESULT_SUCCESS;
+    }
+
+protected:
+    Memory& memory_;
+    persist::Crc16 crc_;
+    uint8_t chunk_[kChunk];
+    uint8_t compare_[kChunk];
+    bool valid_;
+    uint32_t location_;     // Of the newest record
+    uint32_t size_;         // Of the newest record's payload
+    uint32_t sequence_;     // Of the newest record
+    uint32_t next_;         // Where the next record may start
+
+    static constexpr uint32_t RecordSize(uint32_t size)
+    {
+        return layout::RoundUp<kGranule>(kHeaderSize + size + kTrailerSize);
+    }
+
+    // Checks the header and CRC of the record at location.
+    bool Verify(uint32_t location, uint32_t& sequence, uint32_t& size)
+    {
+        uint8_t header[kHeaderSize];
+        uint16_t magic;
+
+        if (!memory_.Read(header, location, kHeaderSize))
+        {
+            return false;
+        }
+
+        std::memcpy(&magic, header, 2);
+        std::memcpy(&sequence, header + 4, 4);
+        std::memcpy(&size, header + 8, 4);
+
+        if (magic != kMagic || header[2] != datatype_version ||
+            size > kCapacity ||
+            location + kHeaderSize + size + kTrailerSize > Memory::kSize)
+        {
+            return false;
+        }
+
+        crc_.Seed(0xFFFF);
+        uint16_t crc = crc_.Process(header, kHeaderSize);
+
+        for (uint32_t offset = 0; offset < size; offset += kChunk)
+        {
+            uint32_t length = std::min(kChunk, size - offset);
+
+            if (!memory_.Read(chunk_, location + kHeaderSize + offset, length))
+            {
+                return false;
+            }
+
+            crc = crc_.Process(chunk_, length);
+        }
+
+        uint16_t stored;
+
+        return memory_.Read(&stored, location + kHeaderSize + size,
+            kTrailerSize) && stored == crc;
+    }
+
+    // Compares the encoding of data with the newest record's payload
+    // without staging either in full.
+    bool Matches(const T& data)
+    {
+        uint32_t offset = 0;
+        auto compare = [&](const uint8_t* chunk, uint32_t length)
+        {
+            if (!memory_.Read(compare_, location_ + kHeaderSize + offset,
+                length) || std::memcmp(chunk, compare_, length))
+            {
+                return false;
+            }
+
+            offset += length;
+            return true;
+        };
+
+        SerialWriter out{{chunk_, kChunk}, compare};
+        out(data);
+        ConstSegment tail = out.pending();
+
+        return out.ok() && out.position() == size_ &&
+            compare(static_cast<const uint8_t*>(tail.data), tail.size);
+    }
+};
+
+}
@@ -0,0 +1,410 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Store of many persisted objects spread across several memories (shards),
+// typically one image file per disk or per core. Object IDs map to a shard
+// by id % num_shards, and each shard divides its memory into num_slots
+// partitions with a Persist per object.
+//
+// Each shard has its own worker thread fed by a bounded submission queue.
+// Save enqueues and returns; the worker drains the whole queue at once and
+// writes only the newest value for each object, so rapid updates to one
+// object coalesce into a single write. If the Memory has a Sync method, the
+// worker calls it once per drained batch. Load observes queued values, so a
+// caller always reads its own writes. Write and sync failures are reported
+// by the next Flush.
+
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "persist/persist.h"
+#include "util/mount.h"
+#include "util/partition_memory.h"
+
+namespace demo
+{
+
+template <typename Memory, typename = void>
+struct HasSync : std::false_type {};
+
+template <typename Memory>
+struct HasSync<Memory, std::void_t<decltype(std::declval<Memory&>().Sync())>> :
+    std::true_type {};
+
+template <typename Memory, typename T, uint8_t datatype_version,
+    uint32_t num_slots, uint32_t queue_depth = 64>
+class ShardedPersistStore
+{
+public:
+    static constexpr uint32_t kNumSlots = num_slots;
+    static constexpr uint32_t kQueueDepth = queue_depth;
+    static constexpr uint32_t kSlotSize = Memory::kSize / kNumSlots /
+        Memory::kEraseGranularity * Memory::kEraseGranularity;
+
+    // A wrap erases the unit after the newest value, never the only copy
+    static_assert(kSlotSize >= 2 * Memory::kEraseGranularity,
+        "Too many slots for the memory geometry");
+
+    using Factory = std::function<std::unique_ptr<Memory>(uint32_t shard)>;
+
+    struct Stats
+    {
+        uint64_t submitted;
+        uint64_t written;
+        uint64_t coalesced;
+        uint64_t failed;
+        uint64_t batches;
+        uint64_t failed_syncs;
+    };
+
+    ShardedPersistStore(uint32_t num_shards, Factory factory)
+    {
+        for (uint32_t i = 0; i < num_shards; i++)
+        {
+            shards_.push_back(std::make_unique<Shard>(factory(i)));
+        }
+    }
+
+    ~ShardedPersistStore()
+    {
+        for (auto& shard : shards_)
+        {
+            shard->Stop();
+        }
+    }
+
+    // Mounts every object in parallel, then starts the workers.
+    persist::Result Init(void)
+    {
+        std::vector<SlotPersist*> slots;
+
+        for (auto& shard : shards_)
+        {
+            for (auto& slot : shard->slots)
+            {
+                slots.push_back(slot.get());
+            }
+        }
+
+        persist::Result result = MountRange(slots.begin(), slots.end());
+
+        if (result == persist::RESULT_SUCCESS)
+        {
+            for (auto& shard : shards_)
+            {
+                shard->Start();
+            }
+        }
+
+        return result;
+    }
+
+    uint32_t num_shards(void) const
+    {
+        return shards_.size();
+    }
+
+    uint32_t capacity(void) const
+    {
+        return shards_.size() * kNumSlots;
+    }
+
+    persist::Result Load(uint32_t id, T& data)
+    {
+        if (id >= capacity())
+        {
+            return persist::RESULT_FAIL_NO_DATA;
+        }
+
+        return ShardOf(id).Load(id / shards_.size(), data);
+    }
+
+    // Queues data to be saved, blocking while the shard's queue is full.
+    // Returns false if id is out of range or the store is not initialized.
+    bool Save(uint32_t id, const T& data)
+    {
+        if (id >= capacity())
+        {
+            return false;
+        }
+
+        return ShardOf(id).Submit(id / shards_.size(), data);
+    }
+
+    // Waits until everything queued so far has been written and, if the
+    // Memory has Sync, synced. Returns false if the store is not initialized
+    // or any write or sync failed since the last Flush.
+    bool Flush(void)
+    {
+        bool ok = true;
+
+        for (auto& shard : shards_)
+        {
+            ok = shard->Flush() && ok;
+        }
+
+        return ok;
+    }
+
+    Stats stats(void)
+    {
+        Stats total{};
+
+        for (auto& shard : shards_)
+        {
+            std::lock_guard lock{shard->queue_mutex};
+            total.submitted += shard->stats.submitted;
+            total.written += shard->stats.written;
+            total.coalesced += shard->stats.coalesced;
+            total.failed += shard->stats.failed;
+            total.batches += shard->stats.batches;
+            total.failed_syncs += shard->stats.failed_syncs;
+        }
+
+        return total;
+    }
+
+protected:
+    using SlotMemory = PartitionMemory<Memory, kSlotSize>;
+    using SlotPersist = persist::Persist<SlotMemory, T, datatype_version>;
+
+    struct Request
+    {
+        uint32_t slot;
+        T data;
+    };
+
+    struct Shard
+    {
+        std::unique_ptr<Memory> memory;
+        std::vector<std::unique_ptr<SlotMemory>> slot_memories;
+        std::vector<std::unique_ptr<SlotPersist>> slots;
+
+        // Lock order: io_mutex before queue_mutex
+        std::mutex io_mutex;
+        std::mutex queue_mutex;
+        std::condition_variable not_empty;
+        std::condition_variable not_full;
+        std::condition_variable flushed;
+        std::deque<Request> queue;
+        uint64_t sequence = 0;
+        uint64_t completed = 0;
+        uint64_t unreported = 0;
+        bool running = false;
+        bool stop = false;
+        Stats stats{};
+        std::thread worker;
+
+        Shard(std::unique_ptr<Memory> shard_memory) :
+            memory(std::move(shard_memory))
+        {
+            for (uint32_t i = 0; i < kNumSlots; i++)
+            {
+                slot_memories.push_back(
+                    std::make_unique<SlotMemory>(*memory, i * kSlotSize));
+                slots.push_back(
+                    std::make_unique<SlotPersist>(*slot_memories.back()));
+            }
+        }
+
+        void Start(void)
+        {
+            if (!worker.joinable())
+            {
+                worker = std::thread([this]() { Run(); });
+
+                std::lock_guard lock{queue_mutex};
+                running = true;
+            }
+        }
+
+        void Stop(void)
+        {
+            {
+                std::lock_guard lock{queue_mutex};
+                stop = true;
+            }
+
+            not_empty.notify_all();
+
+            if (worker.joinable())
+            {
+                worker.join();
+            }
+        }
+
+        bool Submit(uint32_t slot, const T& data)
+        {
+            std::unique_lock lock{queue_mutex};
+
+            // Without a worker the queue would never drain
+            if (!running)
+            {
+                return false;
+            }
+
+            not_full.wait(lock, [this]()
+            {
+                return queue.size() < kQueueDepth;
+            });
+            queue.push_back(Request{slot, data});
+            sequence++;
+            stats.submitted++;
+            lock.unlock();
+            not_empty.notify_one();
+            return true;
+        }
+
+        bool Flush(void)
+        {
+            std::unique_lock lock{queue_mutex};
+
+            if (!running)
+            {
+                return false;
+            }
+
+            uint64_t target = sequence;
+            flushed.wait(lock, [&]() { return completed >= target; });
+
+            bool ok = unreported == 0;
+            unreported = 0;
+            return ok;
+        }
+
+        persist::Result Load(uint32_t slot, T& data)
+        {
+            std::lock_guard io_lock{io_mutex};
+
+            {
+                std::lock_guard lock{queue_mutex};
+
+                for (auto it = queue.rbegin(); it != queue.rend(); ++it)
+                {
+                    if (it->slot == slot)
+                    {
+                        data = it->data;
+                        return persist::RESULT_SUCCESS;
+                    }
+                }
+            }
+
+            return slots[slot]->Load(data);
+        }
+
+        void Run(void)
+        {
+            std::deque<Request> batch;
+            std::vector<bool> seen(kNumSlots);
+
+            for (;;)
+            {
+                {
+                    std::unique_lock lock{queue_mutex};
+                    not_empty.wait(lock, [this]()
+                    {
+                        return stop || !queue.empty();
+                    });
+
+                    if (queue.empty())
+                    {
+                        return;
+                    }
+                }
+
+                std::lock_guard io_lock{io_mutex};
+
+                {
+                    std::lock_guard lock{queue_mutex};
+                    batch.swap(queue);
+                }
+
+                not_full.notify_all();
+
+                // Newest request for each slot wins
+                uint64_t written = 0;
+                uint64_t failed = 0;
+                std::fill(seen.begin(), seen.end(), false);
+
+                for (auto it = batch.rbegin(); it != batch.rend(); ++it)
+                {
+                    if (seen[it->slot])
+                    {
+                        continue;
+                    }
+
+                    seen[it->slot] = true;
+                    written++;
+
+                    if (slots[it->slot]->Save(it->data) !=
+                        persist::RESULT_SUCCESS)
+                    {
+                        failed++;
+                    }
+                }
+
+                bool synced = true;
+
+                if constexpr (HasSync<Memory>::value)
+                {
+                    synced = memory->Sync();
+                }
+
+                {
+                    std::lock_guard lock{queue_mutex};
+                    completed += batch.size();
+                    stats.written += written;
+                    stats.coalesced += batch.size() - written;
+                    stats.failed += failed;
+                    stats.batches++;
+                    stats.failed_syncs += !synced;
+
+                    // None of the batch is known to be durable
+                    unreported += synced ? failed : written;
+                }
+
+                batch.clear();
+                flushed.notify_all();
+            }
+        }
+    };
+
+    std::vector<std::unique_ptr<Shard>> shards_;
+
+    Shard& ShardOf(uint32_t id)
+    {
+        return *shards_[id % shards_.size()];
+    }
+};
+
+}
@@ -0,0 +1,370 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Memory backed by a shared memory segment, so that several processes can
+// map the same persisted region. The segment is either a named POSIX shared
+// memory object or a memfd, optionally on huge pages, whose descriptor is
+// handed to other processes by fork or over a Unix socket.
+//
+// As on flash, Write only programs erased bytes. A small header in front of
+// the data holds a change counter. Writes and erases only mark the segment
+// changed; Publish bumps the counter once, so that readers in other
+// processes blocked in WaitForChange (a futex on the counter) wake once per
+// saved block rather than once per write, and reload instead of polling
+// Load. ShmPersist publishes after every Save. Only one process should
+// write at a time.
+//
+// The first process to map a new segment erases it. If that process dies
+// before finishing, the next one to map the segment takes over; a segment
+// whose formatter is alive but never finishes leaves the mapping invalid
+// after kFormatTimeout.
+//
+// Persist needs the memory size at compile time, so kSize is a template
+// parameter; the segment itself is sized and mapped at run time.
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "persist/persist.h"
+#include "util/blank_scan.h"
+
+namespace demo
+{
+
+template <uint32_t memory_size, uint32_t erase_granularity,
+    uint32_t write_granularity>
+class ShmMemory
+{
+public:
+    static constexpr uint32_t kSize = memory_size;
+    static constexpr uint32_t kEraseGranularity = erase_granularity;
+    static constexpr uint32_t kWriteGranularity = write_granularity;
+    static constexpr uint8_t kFillByte = 0xFF;
+
+    static constexpr uint32_t kHeaderSize = 64;
+    static constexpr uint32_t kHugePageSize = 2 * 1024 * 1024;
+    static constexpr std::chrono::seconds kFormatTimeout{5};
+
+    // Creates an anonymous segment and returns its descriptor, or -1 on
+    // failure. The caller owns the descriptor.
+    static int CreateMemfd(const char* name, bool huge_pages = false)
+    {
+        int fd = memfd_create(name, MFD_CLOEXEC |
+            (huge_pages ? MFD_HUGETLB : 0));
+
+        if (fd >= 0 && ftruncate(fd, MappingSize(huge_pages)) != 0)
+        {
+            close(fd);
+            fd = -1;
+        }
+
+        return fd;
+    }
+
+    // Maps a segment created by CreateMemfd. The descriptor is duplicated,
+    // so the caller may close its own copy.
+    ShmMemory(int fd, bool huge_pages = false)
+    {
+        Map(dup(fd), huge_pages);
+    }
+
+    // Opens or creates the named POSIX shared memory object.
+    ShmMemory(const std::string& name)
+    {
+        int fd = shm_open(name.c_str(), O_RDWR | O_CREAT, 0600);
+
+        if (fd >= 0 && ftruncate(fd, MappingSize(false)) != 0)
+        {
+            close(fd);
+            fd = -1;
+        }
+
+        Map(fd, false);
+    }
+
+    ShmMemory(const ShmMemory&) = delete;
+    ShmMemory& operator=(const ShmMemory&) = delete;
+
+    ~ShmMemory()
+    {
+        if (header_ != nullptr)
+        {
+            munmap(header_, mapping_size_);
+        }
+    }
+
+    static void Unlink(const std::string& name)
+    {
+        shm_unlink(name.c_str());
+    }
+
+    bool valid(void) const
+    {
+        return header_ != nullptr;
+    }
+
+    // Number of published changes so far.
+    uint32_t sequence(void) const
+    {
+        return header_->sequence.load(std::memory_order_acquire);
+    }
+
+    // Blocks until the sequence differs from seen or the timeout expires.
+    // Returns true if it changed.
+    bool WaitForChange(uint32_t seen, std::chrono::milliseconds timeout)
+    {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+
+        while (sequence() == seen)
+        {
+            auto remaining = deadline - std::chrono::steady_clock::now();
+
+            if (remaining <= remaining.zero())
+            {
+                return false;
+            }
+
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                remaining).count();
+            timespec ts{time_t(ns / 1000000000), long(ns % 1000000000)};
+            syscall(SYS_futex, &header_->sequence, FUTEX_WAIT, seen, &ts,
+                nullptr, 0);
+        }
+
+        return true;
+    }
+
+    bool Read(void* dst, uint32_t location, uint32_t length)
+    {
+        if (!Contains(location, length))
+        {
+            return false;
+        }
+
+        std::memcpy(dst, data_ + location, length);
+        return true;
+    }
+
+    bool Writable(uint32_t location, uint32_t length)
+    {
+        return Contains(location, length) &&
+            !(location % kWriteGranularity) &&
+            !(length % kWriteGranularity) &&
+            IsAllFill(data_ + location, length, kFillByte);
+    }
+
+    bool Write(uint32_t location, const void* src, uint32_t length)
+    {
+        if (!Writable(location, length))
+        {
+            return false;
+        }
+
+        std::memcpy(data_ + location, src, length);
+        unpublished_ = true;
+        return true;
+    }
+
+    bool Erase(uint32_t location, uint32_t length)
+    {
+        if (!Contains(location, length) ||
+            (location % kEraseGranularity) || (length % kEraseGranularity))
+        {
+            return false;
+        }
+
+        std::memset(data_ + location, kFillByte, length);
+        unpublished_ = true;
+        return true;
+    }
+
+    // Wakes readers if anything changed since the last call.
+    void Publish(void)
+    {
+        if (!unpublished_)
+        {
+            return;
+        }
+
+        unpublished_ = false;
+        header_->sequence.fetch_add(1, std::memory_order_release);
+        syscall(SYS_futex, &header_->sequence, FUTEX_WAKE, INT32_MAX,
+            nullptr, nullptr, 0);
+    }
+
+protected:
+    struct Header
+    {
+        std::atomic<uint32_t> state;
+        std::atomic<uint32_t> sequence;
+    };
+
+    static_assert(sizeof(Header) <= kHeaderSize);
+    static_assert(std::atomic<uint32_t>::is_always_lock_free);
+
+    // Any other state is the pid of the process erasing the segment
+    static constexpr uint32_t kStateNew = 0;
+    static constexpr uint32_t kStateReady = UINT32_MAX;
+
+    Header* header_ = nullptr;
+    uint8_t* data_ = nullptr;
+    size_t mapping_size_ = 0;
+    bool unpublished_ = false;
+
+    static size_t MappingSize(bool huge_pages)
+    {
+        size_t size = kHeaderSize + kSize;
+
+        if (huge_pages)
+        {
+            size = (size + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+        }
+
+        return size;
+    }
+
+    void Map(int fd, bool huge_pages)
+    {
+        if (fd < 0)
+        {
+            return;
+        }
+
+        mapping_size_ = MappingSize(huge_pages);
+        void* mapping = mmap(nullptr, mapping_size_, PROT_READ | PROT_WRITE,
+            MAP_SHARED, fd, 0);
+        close(fd);
+
+        if (mapping == MAP_FAILED)
+        {
+            return;
+        }
+
+        header_ = static_cast<Header*>(mapping);
+        data_ = static_cast<uint8_t*>(mapping) + kHeaderSize;
+
+        if (!Format())
+        {
+            munmap(mapping, mapping_size_);
+            header_ = nullptr;
+            data_ = nullptr;
+        }
+    }
+
+    // A new segment reads as zeros. The first process to map it claims it
+    // with its pid and erases the data area; the others wait until that is
+    // done, and claim it themselves if the formatter has died. Returns false
+    // if the segment is not ready within kFormatTimeout.
+    bool Format(void)
+    {
+        const uint32_t self = getpid();
+        auto deadline = std::chrono::steady_clock::now() + kFormatTimeout;
+        uint32_t state = kStateNew;
+
+        while (!header_->state.compare_exchange_strong(state, self,
+            std::memory_order_acquire))
+        {
+            if (state == kStateReady)
+            {
+                return true;
+            }
+
+            if (state != kStateNew && kill(pid_t(state), 0) != 0 &&
+                errno == ESRCH)
+            {
+                // Formatter died; retry the exchange against its pid
+                continue;
+            }
+
+            if (std::chrono::steady_clock::now() >= deadline)
+            {
+                return false;
+            }
+
+            usleep(100);
+            state = kStateNew;
+        }
+
+        std::memset(data_, kFillByte, kSize);
+        header_->state.store(kStateReady, std::memory_order_release);
+        return true;
+    }
+
+    static bool Contains(uint32_t location, uint32_t length)
+    {
+        return location <= kSize && length <= kSize - location;
+    }
+};
+
+// Persist on a ShmMemory that publishes every Save to waiting readers.
+template <typename Memory, typename T, uint8_t datatype_version>
+class ShmPersist
+{
+public:
+    ShmPersist(Memory& memory) :
+        memory_(memory),
+        persist_{memory}
+    {}
+
+    persist::Result Init(void)
+    {
+        return persist_.Init();
+    }
+
+    persist::Result Load(T& data)
+    {
+        return persist_.Load(data);
+    }
+
+    template <typename... Legacy>
+    persist::Result LoadLegacy(T& data)
+    {
+        return persist_.template LoadLegacy<Legacy...>(data);
+    }
+
+    persist::Result Save(const T& data)
+    {
+        persist::Result result = persist_.Save(data);
+        memory_.Publish();
+        return result;
+    }
+
+protected:
+    Memory& memory_;
+    persist::Persist<Memory, T, datatype_version> persist_;
+};
+
+}
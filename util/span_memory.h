@@ -0,0 +1,113 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Memory backed by a caller-owned buffer of kSize bytes, such as a mapped
+// image file or a slot in a preallocated array. Behaves like flash: writes
+// require erased space and erases refill whole erase units.
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include "util/blank_scan.h"
+
+namespace demo
+{
+
+template <uint32_t memory_size, uint32_t erase_granularity,
+    uint32_t write_granularity>
+class SpanMemory
+{
+public:
+    static constexpr uint32_t kSize = memory_size;
+    static constexpr uint32_t kEraseGranularity = erase_granularity;
+    static constexpr uint32_t kWriteGranularity = write_granularity;
+    static constexpr uint8_t kFillByte = 0xFF;
+
+    explicit SpanMemory(void* data) :
+        data_(static_cast<uint8_t*>(data))
+    {}
+
+    uint8_t* data(void) const
+    {
+        return data_;
+    }
+
+    // Erases the whole buffer.
+    void Format(void)
+    {
+        std::memset(data_, kFillByte, kSize);
+    }
+
+    bool Read(void* dst, uint32_t location, uint32_t length)
+    {
+        if (!Contains(location, length))
+        {
+            return false;
+        }
+
+        std::memcpy(dst, data_ + location, length);
+        return true;
+    }
+
+    bool Writable(uint32_t location, uint32_t length)
+    {
+        return Contains(location, length) &&
+            !(location % kWriteGranularity) &&
+            !(length % kWriteGranularity) &&
+            IsAllFill(data_ + location, length, kFillByte);
+    }
+
+    bool Write(uint32_t location, const void* src, uint32_t length)
+    {
+        if (!Writable(location, length))
+        {
+            return false;
+        }
+
+        std::memcpy(data_ + location, src, length);
+        return true;
+    }
+
+    bool Erase(uint32_t location, uint32_t length)
+    {
+        if (!Contains(location, length) ||
+            (location % kEraseGranularity) || (length % kEraseGranularity))
+        {
+            return false;
+        }
+
+        std::memset(data_ + location, kFillByte, length);
+        return true;
+    }
+
+protected:
+    uint8_t* data_;
+
+    static bool Contains(uint32_t location, uint32_t length)
+    {
+        return location <= kSize && length <= kSize - location;
+    }
+};
+
+}
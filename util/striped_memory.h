@@ -0,0 +1,283 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Presents several Memories of identical geometry as one larger Memory,
+// interleaved in stripes of one erase unit (or write granule, if larger):
+//
+//     location    stripe 0   stripe 1   stripe 2   stripe 3   ...
+//     member      0          1          0          1          ...
+//
+// Within one call, the stripes that land on a member are contiguous in that
+// member, so each member sees a single Writable or Erase covering its share,
+// and one ReadV or WriteV per kMaxSegments stripes of it. Segments are
+// built on the stack, so calls do not allocate. Calls spanning several
+// members and at least kParallelThreshold bytes run on all members at once,
+// on kNumMembers - 1 worker threads started with the StripedMemory and on
+// the calling thread, so large payloads and scans see the combined
+// bandwidth. Smaller calls stay on the calling thread, since handing them
+// off would cost more than it saves.
+//
+// Members with a tiny erase granularity, such as RamMemory, stripe at that
+// granularity, which gains nothing; wrap them to give them a coarser one.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <tuple>
+#include <utility>
+
+#include "util/parallel_for.h"
+#include "util/scatter_gather.h"
+
+namespace demo
+{
+
+template <typename... Members>
+class StripedMemory
+{
+    using First = std::tuple_element_t<0, std::tuple<Members...>>;
+
+public:
+    static constexpr uint32_t kNumMembers = sizeof...(Members);
+    static constexpr uint32_t kMemberSize = First::kSize;
+    static constexpr uint32_t kSize = kNumMembers * kMemberSize;
+    static constexpr uint32_t kEraseGranularity = First::kEraseGranularity;
+    static constexpr uint32_t kWriteGranularity = First::kWriteGranularity;
+    static constexpr uint8_t kFillByte = First::kFillByte;
+    static constexpr uint32_t kStripe =
+        std::max(kEraseGranularity, kWriteGranularity);
+    static constexpr uint32_t kParallelThreshold = 16384;
+    // Stripes handed to a member's ReadV or WriteV at once
+    static constexpr uint32_t kMaxSegments =
+        std::min<uint32_t>(kMemberSize / kStripe, 64);
+
+    static_assert(kNumMembers >= 2);
+    static_assert(((Members::kSize == kMemberSize) && ...) &&
+        ((Members::kEraseGranularity == kEraseGranularity) && ...) &&
+        ((Members::kWriteGranularity == kWriteGranularity) && ...) &&
+        ((Members::kFillByte == kFillByte) && ...),
+        "Members must have identical geometry");
+    static_assert(kStripe % kEraseGranularity == 0 &&
+        kStripe % kWriteGranularity == 0);
+    static_assert(kMemberSize % kStripe == 0);
+    static_assert(uint64_t(kMemberSize) * kNumMembers <= UINT32_MAX);
+
+    StripedMemory(Members&... members) :
+        members_(members...),
+        workers_(kNumMembers - 1)
+    {}
+
+    bool Read(void* dst, uint32_t location, uint32_t length)
+    {
+        auto bytes = static_cast<uint8_t*>(dst);
+
+        return Dispatch(location, length, [&](auto& member, const Run& run)
+        {
+            return Gather<Segment>(run, bytes, [&](const Segment* segments,
+                uint32_t count, uint32_t member_location)
+            {
+                return demo::ReadV(member, segments, count, member_location);
+            });
+        });
+    }
+
+    bool Writable(uint32_t location, uint32_t length)
+    {
+        return Dispatch(location, length, [](auto& member, const Run& run)
+        {
+            return member.Writable(run.location, run.length);
+        });
+    }
+
+    bool Write(uint32_t location, const void* src, uint32_t length)
+    {
+        auto bytes = static_cast<const uint8_t*>(src);
+
+        return Dispatch(location, length, [&](auto& member, const Run& run)
+        {
+            return Gather<ConstSegment>(run, bytes, [&](
+                const ConstSegment* segments, uint32_t count,
+                uint32_t member_location)
+            {
+                return demo::WriteV(member, member_location, segments,
+                    count);
+            });
+        });
+    }
+
+    bool Erase(uint32_t location, uint32_t length)
+    {
+        return Dispatch(location, length, [](auto& member, const Run& run)
+        {
+            return member.Erase(run.location, run.length);
+        });
+    }
+
+    // Maps a location to the member holding it and the location within.
+    static std::pair<uint32_t, uint32_t> Locate(uint32_t location)
+    {
+        uint32_t stripe = location / kStripe;
+        return {stripe % kNumMembers,
+            (stripe / kNumMembers) * kStripe + location % kStripe};
+    }
+
+protected:
+    // The share of one call that lands on one member: length bytes at
+    // location in the member, taken from the caller's buffer one stripe at a
+    // time, starting with head bytes at offset
+    struct Run
+    {
+        uint32_t location = 0;
+        uint32_t length = 0;
+        uint32_t offset = 0;
+        uint32_t head = 0;
+    };
+
+    std::tuple<Members&...> members_;
+    WorkerPool workers_;
+
+    // Calls io(segments, count, member_location) for the run's stripes, at
+    // most kMaxSegments at a time, with segments pointing into buffer.
+    template <typename SegmentType, typename Byte, typename IO>
+    static bool Gather(const Run& run, Byte* buffer, IO io)
+    {
+        SegmentType segments[kMaxSegments];
+        uint32_t offset = run.offset;
+        uint32_t size = run.head;
+        uint32_t done = 0;
+
+        while (done < run.length)
+        {
+            uint32_t count = 0;
+            uint32_t batch = 0;
+
+            while (count < kMaxSegments && done + batch < run.length)
+            {
+                size = std::min(size, run.length - done - batch);
+                segments[count++] = SegmentType{buffer + offset, size};
+                batch += size;
+
+                // The member's next stripe follows one from every other
+                // member
+                offset += size + (kNumMembers - 1) * kStripe;
+                size = kStripe;
+            }
+
+            if (!io(segments, count, run.location + done))
+            {
+                return false;
+            }
+
+            done += batch;
+        }
+
+        return true;
+    }
+
+    template <typename Function>
+    bool Dispatch(uint32_t location, uint32_t length, Function function)
+    {
+        if (location > kSize || length > kSize - location)
+        {
+            return false;
+        }
+
+        if (length == 0)
+        {
+            return true;
+        }
+
+        // Within one stripe, skip the bookkeeping
+        if (location % kStripe + length <= kStripe)
+        {
+            auto [index, offset] = Locate(location);
+            return Apply(index, function, Run{offset, length, 0, length});
+        }
+
+        std::array<Run, kNumMembers> runs;
+        uint32_t touched = 0;
+
+        for (uint32_t offset = 0; offset < length;)
+        {
+            auto [index, member_location] = Locate(location + offset);
+            uint32_t size = std::min(kStripe - (location + offset) % kStripe,
+                length - offset);
+            Run& run = runs[index];
+
+            if (run.length == 0)
+            {
+                run = Run{member_location, 0, offset, size};
+                touched++;
+            }
+
+            run.length += size;
+            offset += size;
+        }
+
+        std::array<bool, kNumMembers> ok;
+        ok.fill(true);
+
+        auto work = [&](uint32_t i)
+        {
+            if (runs[i].length)
+            {
+                ok[i] = Apply(i, function, runs[i]);
+            }
+        };
+
+        if (touched > 1 && length >= kParallelThreshold)
+        {
+            workers_.ParallelFor(kNumMembers, work);
+        }
+        else
+        {
+            for (uint32_t i = 0; i < kNumMembers; i++)
+            {
+                work(i);
+            }
+        }
+
+        return std::all_of(ok.begin(), ok.end(), [](bool b) { return b; });
+    }
+
+    template <typename Function>
+    bool Apply(uint32_t index, Function& function, const Run& run)
+    {
+        return Apply(index, function, run,
+            std::index_sequence_for<Members...>{});
+    }
+
+    template <typename Function, size_t... indices>
+    bool Apply(uint32_t index, Function& function, const Run& run,
+        std::index_sequence<indices...>)
+    {
+        bool result = false;
+        ((index == indices &&
+            (result = function(std::get<indices>(members_), run), true)) ||
+            ...);
+        return result;
+    }
+};
+
+}
@@ -0,0 +1,484 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Binary traces of memory and Persist operations, for replaying production
+// access patterns offline.
+//
+// TracingMemory wraps a Memory and appends one record per Read, Writable,
+// Write and Erase call. TracingPersist wraps a Persist-like type and brackets
+// each Init, Load and Save with begin and end records, so a replay can tell
+// which memory operations belong to which Persist call. Every record carries
+// the id of the thread that made the call, so calls from several threads may
+// interleave. Written bytes are recorded too, so a trace holds the persisted
+// data and Replay reproduces the recorded contents.
+//
+// A trace file is a TraceHeader followed by TraceRecords, both in host byte
+// order. Each write record is followed by the length bytes it wrote.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "persist/persist.h"
+
+namespace demo
+{
+
+enum TraceOp : uint8_t
+{
+    TRACE_READ,
+    TRACE_WRITABLE,
+    TRACE_WRITE,
+    TRACE_ERASE,
+    TRACE_INIT,
+    TRACE_LOAD,
+    TRACE_SAVE,
+    TRACE_NUM_OPS,
+};
+
+enum TracePhase : uint8_t
+{
+    TRACE_CALL,
+    TRACE_BEGIN,
+    TRACE_END,
+};
+
+struct TraceHeader
+{
+    static constexpr uint32_t kMagic = 0x43525450; // "PTRC"
+    static constexpr uint32_t kVersion = 2;
+
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+    uint32_t erase_granularity;
+    uint32_t write_granularity;
+};
+
+struct TraceRecord
+{
+    uint64_t time;      // Nanoseconds since the trace was opened
+    uint32_t location;
+    uint32_t length;
+    uint32_t duration;  // Nanoseconds
+    uint32_t thread;    // Small id of the calling thread
+    uint8_t op;
+    uint8_t phase;
+    uint8_t result;     // 1 if the call succeeded
+    uint8_t reserved[5];
+};
+
+static_assert(sizeof(TraceRecord) == 32);
+
+inline const char* TraceOpName(uint8_t op)
+{
+    static const char* const kNames[] = {
+        "read", "writable", "write", "erase", "init", "load", "save",
+    };
+
+    return op < TRACE_NUM_OPS ? kNames[op] : "unknown";
+}
+
+class TraceWriter
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    TraceWriter(void) :
+        file_(nullptr)
+    {}
+
+    TraceWriter(const TraceWriter&) = delete;
+    TraceWriter& operator=(const TraceWriter&) = delete;
+
+    ~TraceWriter()
+    {
+        Close();
+    }
+
+    template <typename Memory>
+    bool Open(const char* path)
+    {
+        Close();
+        file_ = std::fopen(path, "wb");
+
+        if (file_ == nullptr)
+        {
+            return false;
+        }
+
+        TraceHeader header{TraceHeader::kMagic, TraceHeader::kVersion,
+            Memory::kSize, Memory::kEraseGranularity,
+            Memory::kWriteGranularity};
+        start_ = Clock::now();
+        return std::fwrite(&header, sizeof(header), 1, file_) == 1;
+    }
+
+    void Close(void)
+    {
+        if (file_ != nullptr)
+        {
+            std::fclose(file_);
+            file_ = nullptr;
+        }
+    }
+
+    Clock::time_point now(void) const
+    {
+        return Clock::now();
+    }
+
+    // Appends a record, followed by length bytes of data if not null.
+    void Record(TraceOp op, TracePhase phase, uint32_t location,
+        uint32_t length, bool result, Clock::time_point begin,
+        const void* data = nullptr)
+    {
+        auto end = Clock::now();
+        TraceRecord record{};
+        record.time = Nanoseconds(begin - start_);
+        record.location = location;
+        record.length = length;
+        record.duration = (phase == TRACE_BEGIN) ? 0 :
+            uint32_t(Nanoseconds(end - begin));
+        record.thread = ThreadId();
+        record.op = op;
+        record.phase = phase;
+        record.result = result;
+
+        std::lock_guard lock{mutex_};
+
+        if (file_ != nullptr)
+        {
+            std::fwrite(&record, sizeof(record), 1, file_);
+
+            if (data != nullptr)
+            {
+                std::fwrite(data, 1, length, file_);
+            }
+        }
+    }
+
+protected:
+    std::FILE* file_;
+    Clock::time_point start_;
+    std::mutex mutex_;
+
+    template <typename Duration>
+    static uint64_t Nanoseconds(Duration duration)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            duration).count();
+    }
+
+    static uint32_t ThreadId(void)
+    {
+        static std::atomic<uint32_t> next{0};
+        thread_local uint32_t id = next++;
+        return id;
+    }
+};
+
+// Reads a whole trace file. The bytes of every write are appended to
+// payload in record order. Returns false if it cannot be read or is not a
+// trace.
+inline bool ReadTrace(const char* path, TraceHeader& header,
+    std::vector<TraceRecord>& records, std::vector<uint8_t>& payload)
+{
+    std::FILE* file = std::fopen(path, "rb");
+
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    bool ok = std::fread(&header, sizeof(header), 1, file) == 1 &&
+        header.magic == TraceHeader::kMagic &&
+        header.version == TraceHeader::kVersion;
+    TraceRecord record;
+    records.clear();
+    payload.clear();
+
+    while (ok && std::fread(&record, sizeof(record), 1, file) == 1)
+    {
+        records.push_back(record);
+
+        if (record.op == TRACE_WRITE && record.phase == TRACE_CALL)
+        {
+            size_t offset = payload.size();
+            payload.resize(offset + record.length);
+            ok = std::fread(&payload[offset], 1, record.length, file) ==
+                record.length;
+        }
+    }
+
+    std::fclose(file);
+    return ok;
+}
+
+template <typename Memory>
+class TracingMemory
+{
+public:
+    static constexpr uint32_t kSize = Memory::kSize;
+    static constexpr uint32_t kEraseGranularity = Memory::kEraseGranularity;
+    static constexpr uint32_t kWriteGranularity = Memory::kWriteGranularity;
+    static constexpr uint8_t kFillByte = Memory::kFillByte;
+
+    TracingMemory(Memory& memory, TraceWriter& writer) :
+        memory_(memory),
+        writer_(writer)
+    {}
+
+    bool Read(void* dst, uint32_t location, uint32_t length)
+    {
+        auto begin = writer_.now();
+        bool result = memory_.Read(dst, location, length);
+        writer_.Record(TRACE_READ, TRACE_CALL, location, length, result, begin);
+        return result;
+    }
+
+    bool Writable(uint32_t location, uint32_t length)
+    {
+        auto begin = writer_.now();
+        bool result = memory_.Writable(location, length);
+        writer_.Record(TRACE_WRITABLE, TRACE_CALL, location, length, result,
+            begin);
+        return result;
+    }
+
+    bool Write(uint32_t location, const void* src, uint32_t length)
+    {
+        auto begin = writer_.now();
+        bool result = memory_.Write(location, src, length);
+        writer_.Record(TRACE_WRITE, TRACE_CALL, location, length, result,
+            begin, src);
+        return result;
+    }
+
+    bool Erase(uint32_t location, uint32_t length)
+    {
+        auto begin = writer_.now();
+        bool result = memory_.Erase(location, length);
+        writer_.Record(TRACE_ERASE, TRACE_CALL, location, length, result,
+            begin);
+        return result;
+    }
+
+protected:
+    Memory& memory_;
+    TraceWriter& writer_;
+};
+
+template <typename Persist, typename T>
+class TracingPersist
+{
+public:
+    template <typename... Args>
+    TracingPersist(TraceWriter& writer, Args&&... args) :
+        persist_{std::forward<Args>(args)...},
+        writer_(writer)
+    {}
+
+    persist::Result Init(void)
+    {
+        return Traced(TRACE_INIT, [&]() { return persist_.Init(); });
+    }
+
+    persist::Result Load(T& data)
+    {
+        return Traced(TRACE_LOAD, [&]() { return persist_.Load(data); });
+    }
+
+    template <typename... Legacy>
+    persist::Result LoadLegacy(T& data)
+    {
+        return Traced(TRACE_LOAD, [&]()
+        {
+            return persist_.template LoadLegacy<Legacy...>(data);
+        });
+    }
+
+    persist::Result Save(const T& data)
+    {
+        return Traced(TRACE_SAVE, [&]() { return persist_.Save(data); });
+    }
+
+protected:
+    Persist persist_;
+    TraceWriter& writer_;
+
+    template <typename Fn>
+    persist::Result Traced(TraceOp op, Fn fn)
+    {
+        auto begin = writer_.now();
+        writer_.Record(op, TRACE_BEGIN, 0, sizeof(T), true, begin);
+        persist::Result result = fn();
+        writer_.Record(op, TRACE_END, 0, sizeof(T),
+            result == persist::RESULT_SUCCESS, begin);
+        return result;
+    }
+};
+
+struct ReplayResult
+{
+    // Replay latency of each operation in nanoseconds, indexed by TraceOp.
+    // A Persist operation's latency is the sum of the memory operations its
+    // thread made between its begin and end records.
+    std::vector<uint32_t> latencies[TRACE_NUM_OPS];
+    uint64_t bytes;
+    // Total nanoseconds spent in memory operations
+    uint64_t elapsed;
+    // Memory operations whose result differed from the recording
+    uint32_t mismatches;
+};
+
+// A Memory that models its own timing, rather than running at host speed,
+// reports the modeled duration of its last operation with
+//
+//     uint32_t modeled_latency(void);
+//
+// and Replay uses that in place of the measured time.
+template <typename Memory, typename = void>
+struct HasModeledLatency : std::false_type {};
+
+template <typename Memory>
+struct HasModeledLatency<Memory, std::void_t<decltype(
+    std::declval<Memory&>().modeled_latency())>> : std::true_type {};
+
+// Re-drives the memory operations of a trace against memory as fast as
+// possible, writing the recorded bytes from payload as read by ReadTrace.
+template <typename Memory>
+ReplayResult Replay(Memory& memory, const std::vector<TraceRecord>& records,
+    const std::vector<uint8_t>& payload)
+{
+    using Clock = std::chrono::steady_clock;
+
+    ReplayResult replay{};
+    std::vector<uint8_t> buffer;
+    size_t cursor = 0;
+    uint64_t busy = 0;
+    // Memory time per thread, and its value when each open call began
+    std::map<uint32_t, uint64_t> thread_busy;
+    std::map<std::pair<uint32_t, uint8_t>, uint64_t> open;
+
+    for (auto& record : records)
+    {
+        if (record.op >= TRACE_NUM_OPS)
+        {
+            continue;
+        }
+
+        if (record.phase == TRACE_BEGIN)
+        {
+            open[{record.thread, record.op}] = thread_busy[record.thread];
+            continue;
+        }
+
+        if (record.phase == TRACE_END)
+        {
+            auto it = open.find({record.thread, record.op});
+
+            if (it != open.end())
+            {
+                replay.latencies[record.op].push_back(
+                    thread_busy[record.thread] - it->second);
+                open.erase(it);
+            }
+
+            continue;
+        }
+
+        if (buffer.size() < record.length)
+        {
+            buffer.resize(record.length);
+        }
+
+        bool result = false;
+        auto begin = Clock::now();
+
+        switch (record.op)
+        {
+        case TRACE_READ:
+            result = memory.Read(buffer.data(), record.location,
+                record.length);
+            break;
+
+        case TRACE_WRITABLE:
+            result = memory.Writable(record.location, record.length);
+            break;
+
+        case TRACE_WRITE:
+        {
+            // A short payload writes zeros for the missing bytes
+            std::fill(buffer.begin(), buffer.begin() + record.length, 0);
+
+            if (cursor < payload.size())
+            {
+                std::copy_n(payload.begin() + cursor, std::min<size_t>(
+                    record.length, payload.size() - cursor), buffer.begin());
+            }
+
+            cursor += record.length;
+            result = memory.Write(record.location, buffer.data(),
+                record.length);
+            break;
+        }
+
+        case TRACE_ERASE:
+            result = memory.Erase(record.location, record.length);
+            break;
+        }
+
+        uint32_t latency;
+
+        if constexpr (HasModeledLatency<Memory>::value)
+        {
+            latency = memory.modeled_latency();
+        }
+        else
+        {
+            latency = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                Clock::now() - begin).count();
+        }
+
+        replay.latencies[record.op].push_back(latency);
+        busy += latency;
+        thread_busy[record.thread] += latency;
+        replay.bytes += record.length;
+        replay.mismatches += (result != bool(record.result));
+    }
+
+    replay.elapsed = busy;
+    return replay;
+}
+
+}
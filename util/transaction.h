@@ -0,0 +1,312 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Atomic commit across several Persist instances. Each Participant stores
+// its value tagged with the transaction that wrote it. TransactionLog keeps
+// the last committed transaction number in its own Persist region and
+// commits by saving every participant first and the commit record last.
+//
+// At startup, TransactionLog::Init mounts the log and the participants and
+// rolls back any participant whose newest value belongs to a transaction
+// that never committed, by re-saving its newest committed generation. After
+// a crash, either all participants of a transaction take effect or none do.
+//
+// A participant's first mount saves a record tagged with transaction 0 that
+// holds no value, so a committed generation always exists to roll back to
+// unless the medium has recycled it; in that case recovery fails rather
+// than discard data. Transaction numbers are never reused, even after an
+// abort, and a failed rollback blocks further commits until Init succeeds.
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include "persist/persist.h"
+#include "util/history.h"
+
+namespace demo
+{
+
+template <typename Memory, typename T, uint8_t datatype_version>
+class Participant
+{
+public:
+    struct Record
+    {
+        uint32_t transaction;
+        uint8_t present;
+        T data;
+    };
+
+    Participant(Memory& memory) :
+        memory_(memory),
+        persist_{memory}
+    {}
+
+    // Returns the value of the last committed transaction. Only valid after
+    // TransactionLog::Init has recovered this participant.
+    persist::Result Load(T& data)
+    {
+        Record record;
+        persist::Result result = persist_.Load(record);
+
+        if (result != persist::RESULT_SUCCESS)
+        {
+            return result;
+        }
+
+        if (!record.present)
+        {
+            return persist::RESULT_FAIL_NO_DATA;
+        }
+
+        data = record.data;
+        return persist::RESULT_SUCCESS;
+    }
+
+    // Writes data on behalf of a transaction that has not committed yet.
+    // Called by TransactionLog::Commit.
+    persist::Result Prepare(uint32_t transaction, const T& data)
+    {
+        Record record;
+        std::memset(&record, 0, sizeof(record));
+        record.transaction = transaction;
+        record.present = 1;
+        record.data = data;
+        return persist_.Save(record);
+    }
+
+    // Ensures the newest value belongs to a committed transaction. Raises
+    // highest to the newest transaction number found on the medium.
+    persist::Result Recover(uint32_t committed, uint32_t& highest)
+    {
+        persist::Result result = persist_.Init();
+
+        if (result != persist::RESULT_SUCCESS)
+        {
+            return result;
+        }
+
+        Record record;
+
+        if (persist_.Load(record) != persist::RESULT_SUCCESS)
+        {
+            std::memset(&record, 0, sizeof(record));
+            return persist_.Save(record);
+        }
+
+        if (int32_t(record.transaction - highest) > 0)
+        {
+            highest = record.transaction;
+        }
+
+        if (Committed(record, committed))
+        {
+            return persist::RESULT_SUCCESS;
+        }
+
+        PersistHistory<Memory, Record, datatype_version> history{memory_};
+        result = history.Init();
+
+        if (result != persist::RESULT_SUCCESS)
+        {
+            return result;
+        }
+
+        for (auto& generation : history)
+        {
+            if (Committed(generation.data, committed))
+            {
+                return persist_.Save(generation.data);
+            }
+        }
+
+        // The committed value has been recycled
+        return persist::RESULT_FAIL_NO_DATA;
+    }
+
+protected:
+    Memory& memory_;
+    persist::Persist<Memory, Record, datatype_version> persist_;
+
+    static bool Committed(const Record& record, uint32_t committed)
+    {
+        return int32_t(committed - record.transaction) >= 0;
+    }
+};
+
+template <typename Participant, typename T>
+struct Staged
+{
+    Participant& participant;
+    const T& data;
+};
+
+template <typename Participant, typename T>
+Staged<Participant, T> Stage(Participant& participant, const T& data)
+{
+    return Staged<Participant, T>{participant, data};
+}
+
+template <typename Memory>
+class TransactionLog
+{
+public:
+    TransactionLog(Memory& memory) :
+        persist_{memory},
+        committed_(0),
+        next_(1),
+        recovered_(false)
+    {}
+
+    // Mounts the log and recovers every participant.
+    template <typename... Participants>
+    persist::Result Init(Participants&... participants)
+    {
+        persist::Result result = persist_.Init();
+
+        if (result != persist::RESULT_SUCCESS)
+        {
+            return result;
+        }
+
+        Record record;
+
+        if (persist_.Load(record) != persist::RESULT_SUCCESS)
+        {
+            record = Record{0, 1};
+        }
+
+        committed_ = record.committed;
+        uint32_t highest = record.next - 1;
+        recovered_ = false;
+
+        persist::Result results[] = {
+            persist::RESULT_SUCCESS,
+            participants.Recover(committed_, highest)...
+        };
+
+        for (auto each : results)
+        {
+            if (each != persist::RESULT_SUCCESS)
+            {
+                return each;
+            }
+        }
+
+        // Numbers that a crashed transaction left on the medium stay used,
+        // even once rollback has overwritten them
+        next_ = highest + 1;
+
+        if (next_ != record.next)
+        {
+            result = persist_.Save(Record{committed_, next_});
+
+            if (result != persist::RESULT_SUCCESS)
+            {
+                return result;
+            }
+        }
+
+        recovered_ = true;
+        return persist::RESULT_SUCCESS;
+    }
+
+    // Commits Stage(participant, data) for every argument, or none of them.
+    // Fails without writing anything unless Init has recovered every
+    // participant since the last failed rollback.
+    template <typename... Stages>
+    persist::Result Commit(Stages... stages)
+    {
+        if (!recovered_)
+        {
+            return persist::RESULT_FAIL_NO_DATA;
+        }
+
+        uint32_t transaction = next_++;
+        persist::Result result = persist::RESULT_SUCCESS;
+
+        bool prepared = (((result = stages.participant.Prepare(
+            transaction, stages.data)) == persist::RESULT_SUCCESS) && ...);
+
+        if (prepared)
+        {
+            result = persist_.Save(Record{transaction, next_});
+        }
+
+        if (result != persist::RESULT_SUCCESS)
+        {
+            // Undo whatever was prepared so the participants match the log.
+            // A participant that could not be rolled back still holds the
+            // aborted value, which a later commit would make look committed.
+            uint32_t highest = committed_;
+            persist::Result undone[] = {
+                persist::RESULT_SUCCESS,
+                stages.participant.Recover(committed_, highest)...
+            };
+
+            for (auto each : undone)
+            {
+                if (each != persist::RESULT_SUCCESS)
+                {
+                    recovered_ = false;
+                    return each;
+                }
+            }
+
+            // Keep the aborted number used after a reboot. Rollback has
+            // succeeded, so if this fails, a reused number is harmless.
+            persist_.Save(Record{committed_, next_});
+            return result;
+        }
+
+        committed_ = transaction;
+        return persist::RESULT_SUCCESS;
+    }
+
+    uint32_t committed(void) const
+    {
+        return committed_;
+    }
+
+protected:
+    struct Record
+    {
+        uint32_t committed;
+        uint32_t next;  // Lowest transaction number never used
+
+        Record(void) = default;
+
+        Record(uint32_t committed_transaction, uint32_t next_transaction) :
+            committed(committed_transaction),
+            next(next_transaction)
+        {}
+    };
+
+    persist::Persist<Memory, Record, 0> persist_;
+    uint32_t committed_;
+    uint32_t next_;
+    bool recovered_;
+};
+
+}
@@ -0,0 +1,496 @@
+// MIT License
+//
+// Copyright 2023 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Save rate limiting driven by an erase budget. EraseCountingMemory wraps a
+// Memory and counts erase cycles per erase unit, like the test harness's
+// erase_histogram_, passing each erase to a charge hook first. WearGovernor
+// sits in front of a Persist on that memory and lets no unit be erased more
+// often than a budget that grows linearly over the target lifetime:
+//
+//     allowed(t) = burst + endurance * t / lifetime
+//
+// Only erases are charged. A save that fits in already erased space always
+// goes straight through; one whose erase the budget does not cover is
+// refused before anything is programmed (Persist erases a block before
+// writing it), and the value is coalesced in RAM: only the newest is kept,
+// and it is written as soon as the budget has caught up, either by the next
+// Save or by Poll. Load returns the pending value, so callers see their own
+// writes. A pending value is not durable until it has been written; Flush
+// writes it regardless of the budget, e.g. before shutdown.
+//
+// Erase counts and service time t are kept in a ledger, a second Persist on
+// a caller-supplied memory, so wear history survives restarts. Writing the
+// ledger before every erase would wear its own memory faster than the data
+// it protects, so it is saved once every ledger_interval charged erases and
+// by Flush. A crash therefore loses at most ledger_interval - 1 erases per
+// unit from the counts, and the service time since the last ledger save.
+// The ledger's memory is counted too and its erases are charged against the
+// same allowance: a ledger save that would overspend it is refused along
+// with the erase that triggered it.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+
+#include "persist/persist.h"
+
+namespace demo
+{
+
+template <typename Memory>
+class EraseCountingMemory
+{
+public:
+    static constexpr uint32_t kSize = Memory::kSize;
+    static constexpr uint32_t kEraseGranularity = Memory::kEraseGranularity;
+    static constexpr uint32_t kWriteGranularity = Memory::kWriteGranularity;
+    static constexpr uint8_t kFillByte = Memory::kFillByte;
+    static constexpr uint32_t kNumUnits = kSize / kEraseGranularity;
+
+    // Called with the range of units [first, last) after their counts have
+    // been bumped and before they are erased. Returning false refuses the
+    // erase and restores the counts.
+    using Charge = std::function<bool(uint32_t first, uint32_t last)>;
+
+    EraseCountingMemory(Memory& memory) :
+        memory_(memory),
+        counts_{}
+    {}
+
+    void OnErase(Charge charge)
+    {
+        charge_ = std::move(charge);
+    }
+
+    // Restores counts recorded earlier, e.g. before a restart.
+    void Seed(const uint32_t (&counts)[kNumUnits])
+    {
+        std::copy(counts, counts + kNumUnits, counts_);
+    }
+
+    bool Read(void* dst, uint32_t location, uint32_t length)
+    {
+        return memory_.Read(dst, location, length);
+    }
+
+    bool Writable(uint32_t location, uint32_t length)
+    {
+        return memory_.Writable(location, length);
+    }
+
+    bool Write(uint32_t location, const void* src, uint32_t length)
+    {
+        return memory_.Write(location, src, length);
+    }
+
+    bool Erase(uint32_t location, uint32_t length)
+    {
+        uint32_t first = std::min(location / kEraseGranularity, kNumUnits);
+        uint32_t last = std::min((location + length) / kEraseGranularity,
+            kNumUnits);
+
+        for (uint32_t unit = first; unit < last; unit++)
+        {
+            counts_[unit]++;
+        }
+
+        if (charge_ && !charge_(first, last))
+        {
+            for (uint32_t unit = first; unit < last; unit++)
+            {
+                counts_[unit]--;
+            }
+
+            return false;
+        }
+
+        // A failed erase stays charged; the unit may still have worn
+        return memory_.Erase(location, length);
+    }
+
+    uint32_t erase_count(uint32_t unit) const
+    {
+        return counts_[unit];
+    }
+
+    uint32_t max_erase_count(void) const
+    {
+        return *std::max_element(counts_, counts_ + kNumUnits);
+    }
+
+    const uint32_t (&erase_counts(void) const)[kNumUnits]
+    {
+        return counts_;
+    }
+
+protected:
+    Memory& memory_;
+    uint32_t counts_[kNumUnits];
+    Charge charge_;
+};
+
+struct WearBudget
+{
+    // Erase cycles each unit may spend over the lifetime.
+    uint32_t endurance;
+    std::chrono::seconds lifetime;
+    // Erase cycles available up front, before any time has passed.
+    uint32_t burst;
+};
+
+template <typename Memory, typename T, uint8_t version,
+    typename Clock = std::chrono::steady_clock,
+    typename LedgerMemory = Memory>
+class WearGovernor
+{
+public:
+    using CountingMemory = EraseCountingMemory<Memory>;
+    using Persist = persist::Persist<CountingMemory, T, version>;
+
+    using CountingLedgerMemory = EraseCountingMemory<LedgerMemory>;
+
+    struct LedgerRecord
+    {
+        uint32_t counts[CountingMemory::kNumUnits];
+        uint32_t ledger_counts[CountingLedgerMemory::kNumUnits];
+        // Service time in seconds
+        uint32_t elapsed;
+    };
+
+    using Ledger = persist::Persist<CountingLedgerMemory, LedgerRecord, 0>;
+
+    static constexpr uint32_t kDefaultLedgerInterval = 16;
+
+    struct Stats
+    {
+        uint32_t saves;
+        uint32_t written;
+        uint32_t deferred;
+        uint32_t coalesced;
+        uint32_t throttle_events;
+        uint32_t ledger_saves;
+    };
+
+    WearGovernor(Memory& memory, LedgerMemory& ledger,
+        const WearBudget& budget,
+        uint32_t ledger_interval = kDefaultLedgerInterval) :
+        memory_{memory},
+        persist_{memory_},
+        ledger_memory_{ledger},
+        ledger_{ledger_memory_},
+        budget_(budget),
+        ledger_interval_(std::max(ledger_interval, 1u)),
+        unrecorded_(0),
+        base_elapsed_(0),
+        stats_{},
+        pending_(false),
+        throttled_(false),
+        gated_(false),
+        refused_(false)
+    {
+        memory_.OnErase([this](uint32_t first, uint32_t last)
+        {
+            return Charge(first, last);
+        });
+
+        ledger_memory_.OnErase([this](uint32_t first, uint32_t last)
+        {
+            return ChargeLedger(first, last);
+        });
+    }
+
+    WearGovernor(const WearGovernor&) = delete;
+    WearGovernor& operator=(const WearGovernor&) = delete;
+
+    // Called with true when throttling starts and false when it ends.
+    void OnThrottle(std::function<void(bool)> callback)
+    {
+        on_throttle_ = std::move(callback);
+    }
+
+    persist::Result Init(void)
+    {
+        start_ = Clock::now();
+        base_elapsed_ = 0;
+        unrecorded_ = 0;
+        pending_ = false;
+
+        persist::Result result = ledger_.Init();
+
+        if (result != persist::RESULT_SUCCESS)
+        {
+            return result;
+        }
+
+        LedgerRecord record;
+
+        if (ledger_.Load(record) == persist::RESULT_SUCCESS)
+        {
+            memory_.Seed(record.counts);
+            ledger_memory_.Seed(record.ledger_counts);
+            base_elapsed_ = record.elapsed;
+        }
+
+        return persist_.Init();
+    }
+
+    persist::Result Load(T& data)
+    {
+        if (pending_)
+        {
+            data = pending_value_;
+            return persist::RESULT_SUCCESS;
+        }
+
+        return persist_.Load(data);
+    }
+
+    persist::Result Save(const T& data)
+    {
+        stats_.saves++;
+
+        if (pending_)
+        {
+            stats_.coalesced++;
+        }
+
+        pending_value_ = data;
+        pending_ = true;
+        persist::Result result = Poll();
+
+        if (pending_)
+        {
+            stats_.deferred++;
+        }
+
+        return result;
+    }
+
+    // Writes the pending value if the budget allows. Call periodically so
+    // that deferred saves land even when no further Save arrives.
+    persist::Result Poll(void)
+    {
+        if (!pending_)
+        {
+            return persist::RESULT_SUCCESS;
+        }
+
+        gated_ = true;
+        refused_ = false;
+        persist::Result result = Write();
+        gated_ = false;
+
+        if (refused_)
+        {
+            SetThrottled(true);
+            return persist::RESULT_SUCCESS;
+        }
+
+        SetThrottled(false);
+        return result;
+    }
+
+    // Writes the pending value regardless of the budget and records the
+    // service time so far in the ledger.
+    persist::Result Flush(void)
+    {
+        persist::Result result = pending_ ? Write() : persist::RESULT_SUCCESS;
+
+        if (result == persist::RESULT_SUCCESS && !SaveLedger())
+        {
+            result = persist::RESULT_FAIL_MEMORY;
+        }
+
+        return result;
+    }
+
+    bool throttled(void) const
+    {
+        return throttled_;
+    }
+
+    bool pending(void) const
+    {
+        return pending_;
+    }
+
+    const Stats& stats(void) const
+    {
+        return stats_;
+    }
+
+    const CountingMemory& memory(void) const
+    {
+        return memory_;
+    }
+
+    const CountingLedgerMemory& ledger_memory(void) const
+    {
+        return ledger_memory_;
+    }
+
+    // Erase cycles each unit may have used by now.
+    uint64_t allowance(void) const
+    {
+        auto lifetime = std::max<int64_t>(budget_.lifetime.count(), 1);
+        int64_t elapsed = std::clamp<int64_t>(this->elapsed(), 0, lifetime);
+        return budget_.burst + uint64_t(budget_.endurance) * elapsed / lifetime;
+    }
+
+    // Service time in seconds, including time recorded before a restart.
+    uint32_t elapsed(void) const
+    {
+        auto now = std::chrono::duration_cast<std::chrono::seconds>(
+            Clock::now() - start_).count();
+        return uint32_t(std::clamp<int64_t>(base_elapsed_ + now, 0,
+            UINT32_MAX));
+    }
+
+protected:
+    CountingMemory memory_;
+    Persist persist_;
+    CountingLedgerMemory ledger_memory_;
+    Ledger ledger_;
+    WearBudget budget_;
+    uint32_t ledger_interval_;
+    // Charged erases since the ledger was last saved
+    uint32_t unrecorded_;
+    typename Clock::time_point start_;
+    uint32_t base_elapsed_;
+    std::function<void(bool)> on_throttle_;
+    Stats stats_;
+    T pending_value_;
+    bool pending_;
+    bool throttled_;
+    // True while writing under the budget; set when it refused an erase
+    bool gated_;
+    bool refused_;
+
+    template <typename Counting>
+    bool Allowed(const Counting& memory, uint32_t first, uint32_t last)
+    {
+        uint64_t allowed = allowance();
+
+        for (uint32_t unit = first; unit < last; unit++)
+        {
+            if (memory.erase_count(unit) > allowed)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool Charge(uint32_t first, uint32_t last)
+    {
+        if (gated_ && !Allowed(memory_, first, last))
+        {
+            refused_ = true;
+            return false;
+        }
+
+        if (++unrecorded_ < ledger_interval_)
+        {
+            return true;
+        }
+
+        // Record this erase before it happens; if the ledger cannot be
+        // saved, the erase waits for it
+        if (!SaveLedger())
+        {
+            unrecorded_--;
+            return false;
+        }
+
+        return true;
+    }
+
+    bool ChargeLedger(uint32_t first, uint32_t last)
+    {
+        if (gated_ && !Allowed(ledger_memory_, first, last))
+        {
+            refused_ = true;
+            return false;
+        }
+
+        return true;
+    }
+
+    bool SaveLedger(void)
+    {
+        LedgerRecord record{};
+        std::copy(std::begin(memory_.erase_counts()),
+            std::end(memory_.erase_counts()), record.counts);
+        std::copy(std::begin(ledger_memory_.erase_counts()),
+            std::end(ledger_memory_.erase_counts()), record.ledger_counts);
+        record.elapsed = elapsed();
+
+        if (ledger_.Save(record) != persist::RESULT_SUCCESS)
+        {
+            return false;
+        }
+
+        unrecorded_ = 0;
+        stats_.ledger_saves++;
+        return true;
+    }
+
+    persist::Result Write(void)
+    {
+        persist::Result result = persist_.Save(pending_value_);
+
+        if (result == persist::RESULT_SUCCESS)
+        {
+            pending_ = false;
+            stats_.written++;
+        }
+
+        return result;
+    }
+
+    void SetThrottled(bool throttled)
+    {
+        if (throttled == throttled_)
+        {
+            return;
+        }
+
+        throttled_ = throttled;
+
+        if (throttled)
+        {
+            stats_.throttle_events++;
+        }
+
+        if (on_throttle_)
+        {
+            on_throttle_(throttled);
+        }
+    }
+};
+
+}